@@ -49,27 +49,51 @@ int BinauralSpacializer::start(const std::string& pulseFileName, const std::stri
 
 	sampleRate = jack_get_sample_rate(client);
 
-	int err;
-	int filterLength;
-	mysofaHandle.reset(mysofa_open(pulseFileName.c_str(), sampleRate, &filterLength, &err));
-	if(!mysofaHandle) {
-		printf("Failed to open HRTF SOFA file %s, error %d\n", pulseFileName.c_str(), err);
-		return -4;
+	HrtfCache::Key cacheKey;
+	std::string cacheFileName;
+	size_t numChannels;
+
+	cacheKey.sampleRate = sampleRate;
+	cacheKey.blockSize = jack_get_buffer_size(client);
+	cacheKey.speakerPlacement = speakerPlacement;
+	if(HrtfCache::computeFileHash(pulseFileName, &cacheKey.sofaHash)) {
+		cacheFileName = HrtfCache::getCacheFileName(pulseFileName, cacheKey);
 	}
 
-	printf("SOFA Attributes: I: %d, C: %d, R: %d, E: %d, N: %d, M: %d\n",
-	       mysofaHandle->hrtf->I,
-	       mysofaHandle->hrtf->C,
-	       mysofaHandle->hrtf->R,
-	       mysofaHandle->hrtf->E,
-	       mysofaHandle->hrtf->N,
-	       mysofaHandle->hrtf->M);
-	for(struct MYSOFA_ATTRIBUTE* attribute = mysofaHandle->hrtf->attributes; attribute; attribute = attribute->next) {
-		printf(" %s: %s\n", attribute->name, attribute->value);
+	if(!cacheFileName.empty() && loadFromCache(cacheFileName, cacheKey, &numChannels)) {
+		printf("Loaded HRTF from cache %s\n", cacheFileName.c_str());
+	} else {
+		int err;
+		int filterLength;
+		mysofaHandle.reset(mysofa_open(pulseFileName.c_str(), sampleRate, &filterLength, &err));
+		if(!mysofaHandle) {
+			printf("Failed to open HRTF SOFA file %s, error %d\n", pulseFileName.c_str(), err);
+			return -4;
+		}
+
+		printf("SOFA Attributes: I: %d, C: %d, R: %d, E: %d, N: %d, M: %d\n",
+		       mysofaHandle->hrtf->I,
+		       mysofaHandle->hrtf->C,
+		       mysofaHandle->hrtf->R,
+		       mysofaHandle->hrtf->E,
+		       mysofaHandle->hrtf->N,
+		       mysofaHandle->hrtf->M);
+		for(struct MYSOFA_ATTRIBUTE* attribute = mysofaHandle->hrtf->attributes; attribute;
+		    attribute = attribute->next) {
+			printf(" %s: %s\n", attribute->name, attribute->value);
+		}
+
+		fillTransforms(mysofaHandle.get(), filterLength, &numChannels, speakerPlacement);
+
+		if(!cacheFileName.empty())
+			saveToCache(cacheFileName, cacheKey);
 	}
 
-	size_t numChannels;
-	fillTransforms(mysofaHandle.get(), filterLength, &numChannels, speakerPlacement);
+	// Per input convolution used by processSamples when the mixer can't be used
+	for(auto& transform : transforms) {
+		for(auto& ear : transform.ears)
+			ear.hrtf.setBlockSize(cacheKey.blockSize);
+	}
 
 	inputPorts.resize(numChannels);
 	if(openJackPort(client, &inputPorts[0], inputPorts.size(), JackPortIsInput) < 0)
@@ -107,6 +131,20 @@ int BinauralSpacializer::processSamples(jack_nframes_t nframes) {
 
 	for(size_t i = 0; i < outputPorts.size(); i++) {
 		out[i] = (jack_default_audio_sample_t*) jack_port_get_buffer(outputPorts[i], nframes);
+	}
+
+	if(nframes == mixer.getBlockSize() && inputNumber == transforms.size() && inputNumber <= 32) {
+		const float* in[32];
+
+		for(size_t i = 0; i < inputNumber; i++)
+			in[i] = (const jack_default_audio_sample_t*) jack_port_get_buffer(inputPorts[i], nframes);
+
+		mixer.processSamples(out, in, nframes);
+		return 0;
+	}
+
+	// Period size changed, convolve each input separately
+	for(size_t i = 0; i < outputPorts.size(); i++) {
 		std::fill_n(out[i], nframes, 0.0f);
 	}
 
@@ -197,6 +235,127 @@ void BinauralSpacializer::fillTransforms(struct MYSOFA_EASY* mysofaHandle,
 	}
 
 	normalizeGains();
+	initMixer(jack_get_buffer_size(client), getMaxImpulseSize());
+	computeMixerPartitions();
+}
+
+size_t BinauralSpacializer::getMaxImpulseSize() {
+	size_t maxImpulseSize = 0;
+
+	for(auto& transform : transforms) {
+		for(auto& ear : transform.ears) {
+			unsigned int delay;
+			ear.delay.getParameters(delay);
+			maxImpulseSize = std::max(maxImpulseSize, delay + ear.hrtf.getData().size());
+		}
+	}
+
+	return maxImpulseSize;
+}
+
+void BinauralSpacializer::initMixer(size_t blockSize, size_t maxImpulseSize) {
+	printf("Using frequency domain mixer with block size %d and impulse size %d\n",
+	       (int) blockSize,
+	       (int) maxImpulseSize);
+	mixer.init(transforms.size(), outputPorts.size(), blockSize, maxImpulseSize);
+}
+
+void BinauralSpacializer::computeMixerPartitions() {
+	std::vector<float> impulseResponse;
+
+	// The delay of each ear is included in its impulse response so all inputs can be mixed in the frequency domain
+
+	for(size_t i = 0; i < transforms.size(); i++) {
+		for(size_t ear = 0; ear < transforms[i].ears.size(); ear++) {
+			const std::vector<float>& data = transforms[i].ears[ear].hrtf.getData();
+			unsigned int delay;
+
+			transforms[i].ears[ear].delay.getParameters(delay);
+
+			// convolver signal is reversed
+			impulseResponse.assign(delay, 0.0f);
+			impulseResponse.insert(impulseResponse.end(), data.rbegin(), data.rend());
+			mixer.setImpulseResponse(i, ear, impulseResponse.data(), impulseResponse.size());
+		}
+	}
+}
+
+bool BinauralSpacializer::loadFromCache(const std::string& cacheFileName,
+                                        const HrtfCache::Key& key,
+                                        size_t* numChannels) {
+	HrtfCache cache;
+
+	if(!cache.open(cacheFileName, key))
+		return false;
+
+	if(cache.getOutputNumber() != outputPorts.size()) {
+		printf("Ignoring HRTF cache with %d outputs\n", (int) cache.getOutputNumber());
+		return false;
+	}
+
+	transforms.resize(cache.getInputNumber());
+	for(size_t i = 0; i < transforms.size(); i++) {
+		for(size_t ear = 0; ear < transforms[i].ears.size(); ear++) {
+			transforms[i].ears[ear].hrtf.setConvolver(cache.getImpulseResponse(i, ear), cache.getImpulseSize());
+			transforms[i].ears[ear].delay.init();
+			transforms[i].ears[ear].delay.setParameters(cache.getDelay(i, ear));
+		}
+	}
+
+	initMixer(key.blockSize, cache.getMaxImpulseSize());
+	if(mixer.getPartitionCount() != cache.getPartitionCount() ||
+	   mixer.getSpectrumStride() != cache.getSpectrumStride()) {
+		printf("Ignoring HRTF cache with incompatible partitions\n");
+		transforms.clear();
+		return false;
+	}
+
+	for(size_t i = 0; i < transforms.size(); i++) {
+		for(size_t ear = 0; ear < transforms[i].ears.size(); ear++) {
+			mixer.setPartitions(i, ear, cache.getPartitions(i, ear));
+		}
+	}
+
+	*numChannels = transforms.size();
+
+	return true;
+}
+
+void BinauralSpacializer::saveToCache(const std::string& cacheFileName, const HrtfCache::Key& key) {
+	std::vector<std::vector<float>> impulseResponses;
+	std::vector<const float*> impulseResponsePointers;
+	std::vector<uint32_t> delays;
+	size_t impulseSize = transforms[0].ears[0].hrtf.getData().size();
+
+	// Store impulse responses in natural order as expected by setConvolver()
+	for(const auto& transform : transforms) {
+		for(const auto& ear : transform.ears) {
+			const std::vector<float>& data = ear.hrtf.getData();
+			unsigned int delay;
+
+			if(data.size() != impulseSize) {
+				printf("Not caching HRTF with impulse responses of different sizes\n");
+				return;
+			}
+
+			impulseResponses.emplace_back(data.rbegin(), data.rend());
+			ear.delay.getParameters(delay);
+			delays.push_back(delay);
+		}
+	}
+
+	for(const auto& impulseResponse : impulseResponses)
+		impulseResponsePointers.push_back(impulseResponse.data());
+
+	HrtfCache::save(cacheFileName,
+	                key,
+	                transforms.size(),
+	                outputPorts.size(),
+	                impulseSize,
+	                impulseResponsePointers,
+	                delays,
+	                getMaxImpulseSize(),
+	                mixer);
 }
 
 // void BinauralSpacializer::normalizeGains() {
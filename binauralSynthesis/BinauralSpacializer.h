@@ -11,6 +11,8 @@
 
 #include "Convolver.h"
 #include "DelayFilter.h"
+#include "HrtfCache.h"
+#include "PartitionedConvolver.h"
 
 class BinauralSpacializer {
 public:
@@ -27,6 +29,12 @@ protected:
 	                    size_t* numChannels,
 	                    const std::string& speakerPlacement);
 	void normalizeGains();
+	size_t getMaxImpulseSize();
+	void initMixer(size_t blockSize, size_t maxImpulseSize);
+	void computeMixerPartitions();
+
+	bool loadFromCache(const std::string& cacheFileName, const HrtfCache::Key& key, size_t* numChannels);
+	void saveToCache(const std::string& cacheFileName, const HrtfCache::Key& key);
 
 private:
 	struct SourceToEarTransformation {
@@ -44,6 +52,7 @@ private:
 
 	std::unique_ptr<struct MYSOFA_EASY, void (*)(struct MYSOFA_EASY* easy)> mysofaHandle;
 	std::vector<SourceToEarTransformation> transforms;
+	PartitionedConvolver mixer;
 
 	float sampleRate;
 };
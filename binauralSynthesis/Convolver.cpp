@@ -5,14 +5,17 @@
 #include <stdio.h>
 #include <string.h>
 
-int Convolver::setConvolver(float* samples, size_t bufferSize) {
+int Convolver::setConvolver(const float* samples, size_t bufferSize) {
 	convolverSignal.clear();
 	std::reverse_copy(samples, samples + bufferSize, std::back_inserter(convolverSignal));
 
 	currentHistoryPos = 0;
 	std::fill_n(history.begin(), history.size(), 0);
 
-	if(bufferSize + convolverSignal.size() + 1 > history.size()) {
+	preparePartitions();
+
+	// Only the direct convolution, used until a block size is set, is limited by the history size
+	if(blockSize == 0 && bufferSize + convolverSignal.size() + 1 > history.size()) {
 		printf("Pulse or buffer size too large: %d > %d\n",
 		       (int) (bufferSize + convolverSignal.size() + 1),
 		       (int) history.size());
@@ -22,12 +25,48 @@ int Convolver::setConvolver(float* samples, size_t bufferSize) {
 	return 0;
 }
 
+void Convolver::setBlockSize(size_t blockSize) {
+	if(this->blockSize == blockSize)
+		return;
+
+	this->blockSize = blockSize;
+	preparePartitions();
+}
+
+void Convolver::preparePartitions() {
+	if(blockSize == 0)
+		return;
+
+	// convolver signal is reversed
+	std::vector<float> impulseResponse(convolverSignal.rbegin(), convolverSignal.rend());
+
+	partitioned.init(1, 1, blockSize, impulseResponse.size());
+	partitioned.setImpulseResponse(0, 0, impulseResponse.data(), impulseResponse.size());
+}
+
 void Convolver::processSamples(float* out, float* in, size_t nframes) {
+	if(nframes != blockSize || partitioned.getBlockSize() == 0) {
+		processSamplesDirect(out, in, nframes);
+		return;
+	}
+
+	const float* inputs[] = {in};
+	float* outputs[] = {out};
+	partitioned.processSamples(outputs, inputs, nframes);
+}
+
+void Convolver::processSamplesDirect(float* out, float* in, size_t nframes) {
 	const size_t convolverSignalSize = this->convolverSignal.size();
 	static const size_t historySize = this->history.size();
 	const float* convolverSignal = &this->convolverSignal[0];
 	float* history = &this->history[0];
 
+	// Pulse too long for the history, only the partitioned convolution can process it
+	if(nframes + convolverSignalSize + 1 > historySize) {
+		std::fill_n(out, nframes, 0.0f);
+		return;
+	}
+
 	// Copy input to history
 	size_t nextCopySize = std::min(historySize - currentHistoryPos, nframes);
 	std::copy_n(in, nextCopySize, history + currentHistoryPos);
@@ -75,6 +114,7 @@ void Convolver::normalize(float multiplier) {
 	for(size_t i = 0; i < convolverSignalSize; i++) {
 		this->convolverSignal[i] *= multiplier;
 	}
+	preparePartitions();
 }
 
 void Convolver::normalize(float* normalizer) {
@@ -4,18 +4,37 @@
 #include <stdlib.h>
 #include <vector>
 
+#include "PartitionedConvolver.h"
+
+/*
+ * FIR convolver using uniformly partitioned overlap-save convolution, see PartitionedConvolver.
+ *
+ * The impulse response is split in partitions of blockSize samples, each one transformed once in setConvolver().
+ *
+ * When processSamples() is called with a different block size than setBlockSize(), it falls back to direct
+ * convolution. Direct convolution is limited to impulse responses shorter than its history and outputs silence for
+ * longer ones.
+ */
 class Convolver {
 public:
-	int setConvolver(float* samples, size_t bufferSize);
+	int setConvolver(const float* samples, size_t bufferSize);
+	void setBlockSize(size_t blockSize);
 	void processSamples(float* out, float* in, size_t nframes);
+	void processSamplesDirect(float* out, float* in, size_t nframes);
 	float getGain(float freq, float sampleRate) const;
 	void normalize(float multiplier);
 	const std::vector<float>& getData() const { return convolverSignal; }
 	void normalize(float* normalizer);
 	void extendLowFrequencies();
 
+protected:
+	void preparePartitions();
+
 private:
 	std::vector<float> convolverSignal;
 	std::array<float, 8192> history;
 	size_t currentHistoryPos;
+
+	size_t blockSize = 0;
+	PartitionedConvolver partitioned;
 };
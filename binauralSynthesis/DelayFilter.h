@@ -10,7 +10,7 @@ public:
 	float processOneSample(float input);
 
 	void setParameters(unsigned int delay);
-	void getParameters(unsigned int& delay) { delay = this->delay; }
+	void getParameters(unsigned int& delay) const { delay = this->delay; }
 
 private:
 	std::vector<float> delayedSamples;
@@ -1,18 +1,17 @@
 #include "DiscreteFourierTransform.h"
+#include "FftService.h"
+#include <algorithm>
 #include <complex>
 #include <math.h>
 
-#include "fftw3.h"
-
 void DiscreteFourierTransform::dft(size_t n, const float* timeDomain, std::complex<float>* freqDomain) {
-	fftwf_plan plan;
-	fftwf_complex* out = reinterpret_cast<fftwf_complex*>(freqDomain);
-
-	static_assert(sizeof(freqDomain[0]) == sizeof(fftwf_complex), "cannot cast std::complex to fftwf_complex");
+	// Plans require aligned buffers
+	FftService::Buffer<float> in = FftService::allocateReal(n);
+	FftService::Buffer<std::complex<float>> out = FftService::allocateComplex(n / 2 + 1);
 
-	plan = fftwf_plan_dft_r2c_1d(n, (float*) timeDomain, out, FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
-	fftwf_execute(plan);
-	fftwf_destroy_plan(plan);
+	std::copy_n(timeDomain, n, in.get());
+	FftService::getForwardPlan(n)->execute(in.get(), out.get());
+	std::copy_n(out.get(), n / 2 + 1, freqDomain);
 	//	for(size_t k = 0; k < n; k++) {
 	//		std::complex<float> sum = 0;
 	//		std::complex<float> factor = exp(std::complex<float>(0, -2 * M_PI * k / n));
@@ -24,14 +23,13 @@ void DiscreteFourierTransform::dft(size_t n, const float* timeDomain, std::compl
 }
 
 void DiscreteFourierTransform::idft(size_t n, const std::complex<float>* freqDomain, float* timeDomain) {
-	fftwf_plan plan;
-	fftwf_complex* in = (fftwf_complex*) (freqDomain);
-
-	static_assert(sizeof(freqDomain[0]) == sizeof(fftwf_complex), "cannot cast std::complex to fftwf_complex");
+	// The inverse transform overwrites its input
+	FftService::Buffer<std::complex<float>> in = FftService::allocateComplex(n / 2 + 1);
+	FftService::Buffer<float> out = FftService::allocateReal(n);
 
-	plan = fftwf_plan_dft_c2r_1d(n, in, timeDomain, FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
-	fftwf_execute(plan);
-	fftwf_destroy_plan(plan);
+	std::copy_n(freqDomain, n / 2 + 1, in.get());
+	FftService::getInversePlan(n)->execute(in.get(), out.get());
+	std::copy_n(out.get(), n, timeDomain);
 
 	//	for(size_t k = 0; k < n; k++) {
 	//		float sum = 0;
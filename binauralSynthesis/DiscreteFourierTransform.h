@@ -1,6 +1,7 @@
 #pragma once
 
 #include <complex>
+#include <stddef.h>
 
 class DiscreteFourierTransform {
 public:
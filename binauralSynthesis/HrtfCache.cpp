@@ -0,0 +1,280 @@
+#include "HrtfCache.h"
+#include "PartitionedConvolver.h"
+#include <Utils.h>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char CACHE_MAGIC[8] = {'D', 'A', 'M', 'C', 'H', 'R', 'T', 'F'};
+static const uint32_t CACHE_VERSION = 1;
+
+static uint64_t alignOffset(uint64_t offset) {
+	return (offset + 63) & ~uint64_t(63);
+}
+
+HrtfCache::HrtfCache()
+    : header(nullptr),
+      data(nullptr),
+      dataSize(0)
+#ifdef _WIN32
+      ,
+      fileHandle(INVALID_HANDLE_VALUE),
+      mappingHandle(nullptr)
+#endif
+{
+}
+
+HrtfCache::~HrtfCache() {
+	close();
+}
+
+bool HrtfCache::computeFileHash(const std::string& fileName, uint64_t* hash) {
+	std::vector<uint8_t> buffer(1024 * 1024);
+	FILE* file = fopen(fileName.c_str(), "rb");
+	if(!file)
+		return false;
+
+	// FNV-1a
+	uint64_t value = 0xcbf29ce484222325ULL;
+	size_t readSize;
+	while((readSize = fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+		for(size_t i = 0; i < readSize; i++) {
+			value ^= buffer[i];
+			value *= 0x100000001b3ULL;
+		}
+	}
+
+	fclose(file);
+	*hash = value;
+
+	return true;
+}
+
+std::string HrtfCache::getCacheFileName(const std::string& sofaFileName, const Key& key) {
+	return sofaFileName + "." + std::to_string(key.sampleRate) + "-" + key.speakerPlacement + "-" +
+	       std::to_string(key.blockSize) + ".hrtfcache";
+}
+
+void HrtfCache::fillHeader(Header* header, const Key& key) {
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, CACHE_MAGIC, sizeof(header->magic));
+	header->version = CACHE_VERSION;
+	header->headerSize = sizeof(*header);
+	header->sofaHash = key.sofaHash;
+	header->sampleRate = key.sampleRate;
+	header->blockSize = key.blockSize;
+	strncpy(header->speakerPlacement, key.speakerPlacement.c_str(), sizeof(header->speakerPlacement) - 1);
+}
+
+bool HrtfCache::save(const std::string& fileName,
+                     const Key& key,
+                     size_t inputNumber,
+                     size_t outputNumber,
+                     size_t impulseSize,
+                     const std::vector<const float*>& impulseResponses,
+                     const std::vector<uint32_t>& delays,
+                     size_t maxImpulseSize,
+                     const PartitionedConvolver& mixer) {
+	Header header;
+	size_t transformNumber = inputNumber * outputNumber;
+	size_t spectraSize = mixer.getPartitionCount() * mixer.getSpectrumStride();
+
+	fillHeader(&header, key);
+	header.inputNumber = inputNumber;
+	header.outputNumber = outputNumber;
+	header.impulseSize = impulseSize;
+	header.maxImpulseSize = maxImpulseSize;
+	header.partitionCount = mixer.getPartitionCount();
+	header.spectrumStride = mixer.getSpectrumStride();
+	header.delaysOffset = alignOffset(sizeof(header));
+	header.impulseResponsesOffset = alignOffset(header.delaysOffset + transformNumber * sizeof(uint32_t));
+	header.partitionsOffset =
+	    alignOffset(header.impulseResponsesOffset + transformNumber * impulseSize * sizeof(float));
+	header.fileSize = header.partitionsOffset + transformNumber * spectraSize * sizeof(std::complex<float>);
+
+	auto writeFile = [&](const std::string& temporaryFileName) {
+		FILE* file = fopen(temporaryFileName.c_str(), "wb");
+		if(!file)
+			return false;
+
+		auto writeAt = [file](uint64_t offset, const void* data, size_t size) {
+			static const uint8_t padding[64] = {};
+			long position = ftell(file);
+			if(position < 0 || (uint64_t) position > offset)
+				return false;
+			if(fwrite(padding, 1, offset - position, file) != offset - position)
+				return false;
+			return fwrite(data, 1, size, file) == size;
+		};
+
+		bool success = writeAt(0, &header, sizeof(header)) &&
+		               writeAt(header.delaysOffset, delays.data(), transformNumber * sizeof(uint32_t));
+		for(size_t i = 0; success && i < transformNumber; i++) {
+			success = writeAt(header.impulseResponsesOffset + i * impulseSize * sizeof(float),
+			                  impulseResponses[i],
+			                  impulseSize * sizeof(float));
+		}
+		for(size_t i = 0; success && i < transformNumber; i++) {
+			success = writeAt(header.partitionsOffset + i * spectraSize * sizeof(std::complex<float>),
+			                  mixer.getPartitions(i / outputNumber, i % outputNumber),
+			                  spectraSize * sizeof(std::complex<float>));
+		}
+
+		return (fclose(file) == 0) && success;
+	};
+
+	if(!Utils::writeFileAtomically(fileName, writeFile)) {
+		printf("Failed to write HRTF cache file %s\n", fileName.c_str());
+		return false;
+	}
+
+	printf("Saved HRTF cache to %s\n", fileName.c_str());
+
+	return true;
+}
+
+bool HrtfCache::open(const std::string& fileName, const Key& key) {
+	Header expectedHeader;
+
+	close();
+
+	if(!map(fileName))
+		return false;
+
+	fillHeader(&expectedHeader, key);
+	header = reinterpret_cast<const Header*>(data);
+
+	if(dataSize < sizeof(Header) || memcmp(header->magic, expectedHeader.magic, sizeof(header->magic)) != 0 ||
+	   header->version != expectedHeader.version || header->headerSize != expectedHeader.headerSize) {
+		printf("Ignoring invalid HRTF cache file %s\n", fileName.c_str());
+		close();
+		return false;
+	}
+
+	if(header->sofaHash != expectedHeader.sofaHash || header->sampleRate != expectedHeader.sampleRate ||
+	   header->blockSize != expectedHeader.blockSize ||
+	   memcmp(header->speakerPlacement, expectedHeader.speakerPlacement, sizeof(header->speakerPlacement)) != 0) {
+		printf("Ignoring outdated HRTF cache file %s\n", fileName.c_str());
+		close();
+		return false;
+	}
+
+	size_t transformNumber = (size_t) header->inputNumber * header->outputNumber;
+	uint64_t expectedSize = header->partitionsOffset + transformNumber * header->partitionCount *
+	                                                       header->spectrumStride * sizeof(std::complex<float>);
+	// Sections follow each other in this order: header, delays, impulse responses and partitions
+	if(header->fileSize != dataSize || expectedSize != dataSize || header->delaysOffset < header->headerSize ||
+	   header->delaysOffset + transformNumber * sizeof(uint32_t) > header->impulseResponsesOffset ||
+	   header->impulseResponsesOffset + transformNumber * header->impulseSize * sizeof(float) >
+	       header->partitionsOffset ||
+	   header->partitionsOffset > dataSize) {
+		printf("Ignoring truncated HRTF cache file %s\n", fileName.c_str());
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+const float* HrtfCache::getImpulseResponse(size_t input, size_t output) const {
+	size_t index = input * header->outputNumber + output;
+	return reinterpret_cast<const float*>(data + header->impulseResponsesOffset) + index * header->impulseSize;
+}
+
+uint32_t HrtfCache::getDelay(size_t input, size_t output) const {
+	size_t index = input * header->outputNumber + output;
+	return reinterpret_cast<const uint32_t*>(data + header->delaysOffset)[index];
+}
+
+const std::complex<float>* HrtfCache::getPartitions(size_t input, size_t output) const {
+	size_t index = input * header->outputNumber + output;
+	return reinterpret_cast<const std::complex<float>*>(data + header->partitionsOffset) +
+	       index * header->partitionCount * header->spectrumStride;
+}
+
+#ifdef _WIN32
+bool HrtfCache::map(const std::string& fileName) {
+	LARGE_INTEGER fileSize;
+
+	fileHandle =
+	    CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	if(!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(!mappingHandle) {
+		close();
+		return false;
+	}
+
+	data = (const uint8_t*) MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if(!data) {
+		close();
+		return false;
+	}
+	dataSize = fileSize.QuadPart;
+
+	return true;
+}
+
+void HrtfCache::close() {
+	if(data)
+		UnmapViewOfFile(data);
+	if(mappingHandle)
+		CloseHandle(mappingHandle);
+	if(fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+
+	header = nullptr;
+	data = nullptr;
+	dataSize = 0;
+	mappingHandle = nullptr;
+	fileHandle = INVALID_HANDLE_VALUE;
+}
+#else
+bool HrtfCache::map(const std::string& fileName) {
+	struct stat fileStat;
+
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+
+	if(fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(mapping == MAP_FAILED)
+		return false;
+
+	data = (const uint8_t*) mapping;
+	dataSize = fileStat.st_size;
+
+	return true;
+}
+
+void HrtfCache::close() {
+	if(data)
+		munmap((void*) data, dataSize);
+
+	header = nullptr;
+	data = nullptr;
+	dataSize = 0;
+}
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <complex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class PartitionedConvolver;
+
+/*
+ * Cache of post-processed HRIRs and their partition spectra, to skip SOFA loading and normalization on later starts.
+ *
+ * The cache file is stored next to the SOFA file. It is keyed on a hash of the SOFA file content, the sample rate,
+ * the speaker placement and the block size used for partitions. All arrays are stored at 64 bytes aligned offsets
+ * so they are used directly from the memory mapped file.
+ */
+class HrtfCache {
+public:
+	struct Key {
+		uint64_t sofaHash;
+		uint32_t sampleRate;
+		uint32_t blockSize;
+		std::string speakerPlacement;
+	};
+
+	HrtfCache();
+	~HrtfCache();
+
+	static bool computeFileHash(const std::string& fileName, uint64_t* hash);
+	static std::string getCacheFileName(const std::string& sofaFileName, const Key& key);
+
+	// impulseResponses and delays are indexed by input * outputNumber + output
+	static bool save(const std::string& fileName,
+	                 const Key& key,
+	                 size_t inputNumber,
+	                 size_t outputNumber,
+	                 size_t impulseSize,
+	                 const std::vector<const float*>& impulseResponses,
+	                 const std::vector<uint32_t>& delays,
+	                 size_t maxImpulseSize,
+	                 const PartitionedConvolver& mixer);
+
+	// Map the cache file, return false if it doesn't exist or doesn't match the key
+	bool open(const std::string& fileName, const Key& key);
+	void close();
+
+	size_t getInputNumber() const { return header->inputNumber; }
+	size_t getOutputNumber() const { return header->outputNumber; }
+	size_t getImpulseSize() const { return header->impulseSize; }
+	size_t getMaxImpulseSize() const { return header->maxImpulseSize; }
+	size_t getPartitionCount() const { return header->partitionCount; }
+	size_t getSpectrumStride() const { return header->spectrumStride; }
+
+	const float* getImpulseResponse(size_t input, size_t output) const;
+	uint32_t getDelay(size_t input, size_t output) const;
+	const std::complex<float>* getPartitions(size_t input, size_t output) const;
+
+protected:
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t headerSize;
+		uint64_t sofaHash;
+		uint32_t sampleRate;
+		uint32_t blockSize;
+		char speakerPlacement[32];
+		uint32_t inputNumber;
+		uint32_t outputNumber;
+		uint32_t impulseSize;
+		uint32_t maxImpulseSize;
+		uint32_t partitionCount;
+		uint32_t spectrumStride;
+		uint64_t delaysOffset;
+		uint64_t impulseResponsesOffset;
+		uint64_t partitionsOffset;
+		uint64_t fileSize;
+	};
+
+	static void fillHeader(Header* header, const Key& key);
+	bool map(const std::string& fileName);
+
+private:
+	const Header* header;
+	const uint8_t* data;
+	size_t dataSize;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+};
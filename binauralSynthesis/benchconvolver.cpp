@@ -0,0 +1,135 @@
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "Convolver.h"
+#include "PartitionedConvolver.h"
+
+static const size_t INPUT_NUMBER = 8;
+static const size_t OUTPUT_NUMBER = 2;
+static const size_t CONVOLVER_NUMBER = INPUT_NUMBER * OUTPUT_NUMBER;
+
+// Compare the partitioned convolver against direct convolution and the frequency domain mixer with 8 sources x 2 ears
+int main(int argc, char* argv[]) {
+	static const int SAMPLE_RATE = 48000;
+	static const int DURATION_SECONDS = 10;
+
+	size_t filterLength = argc > 1 ? atoi(argv[1]) : 512;
+	size_t blockSize = argc > 2 ? atoi(argv[2]) : 256;
+
+	std::vector<float> impulseResponse(filterLength);
+	std::vector<float> input(blockSize);
+	std::vector<float> outputDirect(blockSize);
+	std::vector<float> outputPartitioned(blockSize);
+	std::vector<Convolver> directConvolvers(CONVOLVER_NUMBER);
+	std::vector<Convolver> partitionedConvolvers(CONVOLVER_NUMBER);
+	PartitionedConvolver mixer;
+	std::vector<std::vector<float>> inputs(INPUT_NUMBER, std::vector<float>(blockSize));
+	std::vector<std::vector<float>> outputsSeparate(OUTPUT_NUMBER, std::vector<float>(blockSize));
+	std::vector<std::vector<float>> outputsMixer(OUTPUT_NUMBER, std::vector<float>(blockSize));
+	const float* inputPointers[INPUT_NUMBER];
+	float* outputPointers[OUTPUT_NUMBER];
+
+	srand(0);
+	for(size_t i = 0; i < filterLength; i++) {
+		impulseResponse[i] = (rand() / (float) RAND_MAX - 0.5f) * expf(-(float) i / (filterLength / 4));
+	}
+
+	for(size_t i = 0; i < CONVOLVER_NUMBER; i++) {
+		directConvolvers[i].setConvolver(impulseResponse.data(), impulseResponse.size());
+		partitionedConvolvers[i].setBlockSize(blockSize);
+		partitionedConvolvers[i].setConvolver(impulseResponse.data(), impulseResponse.size());
+	}
+
+	mixer.init(INPUT_NUMBER, OUTPUT_NUMBER, blockSize, impulseResponse.size());
+	for(size_t i = 0; i < INPUT_NUMBER; i++) {
+		inputPointers[i] = inputs[i].data();
+		for(size_t j = 0; j < OUTPUT_NUMBER; j++)
+			mixer.setImpulseResponse(i, j, impulseResponse.data(), impulseResponse.size());
+	}
+	for(size_t j = 0; j < OUTPUT_NUMBER; j++)
+		outputPointers[j] = outputsMixer[j].data();
+
+	size_t blockNumber = DURATION_SECONDS * SAMPLE_RATE / blockSize;
+	double directTime = 0;
+	double partitionedTime = 0;
+	float maxError = 0;
+
+	printf("Convolving %d seconds with %d convolvers, filter length %d, block size %d\n",
+	       DURATION_SECONDS,
+	       (int) CONVOLVER_NUMBER,
+	       (int) filterLength,
+	       (int) blockSize);
+
+	for(size_t block = 0; block < blockNumber; block++) {
+		for(size_t i = 0; i < blockSize; i++)
+			input[i] = rand() / (float) RAND_MAX - 0.5f;
+
+		for(size_t i = 0; i < CONVOLVER_NUMBER; i++) {
+			auto start = std::chrono::steady_clock::now();
+			directConvolvers[i].processSamplesDirect(outputDirect.data(), input.data(), blockSize);
+			auto middle = std::chrono::steady_clock::now();
+			partitionedConvolvers[i].processSamples(outputPartitioned.data(), input.data(), blockSize);
+			auto end = std::chrono::steady_clock::now();
+
+			directTime += std::chrono::duration<double>(middle - start).count();
+			partitionedTime += std::chrono::duration<double>(end - middle).count();
+
+			for(size_t j = 0; j < blockSize; j++)
+				maxError = std::max(maxError, fabsf(outputDirect[j] - outputPartitioned[j]));
+		}
+	}
+
+	printf("Direct:      %8.3f ms, %6.2f%% of realtime\n", directTime * 1000, directTime * 100 / DURATION_SECONDS);
+	printf("Partitioned: %8.3f ms, %6.2f%% of realtime\n",
+	       partitionedTime * 1000,
+	       partitionedTime * 100 / DURATION_SECONDS);
+	printf("Speedup: %.2fx, max error: %g\n", directTime / partitionedTime, maxError);
+
+	// Mix all inputs to each output, with one convolver per input and output or with the mixer
+	double separateTime = 0;
+	double mixerTime = 0;
+	float maxMixerError = 0;
+
+	// Restart from silence like the mixer
+	for(size_t i = 0; i < CONVOLVER_NUMBER; i++)
+		partitionedConvolvers[i].setConvolver(impulseResponse.data(), impulseResponse.size());
+
+	for(size_t block = 0; block < blockNumber; block++) {
+		for(size_t i = 0; i < INPUT_NUMBER; i++) {
+			for(size_t j = 0; j < blockSize; j++)
+				inputs[i][j] = rand() / (float) RAND_MAX - 0.5f;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		for(size_t j = 0; j < OUTPUT_NUMBER; j++) {
+			std::fill(outputsSeparate[j].begin(), outputsSeparate[j].end(), 0.0f);
+			for(size_t i = 0; i < INPUT_NUMBER; i++) {
+				partitionedConvolvers[i * OUTPUT_NUMBER + j].processSamples(
+				    outputPartitioned.data(), inputs[i].data(), blockSize);
+				for(size_t k = 0; k < blockSize; k++)
+					outputsSeparate[j][k] += outputPartitioned[k];
+			}
+		}
+		auto middle = std::chrono::steady_clock::now();
+		mixer.processSamples(outputPointers, inputPointers, blockSize);
+		auto end = std::chrono::steady_clock::now();
+
+		separateTime += std::chrono::duration<double>(middle - start).count();
+		mixerTime += std::chrono::duration<double>(end - middle).count();
+
+		for(size_t j = 0; j < OUTPUT_NUMBER; j++) {
+			for(size_t k = 0; k < blockSize; k++)
+				maxMixerError = std::max(maxMixerError, fabsf(outputsSeparate[j][k] - outputsMixer[j][k]));
+		}
+	}
+
+	printf("Mixing %d inputs to %d outputs\n", (int) INPUT_NUMBER, (int) OUTPUT_NUMBER);
+	printf("Separate:    %8.3f ms, %6.2f%% of realtime\n", separateTime * 1000, separateTime * 100 / DURATION_SECONDS);
+	printf("Mixer:       %8.3f ms, %6.2f%% of realtime\n", mixerTime * 1000, mixerTime * 100 / DURATION_SECONDS);
+	printf("Speedup: %.2fx, max error: %g\n", separateTime / mixerTime, maxMixerError);
+
+	return maxError < 1e-3f && maxMixerError < 1e-3f ? 0 : 1;
+}
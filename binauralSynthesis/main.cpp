@@ -8,6 +8,7 @@
 #include <mysofa.h>
 
 #include "BinauralSpacializer.h"
+#include "FftService.h"
 
 /*
  * Postprocessing of SOFA HRTF :
@@ -47,6 +48,8 @@ int main(int argc, char* argv[]) {
 	if(argc >= 3)
 		filename = argv[2];
 
+	FftService::setWisdomFile("binauralSynthesis.wisdom");
+
 	uv_tty_init(uv_default_loop(), &ttyRead, 0, 1);
 	ttyRead.data = &binauralSpacializer;
 	uv_read_start((uv_stream_t*) &ttyRead, &onTtyAllocBuffer, &onTtyRead);
@@ -0,0 +1,120 @@
+#include "BiquadCascade.h"
+#include <SimdVector.h>
+
+#include <algorithm>
+#include <string.h>
+
+namespace {
+
+struct ProcessContext {
+	const BiquadCascade::Band* bands;
+	size_t numBands;
+	float** output;
+	const float** input;
+	size_t numChannel;
+	size_t count;
+};
+
+template<size_t N> SIMD_ALWAYS_INLINE void processLanes(const ProcessContext& context, size_t firstChannel) {
+	using Vec = Simd::Vector<double, N>;
+	static constexpr size_t CHUNK_SIZE = 64;
+
+	Vec buffer[CHUNK_SIZE];
+	Vec half;
+
+	Simd::broadcast(half, 0.5);
+
+	for(size_t offset = 0; offset < context.count; offset += CHUNK_SIZE) {
+		size_t chunkSize = std::min(CHUNK_SIZE, context.count - offset);
+
+		for(size_t i = 0; i < chunkSize; i++) {
+			for(size_t lane = 0; lane < N; lane++)
+				buffer[i][lane] = context.input[firstChannel + lane][offset + i];
+		}
+
+		for(size_t band = 0; band < context.numBands; band++) {
+			const BiquadCascade::Band& coefs = context.bands[band];
+			double* s1Data = coefs.state + firstChannel;
+			double* s2Data = coefs.state + context.numChannel + firstChannel;
+			Vec b0, b1, b2, a1, a2, s1, s2;
+
+			Simd::broadcast(b0, coefs.b0);
+			Simd::broadcast(b1, coefs.b1);
+			Simd::broadcast(b2, coefs.b2);
+			Simd::broadcast(a1, coefs.a1);
+			Simd::broadcast(a2, coefs.a2);
+			Simd::load(s1, s1Data);
+			Simd::load(s2, s2Data);
+
+			for(size_t i = 0; i < chunkSize; i++) {
+				Vec x = buffer[i];
+				Vec y = b0 * x + s1 - half;
+				s1 = s2 + b1 * x - a1 * y;
+				s2 = b2 * x - a2 * y + half;
+				buffer[i] = y;
+			}
+
+			Simd::store(s1Data, s1);
+			Simd::store(s2Data, s2);
+		}
+
+		for(size_t i = 0; i < chunkSize; i++) {
+			for(size_t lane = 0; lane < N; lane++)
+				context.output[firstChannel + lane][offset + i] = (float) buffer[i][lane];
+		}
+	}
+}
+
+SIMD_TARGET_AVX512 void processLanesAvx512(const ProcessContext& context, size_t firstChannel) {
+	processLanes<8>(context, firstChannel);
+}
+
+SIMD_TARGET_AVX2 void processLanesAvx2(const ProcessContext& context, size_t firstChannel) {
+	processLanes<4>(context, firstChannel);
+}
+
+SIMD_TARGET_SSE2 void processLanesSse2(const ProcessContext& context, size_t firstChannel) {
+	processLanes<2>(context, firstChannel);
+}
+
+void processLanesScalar(const ProcessContext& context, size_t firstChannel) {
+	processLanes<1>(context, firstChannel);
+}
+
+}  // namespace
+
+void BiquadCascade::initState(double* state, size_t numChannel) {
+	// Use offset of 0.5 to avoid denormals, like BiquadFilter
+	std::fill_n(state, 2 * numChannel, 0.5);
+}
+
+void BiquadCascade::processSamples(
+    const Band* bands, size_t numBands, float** output, const float** input, size_t numChannel, size_t count) {
+	if(numBands == 0) {
+		if(output != input) {
+			for(size_t channel = 0; channel < numChannel; channel++) {
+				std::copy_n(input[channel], count, output[channel]);
+			}
+		}
+		return;
+	}
+
+	ProcessContext context{bands, numBands, output, input, numChannel, count};
+	Simd::Level level = Simd::getLevel();
+	size_t channel = 0;
+
+	if(level >= Simd::AVX512) {
+		for(; channel + 8 <= numChannel; channel += 8)
+			processLanesAvx512(context, channel);
+	}
+	if(level >= Simd::AVX2) {
+		for(; channel + 4 <= numChannel; channel += 4)
+			processLanesAvx2(context, channel);
+	}
+	if(level >= Simd::SSE2) {
+		for(; channel + 2 <= numChannel; channel += 2)
+			processLanesSse2(context, channel);
+	}
+	for(; channel < numChannel; channel++)
+		processLanesScalar(context, channel);
+}
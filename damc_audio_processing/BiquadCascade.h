@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Multi-band, multi-channel biquad engine.
+ *
+ * All bands are run in a single pass over each block: samples of a group of channels are interleaved into SIMD lanes
+ * (1, 2, 4 or 8 channels depending on the CPU), then each band is applied in turn on that block while its state stays
+ * in registers.
+ *
+ * The arithmetic is the same transposed direct form II as BiquadFilter::put (including the 0.5 denormal offset), but
+ * intermediate results between bands are kept in double instead of being rounded to float. Output matches a chain of
+ * scalar BiquadFilter within 1e-5 absolute for a full scale input (FMA contraction on AVX2/AVX-512 and the missing
+ * float rounding between bands are the only differences).
+ */
+class BiquadCascade {
+public:
+	struct Band {
+		// Coefficients normalized by a0
+		double b0;
+		double b1;
+		double b2;
+		double a1;
+		double a2;
+
+		// s1 of each channel followed by s2 of each channel
+		double* state;
+	};
+
+	static void initState(double* state, size_t numChannel);
+	static void processSamples(
+	    const Band* bands, size_t numBands, float** output, const float** input, size_t numChannel, size_t count);
+};
@@ -2,12 +2,12 @@
 
 #include <algorithm>
 #include <math.h>
+#include <spdlog/spdlog.h>
 #include <string.h>
 
-const float CompressorFilter::LOG10_VALUE_DIV_20 = std::log(10) / 20;
-
-CompressorFilter::CompressorFilter(OscContainer* parent)
+CompressorFilter::CompressorFilter(OscContainer* parent, DspArena* arena)
     : OscContainer(parent, "compressorFilter"),
+      engine(DynamicsEngine::Compressor, arena),
       enable(this, "enable", false),
       attackTime(this, "attackTime", 0),
       releaseTime(this, "releaseTime", 2),
@@ -15,92 +15,69 @@ CompressorFilter::CompressorFilter(OscContainer* parent)
       makeUpGain(this, "makeUpGain", 0),
       ratio(this, "ratio", 1000),
       kneeWidth(this, "kneeWidth", 0),
-      useMovingMax(this, "useMovingMax", true) {
-	attackTime.addChangeCallback([this](float oscValue) { alphaA = oscValue != 0 ? expf(-1 / (oscValue * fs)) : 0; });
-	releaseTime.addChangeCallback([this](float oscValue) { alphaR = oscValue != 0 ? expf(-1 / (oscValue * fs)) : 0; });
-	ratio.addChangeCallback([this](float oscValue) { gainDiffRatio = 1 - 1 / oscValue; });
+      useMovingMax(this, "useMovingMax", true),
+      gainUpdatePeriod(this, "gainUpdatePeriod", 1) {
+	gainUpdatePeriod.addCheckCallback([this](int32_t newValue) {
+		if(newValue < 1 || newValue > 256) {
+			SPDLOG_ERROR("{}: gain update period must be between 1 and 256 samples: {}",
+			             gainUpdatePeriod.getFullAddress(),
+			             newValue);
+			return false;
+		}
+		return true;
+	});
+
+	auto onChangeCallback = [this](auto) { publishParameters(); };
+	enable.addChangeCallback(onChangeCallback);
+	attackTime.addChangeCallback(onChangeCallback);
+	releaseTime.addChangeCallback(onChangeCallback);
+	threshold.addChangeCallback(onChangeCallback);
+	makeUpGain.addChangeCallback(onChangeCallback);
+	ratio.addChangeCallback(onChangeCallback);
+	kneeWidth.addChangeCallback(onChangeCallback);
+	useMovingMax.addChangeCallback(onChangeCallback);
+	gainUpdatePeriod.addChangeCallback(onChangeCallback);
+}
+
+void CompressorFilter::publishParameters() {
+	Parameters newParameters;
+	DynamicsEngine::Parameters& dynamics = newParameters.dynamics;
+
+	// Time constants are per level detector update, which happens every gainUpdatePeriod samples
+	float updateRate = fs / gainUpdatePeriod;
+
+	newParameters.enable = enable;
+	dynamics.alphaA = attackTime != 0 ? expf(-1 / (attackTime * updateRate)) : 0;
+	dynamics.alphaR = releaseTime != 0 ? expf(-1 / (releaseTime * updateRate)) : 0;
+	dynamics.threshold = threshold;
+	dynamics.kneeWidth = kneeWidth;
+	dynamics.gainDiffRatio = 1 - 1 / ratio;
+	dynamics.useMovingMax = useMovingMax;
+	dynamics.gainUpdatePeriod = gainUpdatePeriod;
+	dynamics.outputGain = engine.gainComputer(0, dynamics) + makeUpGain;
+
+	parameters.publish(newParameters);
 }
 
 void CompressorFilter::init(size_t numChannel) {
 	this->numChannel = numChannel;
-	perChannelData.resize(numChannel);
+	engine.init(numChannel);
 }
 
 void CompressorFilter::reset(double fs) {
 	this->fs = fs;
-	gainHoldSamples = (uint32_t) (fs / 20);
-	std::fill_n(perChannelData.begin(), numChannel, PerChannelData{});
+	engine.reset();
+	publishParameters();
 }
 
 void CompressorFilter::processSamples(float** output, const float** input, size_t count) {
-	if(enable) {
-		float staticGain = gainComputer(0) + makeUpGain;
-		for(size_t i = 0; i < count; i++) {
-			float largerCompressionDb = 0;
-			for(size_t channel = 0; channel < numChannel; channel++) {
-				float dbGain = doCompression(input[channel][i], perChannelData[channel]);
-				if(dbGain < largerCompressionDb)
-					largerCompressionDb = dbGain;
-			}
-
-			// db to ratio
-			float largerCompressionRatio = expf(LOG10_VALUE_DIV_20 * (largerCompressionDb + staticGain));
+	const Parameters& parameters = *this->parameters.acquire();
 
-			for(size_t channel = 0; channel < numChannel; channel++) {
-				output[channel][i] = largerCompressionRatio * input[channel][i];
-			}
-		}
+	if(parameters.enable) {
+		engine.processSamples(output, input, count, parameters.dynamics);
 	} else if(output != input) {
 		for(size_t channel = 0; channel < numChannel; channel++) {
 			std::copy_n(input[channel], count, output[channel]);
 		}
 	}
 }
-
-float CompressorFilter::doCompression(float sample, PerChannelData& perChannelData) {
-	if(sample == 0)
-		return 0;
-
-	float dbSample = logf(fabsf(sample)) / LOG10_VALUE_DIV_20;
-	levelDetector(gainComputer(dbSample), perChannelData);
-	return -perChannelData.yL;
-}
-
-float CompressorFilter::gainComputer(float dbSample) const {
-	float zone = 2 * (dbSample - threshold);
-	if(zone == -INFINITY || zone <= -kneeWidth) {
-		return 0;
-	} else if(zone >= kneeWidth) {
-		return gainDiffRatio * (dbSample - threshold);
-	} else {
-		float a = dbSample - threshold + kneeWidth / 2;
-		return gainDiffRatio * (a * a) / (2 * kneeWidth);
-	}
-}
-
-float CompressorFilter::PerChannelData::movingMax(float dbCompression) {
-	if(!compressionMovingMaxDeque.empty() && compressionMovingMaxDeque.front() == compressionHistoryPtr)
-		compressionMovingMaxDeque.pop_front();
-
-	while(!compressionMovingMaxDeque.empty() && dbCompression >= compressionHistory[compressionMovingMaxDeque.back()])
-		compressionMovingMaxDeque.pop_back();
-
-	compressionMovingMaxDeque.push_back(compressionHistoryPtr);
-	compressionHistory[compressionHistoryPtr] = dbCompression;
-	compressionHistoryPtr = (compressionHistoryPtr + 1) % compressionHistory.size();
-
-	return compressionHistory[compressionMovingMaxDeque.front()];
-}
-
-float CompressorFilter::PerChannelData::noProcessing(float dbCompression) {
-	return dbCompression;
-}
-
-void CompressorFilter::levelDetector(float dbCompression, PerChannelData& perChannelData) {
-	float decayedCompression = alphaR * perChannelData.y1 + (1 - alphaR) * dbCompression;
-	if(useMovingMax)
-		perChannelData.y1 = fmaxf(perChannelData.movingMax(dbCompression), decayedCompression);
-	else
-		perChannelData.y1 = fmaxf(dbCompression, decayedCompression);
-	perChannelData.yL = alphaA * perChannelData.yL + (1 - alphaA) * perChannelData.y1;
-}
@@ -1,56 +1,44 @@
 #pragma once
 
+#include "DynamicsEngine.h"
 #include <Osc/OscContainer.h>
 #include <Osc/OscVariable.h>
-#include <array>
-#include <deque>
+#include <RealtimeSnapshot.h>
 #include <stddef.h>
-#include <vector>
 
 class CompressorFilter : public OscContainer {
-protected:
-	struct PerChannelData {
-		float y1;
-		float yL;
-
-		size_t compressionHistoryPtr;
-		std::array<float, 1024> compressionHistory;
-		std::deque<size_t> compressionMovingMaxDeque;
-
-		float speed;
-
-		float movingMax(float dbCompression);
-		float noProcessing(float dbCompression);
-	};
-
 public:
-	CompressorFilter(OscContainer* parent);
+	CompressorFilter(OscContainer* parent, DspArena* arena = nullptr);
 	void init(size_t numChannel);
 	void reset(double fs);
 	void processSamples(float** output, const float** input, size_t count);
 
+	bool isEnabled() const { return enable; }
+	void addEnableChangeCallback(std::function<void(bool)> callback) { enable.addChangeCallback(callback); }
+
 protected:
-	float doCompression(float sample, PerChannelData& perChannelData);
-	float gainComputer(float sample) const;
-	void levelDetector(float sample, PerChannelData& perChannelData);
+	// Values used by the audio thread, computed from OSC variables
+	struct Parameters {
+		bool enable = false;
+		DynamicsEngine::Parameters dynamics;
+	};
+
+	void publishParameters();
 
 private:
-	size_t numChannel;
-	std::vector<PerChannelData> perChannelData;
+	size_t numChannel = 0;
+	DynamicsEngine engine;
 
 	OscVariable<bool> enable;
 	double fs = 48000;
-	float alphaR;
-	float alphaA;
 	OscVariable<float> attackTime;
 	OscVariable<float> releaseTime;
 	OscVariable<float> threshold;
 	OscVariable<float> makeUpGain;
 	OscVariable<float> ratio;
-	float gainDiffRatio = 0;
 	OscVariable<float> kneeWidth;
-	uint32_t gainHoldSamples = 48000 / 20;  // 20Hz period
 	OscVariable<bool> useMovingMax;
+	OscVariable<int32_t> gainUpdatePeriod;
 
-	static const float LOG10_VALUE_DIV_20;
+	RealtimeSnapshot<Parameters> parameters;
 };
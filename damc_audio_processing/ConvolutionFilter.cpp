@@ -0,0 +1,255 @@
+#include "ConvolutionFilter.h"
+
+#include <RealtimeThread.h>
+#include <WavFile.h>
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+ConvolutionFilter::Engine::Engine(const std::vector<std::vector<float>>& impulseResponse,
+                                  size_t numChannel,
+                                  size_t blockSize)
+    : numChannel(numChannel), blockSize(blockSize), tailBlockSize(blockSize * TAIL_BLOCK_RATIO) {
+	size_t headSize = 2 * tailBlockSize;
+
+	heads.resize(numChannel);
+	for(size_t channel = 0; channel < numChannel; channel++) {
+		const std::vector<float>& samples = impulseResponse[channel % impulseResponse.size()];
+
+		heads[channel].init(1, 1, blockSize, std::min(samples.size(), headSize));
+		heads[channel].setImpulseResponse(0, 0, samples.data(), std::min(samples.size(), headSize));
+		if(samples.size() > headSize) {
+			tails.resize(numChannel);
+			tails[channel].init(1, 1, tailBlockSize, samples.size() - headSize);
+			tails[channel].setImpulseResponse(0, 0, samples.data() + headSize, samples.size() - headSize);
+		}
+	}
+
+	uv_sem_init(&semaphore, 0);
+
+	if(!tails.empty()) {
+		tailInputs.resize(2 * numChannel * tailBlockSize, 0.0f);
+		tailOutputs.resize(2 * numChannel * tailBlockSize, 0.0f);
+
+		// Channels with a short IR get a silent tail
+		for(PartitionedConvolver& tail : tails) {
+			if(tail.getBlockSize() == 0)
+				tail.init(1, 1, tailBlockSize, 0);
+		}
+
+		worker = std::thread(&Engine::runWorker, this);
+	}
+}
+
+ConvolutionFilter::Engine::~Engine() {
+	if(worker.joinable()) {
+		stopping = true;
+		uv_sem_post(&semaphore);
+		worker.join();
+	}
+	uv_sem_destroy(&semaphore);
+}
+
+void ConvolutionFilter::Engine::runWorker() {
+	uint64_t nextTailBlock = 0;
+
+	// Long tails decay into denormals, and being late on the audio thread causes tail underruns
+	RealtimeThread::setFloatingPointMode();
+	RealtimeThread::setHelperThreadPriority("convolution tail");
+
+	while(true) {
+		uv_sem_wait(&semaphore);
+		if(stopping)
+			break;
+
+		// Blocks submitted before the last one are already too late, they are skipped along with dropped ones
+		uint64_t tailBlock = submittedTailBlocks.load(std::memory_order_acquire);
+		if(tailBlock <= nextTailBlock)
+			continue;
+		tailBlock--;
+
+		workerPosition.store(tailBlock, std::memory_order_release);
+
+		for(size_t channel = 0; channel < numChannel; channel++) {
+			float* tailOutput = getTailOutput(tailBlock, channel);
+			const float* tailInput = getTailInput(tailBlock, channel);
+
+			tails[channel].skip(tailBlock - nextTailBlock);
+			tails[channel].processSamples(&tailOutput, &tailInput, tailBlockSize);
+		}
+
+		tailOutputBlocks[tailBlock % 2].store(tailBlock + 1, std::memory_order_release);
+		workerPosition.store(tailBlock + 1, std::memory_order_release);
+		nextTailBlock = tailBlock + 1;
+	}
+}
+
+ConvolutionFilter::ConvolutionFilter(OscContainer* parent)
+    : OscContainer(parent, "convolutionFilter"),
+      enable(this, "enable", false),
+      file(this, "file", ""),
+      tailUnderrunCount(this, "tailUnderrunCount", 0, false) {
+	enable.addChangeCallback([this](bool) {
+		updateEngine();
+		if(onChangeCallback)
+			onChangeCallback();
+	});
+	file.addChangeCallback([this](const std::string& newValue) {
+		if(!loadImpulseResponse(newValue))
+			impulseResponse.clear();
+		updateEngine();
+		if(onChangeCallback)
+			onChangeCallback();
+	});
+}
+
+void ConvolutionFilter::init(size_t numChannel) {
+	if(this->numChannel == numChannel)
+		return;
+
+	this->numChannel = numChannel;
+	updateEngine();
+}
+
+void ConvolutionFilter::reset(double fs, size_t blockSize) {
+	this->fs = fs;
+	this->blockSize = blockSize;
+
+	if(impulseResponseSampleRate != 0 && impulseResponseSampleRate != fs) {
+		SPDLOG_WARN("{}: impulse response sample rate {} doesn't match {}",
+		            file.getFullAddress(),
+		            impulseResponseSampleRate,
+		            fs);
+	}
+
+	updateEngine();
+}
+
+void ConvolutionFilter::setOnChangeCallback(std::function<void()> onChangeCallback) {
+	this->onChangeCallback = onChangeCallback;
+}
+
+void ConvolutionFilter::setOffline(bool offline) {
+	this->offline = offline;
+	updateEngine();
+}
+
+bool ConvolutionFilter::loadImpulseResponse(const std::string& fileName) {
+	std::vector<std::vector<float>> channels;
+	int32_t sampleRate;
+
+	impulseResponseSampleRate = 0;
+
+	if(fileName.empty())
+		return false;
+
+	if(!WavFile::read(fileName, &sampleRate, &channels))
+		return false;
+
+	if(channels.empty() || channels[0].empty()) {
+		SPDLOG_ERROR("{}: impulse response {} is empty", file.getFullAddress(), fileName);
+		return false;
+	}
+
+	// Otherwise checked when the sample rate is known in reset()
+	if(blockSize != 0 && sampleRate != fs)
+		SPDLOG_WARN("{}: impulse response sample rate {} doesn't match {}", file.getFullAddress(), sampleRate, fs);
+
+	SPDLOG_INFO("{}: loaded impulse response {} with {} channels of {} samples",
+	            file.getFullAddress(),
+	            fileName,
+	            channels.size(),
+	            channels[0].size());
+
+	impulseResponse = std::move(channels);
+	impulseResponseSampleRate = sampleRate;
+
+	return true;
+}
+
+void ConvolutionFilter::updateEngine() {
+	Parameters newParameters;
+
+	// Engines start from silence, the previous one and its worker are freed once the audio thread released it
+	newParameters.enable = enable;
+	newParameters.offline = offline;
+	if(enable && !impulseResponse.empty() && numChannel != 0 && blockSize != 0)
+		newParameters.engine = std::make_shared<Engine>(impulseResponse, numChannel, blockSize);
+
+	parameters.publish(std::move(newParameters));
+}
+
+void ConvolutionFilter::processSamples(float** output, const float** input, size_t numChannel, size_t count) {
+	const Parameters* parameters = this->parameters.acquire();
+	Engine* engine = parameters->engine.get();
+
+	if(!parameters->enable || !engine || count != engine->blockSize) {
+		for(size_t channel = 0; channel < numChannel; channel++) {
+			if(output[channel] != input[channel])
+				std::copy_n(input[channel], count, output[channel]);
+		}
+		return;
+	}
+
+	bool hasTail = !engine->tails.empty();
+	uint64_t tailBlock = engine->position / engine->tailBlockSize;
+	size_t tailOffset = engine->position % engine->tailBlockSize;
+
+	// The output of tail block N is used during tail block N + 2, which uses the same buffers
+	if(hasTail && tailOffset == 0) {
+		uint64_t lastSubmitted = engine->lastSubmittedTailBlocks[tailBlock % 2];
+
+		engine->tailInputDropped = engine->workerPosition.load(std::memory_order_acquire) < lastSubmitted;
+		if(tailBlock >= 2) {
+			engine->tailReady = engine->tailOutputBlocks[tailBlock % 2].load(std::memory_order_acquire) == tailBlock - 1;
+			if(!engine->tailReady)
+				engine->tailUnderruns++;
+		}
+	}
+
+	for(size_t channel = 0; channel < numChannel; channel++) {
+		if(channel >= engine->numChannel) {
+			if(output[channel] != input[channel])
+				std::copy_n(input[channel], count, output[channel]);
+			continue;
+		}
+
+		// Before output is written as it can be the same buffer as input
+		if(hasTail && !engine->tailInputDropped)
+			std::copy_n(input[channel], count, engine->getTailInput(tailBlock, channel) + tailOffset);
+
+		engine->heads[channel].processSamples(&output[channel], &input[channel], count);
+
+		if(hasTail && engine->tailReady) {
+			const float* tailOutput = engine->getTailOutput(tailBlock, channel) + tailOffset;
+			float* channelOutput = output[channel];
+			for(size_t i = 0; i < count; i++)
+				channelOutput[i] += tailOutput[i];
+		}
+	}
+
+	engine->position += count;
+	if(hasTail && engine->position % engine->tailBlockSize == 0 && !engine->tailInputDropped) {
+		// When rendering offline, the worker is kept one block behind so no block is ever late
+		if(parameters->offline) {
+			while(engine->workerPosition.load(std::memory_order_acquire) <
+			      engine->submittedTailBlocks.load(std::memory_order_relaxed))
+				std::this_thread::yield();
+		}
+
+		engine->lastSubmittedTailBlocks[tailBlock % 2] = tailBlock + 1;
+		engine->submittedTailBlocks.store(tailBlock + 1, std::memory_order_release);
+		uv_sem_post(&engine->semaphore);
+	}
+}
+
+void ConvolutionFilter::onFastTimer() {
+	const std::shared_ptr<Engine>& engine = parameters.get().engine;
+
+	if(engine) {
+		int32_t underruns = engine->tailUnderruns.exchange(0);
+		if(underruns)
+			tailUnderrunCount = tailUnderrunCount + underruns;
+	}
+
+	parameters.reclaim();
+}
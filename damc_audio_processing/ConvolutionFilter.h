@@ -0,0 +1,113 @@
+#pragma once
+
+#include <Osc/OscContainer.h>
+#include <Osc/OscVariable.h>
+#include <PartitionedConvolver.h>
+#include <RealtimeSnapshot.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <uv.h>
+#include <vector>
+
+/*
+ * Convolution with a long impulse response loaded from a WAV file, like room correction or cabinet IRs.
+ *
+ * This is a non-uniform partitioned convolution made of 2 uniformly partitioned segments (see PartitionedConvolver):
+ *  - the head of the IR is convolved by the audio thread using the JACK period as partition size, so no latency is
+ *    added,
+ *  - the tail of the IR is convolved by a worker thread using partitions of TAIL_BLOCK_RATIO periods. Each tail block
+ *    is computed while the audio thread accumulates the next input block and is needed one tail block later, so the
+ *    worker has TAIL_BLOCK_RATIO periods to compute it. The head covers the first 2 tail blocks of the IR for this.
+ *
+ * When the worker is late, the tail output of the block is skipped. The next input block is dropped too if the worker
+ * still reads the buffer it would be written to, and the worker only processes the last submitted block: missed blocks
+ * are handled as silence so the tail history stays aligned.
+ *
+ * IR channels are applied to strip channels in order, a mono IR is applied to all channels.
+ */
+class ConvolutionFilter : public OscContainer {
+public:
+	ConvolutionFilter(OscContainer* parent);
+
+	void init(size_t numChannel);
+	void reset(double fs, size_t blockSize);
+	// count must be the block size given to reset(), other blocks are passed through unchanged
+	void processSamples(float** output, const float** input, size_t numChannel, size_t count);
+
+	bool isEnabled() const { return enable && !impulseResponse.empty(); }
+	void setOnChangeCallback(std::function<void()> onChangeCallback);
+	// When rendering faster than realtime, wait for the tail worker instead of skipping late tail blocks
+	void setOffline(bool offline);
+
+	void onFastTimer();
+
+protected:
+	static constexpr size_t TAIL_BLOCK_RATIO = 8;
+
+	// Convolution state of a loaded IR, it owns the tail worker thread
+	struct Engine {
+		Engine(const std::vector<std::vector<float>>& impulseResponse, size_t numChannel, size_t blockSize);
+		~Engine();
+
+		float* getTailInput(uint64_t tailBlock, size_t channel) {
+			return &tailInputs[((tailBlock % 2) * numChannel + channel) * tailBlockSize];
+		}
+		float* getTailOutput(uint64_t tailBlock, size_t channel) {
+			return &tailOutputs[((tailBlock % 2) * numChannel + channel) * tailBlockSize];
+		}
+		void runWorker();
+
+		size_t numChannel;
+		size_t blockSize;
+		size_t tailBlockSize;
+		// Convolution of each channel with the head and the tail of the IR
+		std::vector<PartitionedConvolver> heads;
+		std::vector<PartitionedConvolver> tails;  // Empty when the IR fits in the head
+
+		// Input and output of the last 2 tail blocks, block N uses index N % 2
+		std::vector<float> tailInputs;
+		std::vector<float> tailOutputs;
+
+		// Audio thread only
+		uint64_t position = 0;
+		bool tailReady = false;
+		bool tailInputDropped = false;
+		uint64_t lastSubmittedTailBlocks[2] = {0, 0};  // Index + 1 of the last block submitted with each input
+
+		std::thread worker;
+		uv_sem_t semaphore;
+		std::atomic<bool> stopping{false};
+		std::atomic<uint64_t> submittedTailBlocks{0};  // Index of the last submitted block + 1
+		std::atomic<uint64_t> workerPosition{0};       // The worker doesn't read input of blocks before it anymore
+		std::atomic<uint64_t> tailOutputBlocks[2] = {{0}, {0}};  // Index + 1 of the block stored in each output
+		std::atomic<int32_t> tailUnderruns{0};
+	};
+
+	struct Parameters {
+		bool enable = false;
+		bool offline = false;
+		std::shared_ptr<Engine> engine;
+	};
+
+	bool loadImpulseResponse(const std::string& fileName);
+	void updateEngine();
+
+private:
+	size_t numChannel = 0;
+	double fs = 48000;
+	size_t blockSize = 0;
+	bool offline = false;
+	std::vector<std::vector<float>> impulseResponse;
+	int32_t impulseResponseSampleRate = 0;
+	std::function<void()> onChangeCallback;
+
+	OscVariable<bool> enable;
+	OscVariable<std::string> file;
+	OscVariable<int32_t> tailUnderrunCount;
+
+	RealtimeSnapshot<Parameters> parameters;
+};
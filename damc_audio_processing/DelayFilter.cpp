@@ -1,43 +1,89 @@
 #include "DelayFilter.h"
 
+#include <algorithm>
 #include <math.h>
 #include <string.h>
 
-DelayFilter::DelayFilter() {
+DelayFilter::DelayFilter(DspArena* arena) : arena(arena) {
 	this->inputIndex = 0;
-	this->outputIndex = 0;
-	setParameters(0);
+	this->delay = 0;
+	publishDelayLine(true);
+	activeDelayLine = delayLine.acquire();
 }
 
 void DelayFilter::reset() {
-	std::fill(this->delayedSamples.begin(), this->delayedSamples.end(), 0);
+	publishDelayLine(true);
+}
+
+void DelayFilter::updateParameters() {
+	const float* activeSamples = activeDelayLine->samples.get();
+	const DelayLine* line = delayLine.acquire();
+
+	if(line == activeDelayLine)
+		return;
+
+	activeDelayLine = line;
+	if(line->samples.get() == activeSamples)
+		return;
+
+	// Kept alive by the new line, unless several lines were published since the last block or the buffer is cleared
+	if(line->previousSamples.get() == activeSamples) {
+		// The whole previous line is the latest samples, older ones first from inputIndex
+		const float* previous = line->previousSamples.get();
+		size_t previousSize = line->previousMask + 1;
+		size_t olderCount = previousSize - inputIndex;
+
+		std::copy_n(previous, inputIndex, line->samples.get());
+		std::copy_n(previous + inputIndex, olderCount, line->samples.get() + line->mask + 1 - olderCount);
+	} else {
+		inputIndex = 0;
+	}
 }
 
 void DelayFilter::processSamples(float* output, const float* input, size_t count) {
+	updateParameters();
+
 	for(size_t i = 0; i < count; i++) {
 		output[i] = processOneSample(input[i]);
 	}
 }
 
 float DelayFilter::processOneSample(float input) {
-	delayedSamples[inputIndex] = input;
-	float output = delayedSamples[outputIndex];
-	inputIndex = (inputIndex + 1) & ((1 << power2Size) - 1);
-	outputIndex = (outputIndex + 1) & ((1 << power2Size) - 1);
+	const DelayLine* line = activeDelayLine;
+
+	line->samples[inputIndex] = input;
+	float output = line->samples[(inputIndex - line->delay) & line->mask];
+	inputIndex = (inputIndex + 1) & line->mask;
 
 	return output;
 }
 
 void DelayFilter::setParameters(unsigned int delay) {
-	int powerOfTwo;
-	int targetDelay = delay;
-
 	this->delay = delay;
+	publishDelayLine(false);
+}
 
-	powerOfTwo = 0;
-	while((1 << powerOfTwo) < (targetDelay + 1))
-		powerOfTwo++;
-	this->power2Size = powerOfTwo;
-	this->delayedSamples.resize(1 << power2Size, 0);
-	outputIndex = (inputIndex + this->delayedSamples.size() - targetDelay) & ((1 << power2Size) - 1);
+void DelayFilter::publishDelayLine(bool clearBuffer) {
+	const DelayLine& previousLine = delayLine.get();
+	DelayLine line;
+	size_t size = 1;
+
+	while(size < (size_t) delay + 1)
+		size *= 2;
+
+	line.delay = delay;
+	if(!clearBuffer && previousLine.samples && size <= previousLine.mask + 1) {
+		line.samples = previousLine.samples;
+		line.mask = previousLine.mask;
+		line.previousSamples = previousLine.previousSamples;
+		line.previousMask = previousLine.previousMask;
+	} else {
+		line.samples = DspArena::makeBuffer<float>(arena, size);
+		line.mask = size - 1;
+		if(!clearBuffer && previousLine.samples) {
+			line.previousSamples = previousLine.samples;
+			line.previousMask = previousLine.mask;
+		}
+	}
+	delayLine.publish(std::move(line));
 }
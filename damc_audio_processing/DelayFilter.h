@@ -1,23 +1,42 @@
 #pragma once
 
+#include <DspArena.h>
+#include <RealtimeSnapshot.h>
+#include <memory>
 #include <stddef.h>
-#include <vector>
 
 class DelayFilter {
 public:
-	DelayFilter();
+	explicit DelayFilter(DspArena* arena = nullptr);
 
 	void reset();
 	void processSamples(float* output, const float* input, size_t count);
 	float processOneSample(float input);
 
+	// Called by the audio thread once per block before processOneSample, done by processSamples
+	void updateParameters();
+
 	void setParameters(unsigned int delay);
 	void getParameters(unsigned int& delay) { delay = this->delay; }
 
 private:
-	std::vector<float> delayedSamples;
-	unsigned int delay;
+	struct DelayLine {
+		std::shared_ptr<float[]> samples;
+		size_t mask;
+		unsigned int delay;
+		// Line replaced by this one when it was grown, its latest samples are moved to this one when switching
+		std::shared_ptr<float[]> previousSamples;
+		size_t previousMask = 0;
+	};
+
+	void publishDelayLine(bool clearBuffer);
+
+	DspArena* arena;
+	// Published by the main thread on each change, the audio thread switches to it on next block.
+	// The buffer is kept when the new delay fits in it, so changing the delay doesn't drop the delayed samples.
+	RealtimeSnapshot<DelayLine> delayLine;
+	const DelayLine* activeDelayLine;
 	size_t inputIndex;
-	size_t outputIndex;
-	size_t power2Size;
+
+	unsigned int delay;
 };
@@ -0,0 +1,118 @@
+#include "DspProfiler.h"
+#include <algorithm>
+
+static const char* const STAGE_NAMES[DspProfiler::StageCount] = {
+    "delay", "eq", "expander", "compressor", "reverb", "convolution", "volume", "endpoint", "total"};
+
+DspProfiler::StageMeters::StageMeters(OscContainer* parent, const std::string& name)
+    : OscContainer(parent, name),
+      meanNs(this, "meanNs"),
+      p99Ns(this, "p99Ns"),
+      maxNs(this, "maxNs"),
+      periodPercent(this, "periodPercent") {}
+
+DspProfiler::DspProfiler(OscContainer* parent, TraceRecorder* trace, int32_t track)
+    : OscContainer(parent, "profiler"),
+      trace(trace),
+      track(track),
+      histograms(new Histogram[StageCount]),
+      oscEnable(this, "enable", false, false) {
+	for(const char* name : STAGE_NAMES)
+		stageMeters.emplace_back(new StageMeters(this, name));
+
+	oscEnable.addChangeCallback([this](bool newValue) { enabled.store(newValue, std::memory_order_relaxed); });
+}
+
+void DspProfiler::reset(double fs, size_t blockSize) {
+	periodNs = fs > 0 ? blockSize * 1e9 / fs : 0;
+}
+
+size_t DspProfiler::getBucket(uint64_t durationNs) {
+	if(durationNs < SUB_BUCKETS)
+		return durationNs;
+
+	// Index of the highest bit then the next SUB_BUCKET_BITS bits
+	size_t exponent = 63 - __builtin_clzll(durationNs);
+	size_t subBucket = (durationNs >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+
+	return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t DspProfiler::getBucketUpperBound(size_t bucket) {
+	if(bucket < SUB_BUCKETS)
+		return bucket;
+
+	size_t exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+	uint64_t subBucket = bucket % SUB_BUCKETS;
+
+	return ((SUB_BUCKETS + subBucket + 1) << (exponent - SUB_BUCKET_BITS)) - 1;
+}
+
+void DspProfiler::record(Stage stage, uint64_t startNs, uint64_t endNs) {
+	if(trace)
+		trace->recordDuration(track, STAGE_NAMES[stage], startNs, endNs);
+
+	if(!enabled.load(std::memory_order_relaxed))
+		return;
+
+	Histogram& histogram = histograms[stage];
+	uint64_t durationNs = endNs - startNs;
+
+	histogram.buckets[getBucket(durationNs)].fetch_add(1, std::memory_order_relaxed);
+	histogram.sumNs.fetch_add(durationNs, std::memory_order_relaxed);
+
+	uint64_t maxNs = histogram.maxNs.load(std::memory_order_relaxed);
+	while(durationNs > maxNs &&
+	      !histogram.maxNs.compare_exchange_weak(maxNs, durationNs, std::memory_order_relaxed)) {
+	}
+}
+
+void DspProfiler::recordCounter(const char* name, uint64_t timeNs, int64_t value) {
+	if(trace)
+		trace->recordCounter(track, name, timeNs, value);
+}
+
+void DspProfiler::onSlowTimer() {
+	if(!isEnabled())
+		return;
+
+	for(size_t stage = 0; stage < StageCount; stage++) {
+		Histogram& histogram = histograms[stage];
+		StageMeters& meters = *stageMeters[stage];
+		uint32_t counts[BUCKET_COUNT];
+		uint64_t count = 0;
+
+		// Each value is cleared atomically, a block recorded meanwhile is counted in this period or the next one
+		for(size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+			counts[bucket] = histogram.buckets[bucket].exchange(0, std::memory_order_relaxed);
+			count += counts[bucket];
+		}
+		uint64_t sumNs = histogram.sumNs.exchange(0, std::memory_order_relaxed);
+		uint64_t maxNs = histogram.maxNs.exchange(0, std::memory_order_relaxed);
+
+		if(count == 0) {
+			meters.meanNs.set(0);
+			meters.p99Ns.set(0);
+			meters.maxNs.set(0);
+			meters.periodPercent.set(0);
+			continue;
+		}
+
+		uint64_t p99Ns = 0;
+		uint64_t rank = (count * 99 + 99) / 100;
+		for(size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+			if(counts[bucket] >= rank) {
+				p99Ns = std::min(getBucketUpperBound(bucket), maxNs);
+				break;
+			}
+			rank -= counts[bucket];
+		}
+
+		double meanNs = (double) sumNs / count;
+
+		meters.meanNs.set(meanNs);
+		meters.p99Ns.set(p99Ns);
+		meters.maxNs.set(maxNs);
+		meters.periodPercent.set(periodNs > 0 ? meanNs * 100 / periodNs : 0);
+	}
+}
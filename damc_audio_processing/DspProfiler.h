@@ -0,0 +1,77 @@
+#pragma once
+
+#include "TraceRecorder.h"
+#include <Osc/OscContainer.h>
+#include <Osc/OscVariable.h>
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/*
+ * DSP load profiler of a channel strip.
+ *
+ * When enabled, the audio thread times each processing stage of a block and adds the duration to a histogram of that
+ * stage using relaxed atomics only. On each slow timer tick, the main thread reads and clears the histograms and
+ * publishes the mean, 99th percentile and max duration per block and the mean load relative to the period.
+ *
+ * Histogram buckets are logarithmic with 8 buckets per octave, so percentiles are accurate within 12.5%.
+ *
+ * When the trace recorder is enabled, each stage is also recorded as a trace event on the strip track.
+ */
+class DspProfiler : public OscContainer {
+public:
+	enum Stage { Delay, Eq, Expander, Compressor, Reverb, Convolution, Volume, Endpoint, Total, StageCount };
+
+	// trace can be nullptr, track is the strip track in the trace
+	DspProfiler(OscContainer* parent, TraceRecorder* trace, int32_t track);
+
+	void reset(double fs, size_t blockSize);
+
+	// Audio thread
+	bool isEnabled() const {
+		return enabled.load(std::memory_order_relaxed) || (trace && trace->isEnabled());
+	}
+	static uint64_t now() { return TraceRecorder::now(); }
+	void record(Stage stage, uint64_t startNs, uint64_t endNs);
+	// Trace only, name must be a string literal
+	void recordCounter(const char* name, uint64_t timeNs, int64_t value);
+
+	void onSlowTimer();
+
+protected:
+	static constexpr size_t SUB_BUCKET_BITS = 3;
+	static constexpr size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+	static size_t getBucket(uint64_t durationNs);
+	static uint64_t getBucketUpperBound(size_t bucket);
+
+	struct Histogram {
+		std::atomic<uint32_t> buckets[BUCKET_COUNT] = {};
+		std::atomic<uint64_t> sumNs{0};
+		std::atomic<uint64_t> maxNs{0};
+	};
+
+	class StageMeters : public OscContainer {
+	public:
+		StageMeters(OscContainer* parent, const std::string& name);
+
+		OscReadOnlyVariable<int32_t> meanNs;
+		OscReadOnlyVariable<int32_t> p99Ns;
+		OscReadOnlyVariable<int32_t> maxNs;
+		OscReadOnlyVariable<float> periodPercent;
+	};
+
+private:
+	std::atomic<bool> enabled{false};
+	double periodNs = 0;
+	TraceRecorder* trace;
+	int32_t track;
+
+	std::unique_ptr<Histogram[]> histograms;
+	std::vector<std::unique_ptr<StageMeters>> stageMeters;
+
+	OscVariable<bool> oscEnable;
+};
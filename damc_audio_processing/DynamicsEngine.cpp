@@ -0,0 +1,409 @@
+#include "DynamicsEngine.h"
+#include <SimdVector.h>
+
+#include <algorithm>
+#include <math.h>
+
+namespace {
+
+constexpr size_t CHUNK_SIZE = 64;
+
+// 20 * log10(2) and log2(10) / 20
+constexpr float DB_PER_LOG2 = 6.02059991f;
+constexpr float LOG2_PER_DB = 0.166096405f;
+
+// Expander gain of channels without signal, dbToLinear converts it to 0
+constexpr float SILENCE_DB = -1000.0f;
+
+template<size_t N> using FloatVector = Simd::Vector<float, N>;
+// Integer vector with the same lane count as the float vector V
+template<typename V> using IntVector = Simd::Vector<int32_t, sizeof(V) / sizeof(float)>;
+
+template<typename V> SIMD_ALWAYS_INLINE void fastLog2(V& result, const V& x) {
+	IntVector<V> bits = (IntVector<V>) x;
+	IntVector<V> exponent = ((bits >> 23) & 0xff) - 127;
+	V t = (V) ((bits & 0x007fffff) | 0x3f800000) - 1.0f;
+
+	// log2(1 + t) for t in [0, 1), least square fit, max error 1.7e-5
+	V p = 0.0452655046f * t - 0.193510391f;
+	p = p * t + 0.41524096f;
+	p = p * t - 0.708863876f;
+	p = p * t + 1.44187978f;
+
+	result = __builtin_convertvector(exponent, V) + p * t;
+}
+
+template<typename V> SIMD_ALWAYS_INLINE void fastExp2(V& result, const V& x) {
+	V clamped = x < -126.0f ? -126.0f : x;
+	clamped = clamped > 126.0f ? 126.0f : clamped;
+
+	// floor(clamped), comparisons return -1 when true
+	IntVector<V> integer = __builtin_convertvector(clamped, IntVector<V>);
+	integer += __builtin_convertvector(integer, V) > clamped;
+	V t = clamped - __builtin_convertvector(integer, V);
+
+	// 2^t for t in [0, 1), least square fit, max relative error 3.6e-6
+	V p = 0.0136839966f * t + 0.0517178264f;
+	p = p * t + 0.241621163f;
+	p = p * t + 0.692969621f;
+	p = p * t + 1.00000359f;
+
+	result = (V) ((integer + 127) << 23) * p;
+	result = x < -126.0f ? 0.0f : result;
+}
+
+template<typename V> SIMD_ALWAYS_INLINE void linearToDbLanes(V& result, const V& x) {
+	V absX = (V) ((IntVector<V>) x & 0x7fffffff);
+	fastLog2(result, absX);
+	result *= DB_PER_LOG2;
+}
+
+template<typename V> SIMD_ALWAYS_INLINE void dbToLinearLanes(V& result, const V& x) {
+	V log2Value = x * LOG2_PER_DB;
+	fastExp2(result, log2Value);
+}
+
+template<DynamicsEngine::Type type, typename V>
+SIMD_ALWAYS_INLINE void gainComputerLanes(V& result, const V& dbSample, const DynamicsEngine::Parameters& parameters) {
+	float kneeWidth = parameters.kneeWidth;
+	float kneeFactor = kneeWidth > 0 ? parameters.gainDiffRatio / (2 * kneeWidth) : 0;
+	V zone = 2 * (dbSample - parameters.threshold);
+
+	if(type == DynamicsEngine::Compressor) {
+		V overThreshold = dbSample - parameters.threshold;
+		V a = overThreshold + kneeWidth / 2;
+		V knee = kneeFactor * a * a;
+
+		result = zone >= kneeWidth ? parameters.gainDiffRatio * overThreshold : knee;
+		result = zone <= -kneeWidth ? 0.0f : result;
+	} else {
+		V underThreshold = parameters.threshold - dbSample;
+		V a = underThreshold + kneeWidth / 2;
+		V knee = kneeFactor * a * a;
+
+		result = zone >= kneeWidth ? 0.0f : knee;
+		result = zone <= -kneeWidth ? parameters.gainDiffRatio * underThreshold : result;
+	}
+}
+
+template<DynamicsEngine::Type type> struct GainComputerOperation {
+	const DynamicsEngine::Parameters& parameters;
+
+	template<typename V> SIMD_ALWAYS_INLINE void operator()(V& value) const {
+		linearToDbLanes(value, value);
+		gainComputerLanes<type>(value, value, parameters);
+	}
+};
+
+struct LinearToDbOperation {
+	template<typename V> SIMD_ALWAYS_INLINE void operator()(V& value) const { linearToDbLanes(value, value); }
+};
+
+struct DbToLinearOperation {
+	template<typename V> SIMD_ALWAYS_INLINE void operator()(V& value) const { dbToLinearLanes(value, value); }
+};
+
+template<size_t N, typename Operation>
+SIMD_ALWAYS_INLINE void applyOperation(const Operation& operation, float* output, const float* input, size_t count) {
+	size_t i = 0;
+
+	for(; i + N <= count; i += N) {
+		FloatVector<N> value;
+		Simd::load(value, input + i);
+		operation(value);
+		Simd::store(output + i, value);
+	}
+	for(; i < count; i++) {
+		FloatVector<1> value = {input[i]};
+		operation(value);
+		output[i] = value[0];
+	}
+}
+
+SIMD_TARGET_AVX512 void applyOperationAvx512(float* output, const float* input, size_t count, bool toDb) {
+	if(toDb)
+		applyOperation<16>(LinearToDbOperation{}, output, input, count);
+	else
+		applyOperation<16>(DbToLinearOperation{}, output, input, count);
+}
+
+SIMD_TARGET_AVX2 void applyOperationAvx2(float* output, const float* input, size_t count, bool toDb) {
+	if(toDb)
+		applyOperation<8>(LinearToDbOperation{}, output, input, count);
+	else
+		applyOperation<8>(DbToLinearOperation{}, output, input, count);
+}
+
+SIMD_TARGET_SSE2 void applyOperationSse2(float* output, const float* input, size_t count, bool toDb) {
+	if(toDb)
+		applyOperation<4>(LinearToDbOperation{}, output, input, count);
+	else
+		applyOperation<4>(DbToLinearOperation{}, output, input, count);
+}
+
+void applyOperationScalar(float* output, const float* input, size_t count, bool toDb) {
+	if(toDb)
+		applyOperation<1>(LinearToDbOperation{}, output, input, count);
+	else
+		applyOperation<1>(DbToLinearOperation{}, output, input, count);
+}
+
+void applyConversion(float* output, const float* input, size_t count, bool toDb) {
+	Simd::Level level = Simd::getLevel();
+
+	if(level >= Simd::AVX512)
+		applyOperationAvx512(output, input, count, toDb);
+	else if(level >= Simd::AVX2)
+		applyOperationAvx2(output, input, count, toDb);
+	else if(level >= Simd::SSE2)
+		applyOperationSse2(output, input, count, toDb);
+	else
+		applyOperationScalar(output, input, count, toDb);
+}
+
+}  // namespace
+
+void DynamicsEngine::MovingMax::reset() {
+	first = 0;
+	size = 0;
+	counter = 0;
+}
+
+// Inlined in the SIMD kernels, calling non-VEX code from them would cost a SSE/AVX transition on each sample
+SIMD_ALWAYS_INLINE float DynamicsEngine::MovingMax::put(float value, size_t windowSize) {
+	static constexpr uint32_t MASK = MOVING_MAX_SIZE - 1;
+	static_assert((MOVING_MAX_SIZE & MASK) == 0, "MOVING_MAX_SIZE must be a power of 2");
+
+	// Items are kept in decreasing order, the first one is the max of the window
+	if(size > 0 && items[first].expiration == counter) {
+		first = (first + 1) & MASK;
+		size--;
+	}
+
+	while(size > 0 && value >= items[(first + size - 1) & MASK].value)
+		size--;
+
+	items[(first + size) & MASK] = Item{value, (uint32_t) (counter + windowSize)};
+	size++;
+	counter++;
+
+	return items[first].value;
+}
+
+DynamicsEngine::DynamicsEngine(Type type, DspArena* arena) : type(type), arena(arena) {}
+
+void DynamicsEngine::init(size_t numChannel) {
+	this->numChannel = numChannel;
+	perChannelData = DspArena::makeBuffer<PerChannelData>(arena, numChannel);
+	reset();
+}
+
+void DynamicsEngine::reset() {
+	for(size_t channel = 0; channel < numChannel; channel++) {
+		PerChannelData& data = perChannelData[channel];
+		data.y1 = 0;
+		data.yL = 0;
+		data.movingMax.reset();
+	}
+	previousGain = 1;
+}
+
+float DynamicsEngine::gainComputer(float dbSample, const Parameters& parameters) const {
+	FloatVector<1> result;
+	FloatVector<1> value = {dbSample};
+
+	if(type == Compressor)
+		gainComputerLanes<Compressor>(result, value, parameters);
+	else
+		gainComputerLanes<Expander>(result, value, parameters);
+
+	return result[0];
+}
+
+template<DynamicsEngine::Type type>
+SIMD_ALWAYS_INLINE float DynamicsEngine::levelDetector(float gainComputerOutput,
+                                                       PerChannelData& data,
+                                                       const Parameters& parameters,
+                                                       size_t movingMaxWindow) {
+	float alphaR = parameters.alphaR;
+	float alphaA = parameters.alphaA;
+
+	if(type == Compressor) {
+		float decayedCompression = alphaR * data.y1 + (1 - alphaR) * gainComputerOutput;
+		if(parameters.useMovingMax)
+			gainComputerOutput = data.movingMax.put(gainComputerOutput, movingMaxWindow);
+		data.y1 = std::max(gainComputerOutput, decayedCompression);
+	} else {
+		data.y1 = std::min(gainComputerOutput, alphaR * data.y1 + (1 - alphaR) * gainComputerOutput);
+	}
+	data.yL = alphaA * data.yL + (1 - alphaA) * data.y1;
+
+	return -data.yL;
+}
+
+template<size_t Lanes, DynamicsEngine::Type type>
+SIMD_ALWAYS_INLINE void DynamicsEngine::processLanes(float** output,
+                                                     const float** input,
+                                                     size_t count,
+                                                     const Parameters& parameters) {
+	// Gain of channels without signal, the compressor applies no compression and the expander cuts the signal
+	static constexpr float NO_SIGNAL_GAIN = type == Compressor ? 0.0f : SILENCE_DB;
+	float gainComputerOutput[CHUNK_SIZE];
+	float gain[CHUNK_SIZE];
+	size_t gainUpdatePeriod = parameters.gainUpdatePeriod;
+	// The moving max window covers MOVING_MAX_SIZE samples whatever the update period
+	size_t movingMaxWindow = std::max<size_t>(1, MOVING_MAX_SIZE / std::max<size_t>(1, gainUpdatePeriod));
+
+	if(gainUpdatePeriod <= 1) {
+		for(size_t offset = 0; offset < count; offset += CHUNK_SIZE) {
+			size_t chunkSize = std::min(CHUNK_SIZE, count - offset);
+
+			std::fill_n(gain, chunkSize, NO_SIGNAL_GAIN);
+
+			for(size_t channel = 0; channel < numChannel; channel++) {
+				const float* channelInput = input[channel] + offset;
+				PerChannelData& data = perChannelData[channel];
+
+				applyOperation<Lanes>(
+				    GainComputerOperation<type>{parameters}, gainComputerOutput, channelInput, chunkSize);
+
+				// Samples at 0 don't update the level detector
+				for(size_t i = 0; i < chunkSize; i++) {
+					if(channelInput[i] == 0)
+						continue;
+
+					float channelGain = levelDetector<type>(gainComputerOutput[i], data, parameters, movingMaxWindow);
+					if(type == Compressor)
+						gain[i] = std::min(gain[i], channelGain);
+					else
+						gain[i] = std::max(gain[i], channelGain);
+				}
+			}
+
+			for(size_t i = 0; i < chunkSize; i++) {
+				gain[i] += parameters.outputGain;
+			}
+			applyOperation<Lanes>(DbToLinearOperation{}, gain, gain, chunkSize);
+
+			for(size_t channel = 0; channel < numChannel; channel++) {
+				const float* channelInput = input[channel] + offset;
+				float* channelOutput = output[channel] + offset;
+				size_t i = 0;
+
+				for(; i + Lanes <= chunkSize; i += Lanes) {
+					FloatVector<Lanes> value;
+					FloatVector<Lanes> channelGain;
+					Simd::load(value, channelInput + i);
+					Simd::load(channelGain, gain + i);
+					value *= channelGain;
+					Simd::store(channelOutput + i, value);
+				}
+				for(; i < chunkSize; i++) {
+					channelOutput[i] = channelInput[i] * gain[i];
+				}
+			}
+
+			previousGain = gain[chunkSize - 1];
+		}
+	} else {
+		for(size_t offset = 0; offset < count; offset += gainUpdatePeriod) {
+			size_t periodSize = std::min(gainUpdatePeriod, count - offset);
+			float linkedGain = NO_SIGNAL_GAIN;
+
+			for(size_t channel = 0; channel < numChannel; channel++) {
+				const float* channelInput = input[channel] + offset;
+				float peak = 0;
+
+				for(size_t i = 0; i < periodSize; i++) {
+					peak = std::max(peak, fabsf(channelInput[i]));
+				}
+
+				if(peak == 0)
+					continue;
+
+				FloatVector<1> value = {peak};
+				GainComputerOperation<type>{parameters}(value);
+
+				float channelGain = levelDetector<type>(value[0], perChannelData[channel], parameters, movingMaxWindow);
+				if(type == Compressor)
+					linkedGain = std::min(linkedGain, channelGain);
+				else
+					linkedGain = std::max(linkedGain, channelGain);
+			}
+
+			FloatVector<1> targetGain = {linkedGain + parameters.outputGain};
+			dbToLinearLanes(targetGain, targetGain);
+
+			// Linear interpolation from the previous gain to reach the new one at the end of the period
+			float gainStep = (targetGain[0] - previousGain) / periodSize;
+			for(size_t channel = 0; channel < numChannel; channel++) {
+				const float* channelInput = input[channel] + offset;
+				float* channelOutput = output[channel] + offset;
+
+				for(size_t i = 0; i < periodSize; i++) {
+					channelOutput[i] = channelInput[i] * (previousGain + gainStep * (i + 1));
+				}
+			}
+
+			previousGain = targetGain[0];
+		}
+	}
+}
+
+void DynamicsEngine::processSamples(float** output, const float** input, size_t count, const Parameters& parameters) {
+	Simd::Level level = Simd::getLevel();
+
+	if(level >= Simd::AVX512)
+		processAvx512(output, input, count, parameters);
+	else if(level >= Simd::AVX2)
+		processAvx2(output, input, count, parameters);
+	else if(level >= Simd::SSE2)
+		processSse2(output, input, count, parameters);
+	else
+		processScalar(output, input, count, parameters);
+}
+
+SIMD_TARGET_AVX512 void DynamicsEngine::processAvx512(float** output,
+                                                      const float** input,
+                                                      size_t count,
+                                                      const Parameters& parameters) {
+	if(type == Compressor)
+		processLanes<16, Compressor>(output, input, count, parameters);
+	else
+		processLanes<16, Expander>(output, input, count, parameters);
+}
+
+SIMD_TARGET_AVX2 void DynamicsEngine::processAvx2(float** output,
+                                                  const float** input,
+                                                  size_t count,
+                                                  const Parameters& parameters) {
+	if(type == Compressor)
+		processLanes<8, Compressor>(output, input, count, parameters);
+	else
+		processLanes<8, Expander>(output, input, count, parameters);
+}
+
+SIMD_TARGET_SSE2 void DynamicsEngine::processSse2(float** output,
+                                                  const float** input,
+                                                  size_t count,
+                                                  const Parameters& parameters) {
+	if(type == Compressor)
+		processLanes<4, Compressor>(output, input, count, parameters);
+	else
+		processLanes<4, Expander>(output, input, count, parameters);
+}
+
+void DynamicsEngine::processScalar(float** output, const float** input, size_t count, const Parameters& parameters) {
+	if(type == Compressor)
+		processLanes<1, Compressor>(output, input, count, parameters);
+	else
+		processLanes<1, Expander>(output, input, count, parameters);
+}
+
+void DynamicsEngine::linearToDb(float* output, const float* input, size_t count) {
+	applyConversion(output, input, count, true);
+}
+
+void DynamicsEngine::dbToLinear(float* output, const float* input, size_t count) {
+	applyConversion(output, input, count, false);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <DspArena.h>
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/*
+ * Gain computer and level detector shared by CompressorFilter and ExpanderFilter.
+ *
+ * Samples are processed in chunks: each channel is converted to dB and passed through the gain computer for the whole
+ * chunk with SIMD, then the level detector runs on each channel and the channels are linked by keeping the most
+ * compressed (compressor) or least attenuated (expander) gain of each sample. The linked gain is converted back to
+ * linear with SIMD and applied to all channels.
+ *
+ * dB conversions use polynomial approximations of log2 and exp2 (error below 1e-3 dB).
+ *
+ * When gainUpdatePeriod is more than 1, the level detector runs once every gainUpdatePeriod samples on the peak of
+ * each channel over that period and the linear gain is interpolated between updates.
+ */
+class DynamicsEngine {
+public:
+	enum Type { Compressor, Expander };
+
+	// Moving max window in level detector updates
+	static constexpr size_t MOVING_MAX_SIZE = 1024;
+
+	struct Parameters {
+		// Smoothing coefficients for one level detector update
+		float alphaR = 0;
+		float alphaA = 0;
+		float threshold = 0;
+		float kneeWidth = 0;
+		float gainDiffRatio = 0;
+		// Added to the computed gain in dB
+		float outputGain = 0;
+		// Compressor only, hold the max compression seen in the moving max window
+		bool useMovingMax = false;
+		uint32_t gainUpdatePeriod = 1;
+	};
+
+	// Sliding window maximum with a fixed capacity, never allocates
+	class MovingMax {
+	public:
+		void reset();
+		float put(float value, size_t windowSize);
+
+	private:
+		struct Item {
+			float value;
+			uint32_t expiration;
+		};
+		std::array<Item, MOVING_MAX_SIZE> items;
+		uint32_t first = 0;
+		uint32_t size = 0;
+		uint32_t counter = 0;
+	};
+
+	DynamicsEngine(Type type, DspArena* arena = nullptr);
+
+	void init(size_t numChannel);
+	void reset();
+	void processSamples(float** output, const float** input, size_t count, const Parameters& parameters);
+
+	float gainComputer(float dbSample, const Parameters& parameters) const;
+
+	static void linearToDb(float* output, const float* input, size_t count);
+	static void dbToLinear(float* output, const float* input, size_t count);
+
+private:
+	struct PerChannelData {
+		float y1;
+		float yL;
+		MovingMax movingMax;
+	};
+
+	template<size_t Lanes, Type type>
+	void processLanes(float** output, const float** input, size_t count, const Parameters& parameters);
+	template<Type type>
+	float levelDetector(float gainComputerOutput,
+	                    PerChannelData& data,
+	                    const Parameters& parameters,
+	                    size_t movingMaxWindow);
+
+	void processSse2(float** output, const float** input, size_t count, const Parameters& parameters);
+	void processAvx2(float** output, const float** input, size_t count, const Parameters& parameters);
+	void processAvx512(float** output, const float** input, size_t count, const Parameters& parameters);
+	void processScalar(float** output, const float** input, size_t count, const Parameters& parameters);
+
+	Type type;
+	DspArena* arena;
+	size_t numChannel = 0;
+	DspArena::Buffer<PerChannelData> perChannelData;
+
+	// Last linear gain, start point of the interpolation when gainUpdatePeriod > 1
+	float previousGain = 1;
+};
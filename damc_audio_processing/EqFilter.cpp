@@ -4,13 +4,14 @@
 #include <cmath>
 #include <string.h>
 
-EqFilter::EqFilter(OscContainer* parent, const std::string& name)
+EqFilter::EqFilter(OscContainer* parent, const std::string& name, DspArena* arena)
     : OscContainer(parent, name),
       enabled(this, "enable", false),
       filterType(this, "type", (int32_t) FilterType::None),
       f0(this, "f0", 1000),
       gain(this, "gain", 0),
-      Q(this, "Q", 0.5) {
+      Q(this, "Q", 0.5),
+      arena(arena) {
 	auto onChangeCallback = [this](auto) { computeFilter(); };
 	enabled.addChangeCallback(onChangeCallback);
 	filterType.addChangeCallback(onChangeCallback);
@@ -19,8 +20,18 @@ EqFilter::EqFilter(OscContainer* parent, const std::string& name)
 	Q.addChangeCallback(onChangeCallback);
 }
 
+EqFilter::~EqFilter() {
+	// Make sure the owner doesn't keep a reference to our state
+	isActive = false;
+	if(onChangeCallback)
+		onChangeCallback();
+}
+
 void EqFilter::init(size_t numChannel) {
-	biquadFilters.resize(numChannel);
+	this->numChannel = numChannel;
+	// Allocate a new state as the previous one might still be in use by the audio thread
+	state = DspArena::makeBuffer<double>(arena, 2 * numChannel);
+	BiquadCascade::initState(state.get(), numChannel);
 }
 
 void EqFilter::reset(double fs) {
@@ -29,35 +40,50 @@ void EqFilter::reset(double fs) {
 }
 
 void EqFilter::processSamples(float** output, const float** input, size_t count) {
-	if(enabled) {
-		for(size_t channel = 0; channel < biquadFilters.size(); channel++) {
-			BiquadFilter& biquadFilter = biquadFilters[channel];
-			float* outputChannel = output[channel];
-			const float* inputChannel = input[channel];
-
-			for(size_t i = 0; i < count; i++) {
-				outputChannel[i] = biquadFilter.put(inputChannel[i]);
-			}
-		}
+	BiquadCascade::Band band;
+
+	if(getBand(band)) {
+		BiquadCascade::processSamples(&band, 1, output, input, numChannel, count);
 	} else if(output != input) {
-		for(size_t channel = 0; channel < biquadFilters.size(); channel++) {
+		for(size_t channel = 0; channel < numChannel; channel++) {
 			std::copy_n(input[channel], count, output[channel]);
 		}
 	}
 }
 
 std::complex<double> EqFilter::getResponse(double f0) {
-	return biquadFilters.front().getResponse(f0, fs);
+	BiquadFilter biquadFilter;
+
+	biquadFilter.init(a_coefs, b_coefs);
+	return biquadFilter.getResponse(f0, fs);
 }
 
-void EqFilter::computeFilter() {
-	double a_coefs[3];
-	double b_coefs[3];
+bool EqFilter::getBand(BiquadCascade::Band& band) {
+	if(!isActive || !state || numChannel == 0)
+		return false;
+
+	band.b0 = b_coefs[0] / a_coefs[0];
+	band.b1 = b_coefs[1] / a_coefs[0];
+	band.b2 = b_coefs[2] / a_coefs[0];
+	band.a1 = a_coefs[1] / a_coefs[0];
+	band.a2 = a_coefs[2] / a_coefs[0];
+	band.state = state.get();
 
+	return true;
+}
+
+void EqFilter::setOnChangeCallback(std::function<void()> onChangeCallback) {
+	this->onChangeCallback = std::move(onChangeCallback);
+}
+
+void EqFilter::computeFilter() {
 	BiquadFilter::computeFilter(enabled, (FilterType) filterType.get(), f0, fs, gain, Q, a_coefs, b_coefs);
 
-	for(BiquadFilter& biquadFilter : biquadFilters)
-		biquadFilter.update(a_coefs, b_coefs);
+	// Identity filters are skipped
+	isActive = !(b_coefs[0] == a_coefs[0] && b_coefs[1] == 0 && b_coefs[2] == 0 && a_coefs[1] == 0 && a_coefs[2] == 0);
+
+	if(onChangeCallback)
+		onChangeCallback();
 }
 
 void EqFilter::setParameters(bool enabled, FilterType filterType, double f0, double gain, double Q) {
@@ -1,14 +1,20 @@
 #pragma once
 
+#include "BiquadCascade.h"
 #include "BiquadFilter.h"
+#include <DspArena.h>
 #include <Osc/OscContainer.h>
 #include <Osc/OscVariable.h>
 #include <complex>
+#include <functional>
+#include <memory>
 #include <stddef.h>
+#include <vector>
 
 class EqFilter : public OscContainer {
 public:
-	EqFilter(OscContainer* parent, const std::string& name);
+	EqFilter(OscContainer* parent, const std::string& name, DspArena* arena = nullptr);
+	~EqFilter();
 
 	void init(size_t numChannel);
 	void reset(double fs);
@@ -19,6 +25,12 @@ public:
 
 	std::complex<double> getResponse(double f0);
 
+	// Return false when the filter doesn't modify the signal and can be skipped
+	bool getBand(BiquadCascade::Band& band);
+	// Keep a reference on this to ensure band.state stays valid
+	const std::shared_ptr<double[]>& getState() const { return state; }
+	void setOnChangeCallback(std::function<void()> onChangeCallback);
+
 private:
 	OscVariable<bool> enabled;
 	OscVariable<int32_t> filterType;
@@ -27,7 +39,13 @@ private:
 	OscVariable<float> gain;
 	OscVariable<float> Q;
 
-	std::vector<BiquadFilter> biquadFilters;
+	size_t numChannel = 0;
+	double a_coefs[3] = {1, 0, 0};
+	double b_coefs[3] = {1, 0, 0};
+	bool isActive = false;
+	DspArena* arena;
+	std::shared_ptr<double[]> state;
+	std::function<void()> onChangeCallback;
 
 	void computeFilter();
 };
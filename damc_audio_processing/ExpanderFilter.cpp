@@ -2,92 +2,79 @@
 
 #include <algorithm>
 #include <math.h>
+#include <spdlog/spdlog.h>
 #include <string.h>
 
-ExpanderFilter::ExpanderFilter(OscContainer* parent)
+ExpanderFilter::ExpanderFilter(OscContainer* parent, DspArena* arena)
     : OscContainer(parent, "expanderFilter"),
+      engine(DynamicsEngine::Expander, arena),
       enable(this, "enable", false),
       attackTime(this, "attackTime", 0),
       releaseTime(this, "releaseTime", 8),
       threshold(this, "threshold", -50),
       makeUpGain(this, "makeUpGain", 0),
       ratio(this, "ratio", 4),
-      kneeWidth(this, "kneeWidth", 0) {
-	attackTime.addChangeCallback([this](float oscValue) { alphaA = oscValue != 0 ? expf(-1 / (oscValue * fs)) : 0; });
-	releaseTime.addChangeCallback([this](float oscValue) { alphaR = oscValue != 0 ? expf(-1 / (oscValue * fs)) : 0; });
-	ratio.addChangeCallback([this](float oscValue) { gainDiffRatio = oscValue - 1; });
+      kneeWidth(this, "kneeWidth", 0),
+      gainUpdatePeriod(this, "gainUpdatePeriod", 1) {
+	gainUpdatePeriod.addCheckCallback([this](int32_t newValue) {
+		if(newValue < 1 || newValue > 256) {
+			SPDLOG_ERROR("{}: gain update period must be between 1 and 256 samples: {}",
+			             gainUpdatePeriod.getFullAddress(),
+			             newValue);
+			return false;
+		}
+		return true;
+	});
+
+	auto onChangeCallback = [this](auto) { publishParameters(); };
+	enable.addChangeCallback(onChangeCallback);
+	attackTime.addChangeCallback(onChangeCallback);
+	releaseTime.addChangeCallback(onChangeCallback);
+	threshold.addChangeCallback(onChangeCallback);
+	makeUpGain.addChangeCallback(onChangeCallback);
+	ratio.addChangeCallback(onChangeCallback);
+	kneeWidth.addChangeCallback(onChangeCallback);
+	gainUpdatePeriod.addChangeCallback(onChangeCallback);
+}
+
+void ExpanderFilter::publishParameters() {
+	Parameters newParameters;
+	DynamicsEngine::Parameters& dynamics = newParameters.dynamics;
+
+	// Time constants are per level detector update, which happens every gainUpdatePeriod samples
+	float updateRate = fs / gainUpdatePeriod;
+
+	newParameters.enable = enable;
+	dynamics.alphaA = attackTime != 0 ? expf(-1 / (attackTime * updateRate)) : 0;
+	dynamics.alphaR = releaseTime != 0 ? expf(-1 / (releaseTime * updateRate)) : 0;
+	dynamics.threshold = threshold;
+	dynamics.kneeWidth = kneeWidth;
+	dynamics.gainDiffRatio = ratio - 1;
+	dynamics.gainUpdatePeriod = gainUpdatePeriod;
+	dynamics.outputGain = makeUpGain;
+
+	parameters.publish(newParameters);
 }
 
 void ExpanderFilter::init(size_t numChannel) {
 	this->numChannel = numChannel;
-	previousPartialGainComputerOutput.resize(numChannel);
-	previousLevelDetectorOutput.resize(numChannel);
+	engine.init(numChannel);
 }
 
 void ExpanderFilter::reset(double fs) {
 	this->fs = fs;
-	std::fill_n(previousPartialGainComputerOutput.begin(), numChannel, 0);
-	std::fill_n(previousLevelDetectorOutput.begin(), numChannel, 0);
+	engine.reset();
+	publishParameters();
 }
 
 void ExpanderFilter::processSamples(float** output, const float** input, size_t count) {
-	if(enable) {
-		float makeUpGain = this->makeUpGain;
-
-		for(size_t i = 0; i < count; i++) {
-			float lowestCompressionDb = -INFINITY;
-
-			for(size_t channel = 0; channel < numChannel; channel++) {
-				float dbGain = doCompression(input[channel][i],
-				                             previousPartialGainComputerOutput[channel],
-				                             previousLevelDetectorOutput[channel]);
-				if(dbGain > lowestCompressionDb)
-					lowestCompressionDb = dbGain;
-			}
-
-			// db to ratio
-			float largerCompressionRatio;
-
-			if(lowestCompressionDb != -INFINITY)
-				largerCompressionRatio = powf(10, (lowestCompressionDb + makeUpGain) / 20);
-			else
-				largerCompressionRatio = 0;
+	const Parameters& parameters = *this->parameters.acquire();
 
-			for(size_t channel = 0; channel < numChannel; channel++) {
-				float value = largerCompressionRatio * input[channel][i];
-
-				output[channel][i] = value;
-			}
-		}
+	if(parameters.enable) {
+		engine.processSamples(output, input, count, parameters.dynamics);
 	} else if(output != input) {
 		for(size_t channel = 0; channel < numChannel; channel++) {
 			std::copy_n(input[channel], count, output[channel]);
 		}
 	}
 }
-
-float ExpanderFilter::doCompression(float sample, float& y1, float& yL) {
-	if(sample == 0)
-		return -INFINITY;
-
-	float dbSample = 20 * log10f(fabsf(sample));
-	levelDetector(gainComputer(dbSample), y1, yL);
-	return -yL;
-}
-
-float ExpanderFilter::gainComputer(float dbSample) {
-	float zone = 2 * (dbSample - threshold);
-	if(zone == -INFINITY || zone <= -kneeWidth) {
-		return gainDiffRatio * (threshold - dbSample);
-	} else if(zone >= kneeWidth) {
-		return 0;
-	} else {
-		float a = threshold - dbSample + kneeWidth / 2;
-		return gainDiffRatio * (a * a) / (2 * kneeWidth);
-	}
-}
-
-void ExpanderFilter::levelDetector(float dbSample, float& y1, float& yL) {
-	y1 = fminf(dbSample, alphaR * y1 + (1 - alphaR) * dbSample);
-	yL = alphaA * yL + (1 - alphaA) * y1;
-}
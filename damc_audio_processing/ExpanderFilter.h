@@ -1,36 +1,43 @@
 #pragma once
 
+#include "DynamicsEngine.h"
 #include <Osc/OscContainer.h>
 #include <Osc/OscVariable.h>
+#include <RealtimeSnapshot.h>
 #include <stddef.h>
-#include <vector>
 
 class ExpanderFilter : public OscContainer {
 public:
-	ExpanderFilter(OscContainer* parent);
+	ExpanderFilter(OscContainer* parent, DspArena* arena = nullptr);
 	void init(size_t numChannel);
 	void reset(double fs);
 	void processSamples(float** output, const float** input, size_t count);
 
+	bool isEnabled() const { return enable; }
+	void addEnableChangeCallback(std::function<void(bool)> callback) { enable.addChangeCallback(callback); }
+
 protected:
-	float doCompression(float sample, float& y1, float& yL);
-	float gainComputer(float sample);
-	void levelDetector(float sample, float& y1, float& yL);
+	// Values used by the audio thread, computed from OSC variables
+	struct Parameters {
+		bool enable = false;
+		DynamicsEngine::Parameters dynamics;
+	};
+
+	void publishParameters();
 
 private:
-	size_t numChannel;
-	std::vector<float> previousPartialGainComputerOutput;
-	std::vector<float> previousLevelDetectorOutput;
+	size_t numChannel = 0;
+	DynamicsEngine engine;
 
 	OscVariable<bool> enable;
 	double fs = 48000;
-	float alphaR;
-	float alphaA;
 	OscVariable<float> attackTime;
 	OscVariable<float> releaseTime;
 	OscVariable<float> threshold;
 	OscVariable<float> makeUpGain;
 	OscVariable<float> ratio;
-	float gainDiffRatio = 0;
 	OscVariable<float> kneeWidth;
+	OscVariable<int32_t> gainUpdatePeriod;
+
+	RealtimeSnapshot<Parameters> parameters;
 };
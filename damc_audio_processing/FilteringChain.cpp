@@ -1,4 +1,5 @@
 #include "FilteringChain.h"
+#include <algorithm>
 #include <math.h>
 #include <string.h>
 
@@ -12,42 +13,82 @@ float LogScaleToOsc(float value) {
 
 FilterChain::FilterChain(OscContainer* parent,
                          OscReadOnlyVariable<int32_t>* oscNumChannel,
-                         OscReadOnlyVariable<int32_t>* oscSampleRate)
+                         OscReadOnlyVariable<int32_t>* oscSampleRate,
+                         DspProfiler* profiler,
+                         DspArena* arena)
     : OscContainer(parent, "filterChain"),
+      arena(arena),
       reverbFilters(this, "reverbFilter"),
       eqFilters(this, "eqFilters"),
-      compressorFilter(this),
-      expanderFilter(this),
+      compressorFilter(this, arena),
+      expanderFilter(this, arena),
+      convolutionFilter(this),
       peakMeter(parent, oscNumChannel, oscSampleRate),
+      profiler(profiler),
       delay(this, "delay", 0),
       volume(this, "balance", 1.0f),
       masterVolume(this, "volume", 1.0f),
       mute(this, "mute", false),
       reverseAudioSignal(this, "reverseAudioSignal", false) {
-	reverbFilters.setFactory(
-	    [](OscContainer* parent, int name) { return new ReverbFilter(parent, std::to_string(name)); });
-	eqFilters.setFactory([](OscContainer* parent, int name) { return new EqFilter(parent, std::to_string(name)); });
+	reverbFilters.setFactory([this](OscContainer* parent, int name) {
+		ReverbFilter* filter = new ReverbFilter(parent, std::to_string(name), this->arena);
+		filter->addEnableChangeCallback([this](bool) { updateExecutionPlan(); });
+		return filter;
+	});
+	// Removed reverbs are kept alive by the plan until it is replaced
+	reverbFilters.addChangeCallback([this]() { updateExecutionPlan(); });
+	eqFilters.setFactory([this](OscContainer* parent, int name) {
+		EqFilter* filter = new EqFilter(parent, std::to_string(name), this->arena);
+		filter->init(numChannel);
+		filter->reset(fs);
+		filter->setOnChangeCallback([this]() { updateExecutionPlan(); });
+		return filter;
+	});
 
 	delay.addChangeCallback([this](int32_t newValue) {
-		for(DelayFilter& filter : delayFilters) {
-			filter.setParameters(newValue);
+		for(auto& filter : delayFilters) {
+			filter->setParameters(newValue);
 		}
+		updateExecutionPlan();
 	});
 	volume.setOscConverters(&LogScaleToOsc, &LogScaleFromOsc);
 	masterVolume.setOscConverters(&LogScaleToOsc, &LogScaleFromOsc);
 
+	volume.addChangeCallback([this](float) { updateExecutionPlan(); });
+	masterVolume.addChangeCallback([this](float) { updateExecutionPlan(); });
+	mute.addChangeCallback([this](bool) { updateExecutionPlan(); });
+	reverseAudioSignal.addChangeCallback([this](bool) { updateExecutionPlan(); });
+	compressorFilter.addEnableChangeCallback([this](bool) { updateExecutionPlan(); });
+	expanderFilter.addEnableChangeCallback([this](bool) { updateExecutionPlan(); });
+	convolutionFilter.setOnChangeCallback([this]() { updateExecutionPlan(); });
+
 	oscNumChannel->addChangeCallback([this](int32_t newValue) {
 		if(newValue > 0)
 			updateNumChannels(newValue);
 	});
 }
 
+FilterChain::~FilterChain() {
+	for(auto& filter : eqFilters) {
+		filter.second->setOnChangeCallback(nullptr);
+	}
+	convolutionFilter.setOnChangeCallback(nullptr);
+}
+
 void FilterChain::updateNumChannels(size_t numChannel) {
+	this->numChannel = numChannel;
 	delayFilters.resize(numChannel + 1);  // +1 for side channel
+	for(auto& filter : delayFilters) {
+		if(!filter)
+			filter.reset(new DelayFilter(arena));
+		filter->setParameters(delay);
+	}
 	reverbFilters.resize(numChannel);
 	volume.resize(numChannel);
 
-	eqFilters.resize(6);
+	// Default bands, more can be added with eqFilters/keys
+	if(eqFilters.size() == 0)
+		eqFilters.resize(6);
 
 	for(auto& filter : eqFilters) {
 		filter.second->init(numChannel);
@@ -55,70 +96,216 @@ void FilterChain::updateNumChannels(size_t numChannel) {
 
 	compressorFilter.init(numChannel);
 	expanderFilter.init(numChannel);
+	convolutionFilter.init(numChannel);
+
+	updateExecutionPlan();
+}
+
+void FilterChain::updateExecutionPlan() {
+	ExecutionPlan plan;
+	float masterVolume = this->masterVolume.get();
+
+	if(reverseAudioSignal) {
+		masterVolume *= -1;
+	}
+
+	// Channels might not all exist yet while updateNumChannels is running
+	plan.numChannel = numChannel;
+	plan.mute = mute;
+	plan.gains.resize(numChannel);
+	plan.reverbs.resize(numChannel);
+	bool hasReverb = false;
+
+	for(size_t channel = 0; channel < numChannel; channel++) {
+		float gain = (volume.contains(channel) ? volume.at(channel).get() : 1.0f) * masterVolume;
+
+		plan.gains[channel] = gain;
+		if(gain != 1.0f)
+			plan.unityGain = false;
+
+		if(reverbFilters.contains(channel) && reverbFilters.at(channel).isEnabled()) {
+			plan.reverbs[channel] = reverbFilters.at(channel).getProcessor();
+			hasReverb = true;
+		}
+	}
+
+	for(auto& filter : eqFilters) {
+		BiquadCascade::Band band;
+		if(filter.second->getBand(band)) {
+			plan.eqBands.push_back(band);
+			plan.eqStates.push_back(filter.second->getState());
+		}
+	}
+
+	if(delay != 0)
+		plan.stages.push_back(ExecutionPlan::Delay);
+	if(!plan.eqBands.empty())
+		plan.stages.push_back(ExecutionPlan::Eq);
+	if(expanderFilter.isEnabled())
+		plan.stages.push_back(ExecutionPlan::Expander);
+	if(compressorFilter.isEnabled())
+		plan.stages.push_back(ExecutionPlan::Compressor);
+	if(hasReverb)
+		plan.stages.push_back(ExecutionPlan::Reverb);
+	if(convolutionFilter.isEnabled())
+		plan.stages.push_back(ExecutionPlan::Convolution);
+
+	// Always there as peaks are needed by the meter, it also does the copy to output when nothing else is active
+	plan.stages.push_back(ExecutionPlan::GainAndPeak);
+
+	executionPlan.publish(std::move(plan));
 }
 
-void FilterChain::reset(double fs) {
-	for(DelayFilter& delayFilter : delayFilters) {
-		delayFilter.reset();
+void FilterChain::reset(double fs, size_t blockSize) {
+	this->fs = fs;
+	for(auto& delayFilter : delayFilters) {
+		delayFilter->reset();
 	}
 	for(auto& reverbFilter : reverbFilters) {
 		reverbFilter.second->reset();
 	}
 
 	for(auto& filter : eqFilters) {
+		filter.second->init(numChannel);
 		filter.second->reset(fs);
 	}
 
+	compressorFilter.init(numChannel);
 	compressorFilter.reset(fs);
+	expanderFilter.init(numChannel);
 	expanderFilter.reset(fs);
+	convolutionFilter.reset(fs, blockSize);
+	profiler->reset(fs, blockSize);
+}
+
+void FilterChain::setOffline(bool offline) {
+	convolutionFilter.setOffline(offline);
 }
 
 void FilterChain::processSamples(float** output, const float** input, size_t numChannel, size_t count) {
-	float* peaks = (float*) alloca(sizeof(float) * numChannel);
-	float masterVolume = this->masterVolume.get();
+	const ExecutionPlan* plan = executionPlan.acquire();
 
-	if(reverseAudioSignal) {
-		masterVolume *= -1;
-	}
+	numChannel = std::min(numChannel, plan->numChannel);
 
-	for(uint32_t channel = 0; channel < numChannel; channel++) {
-		delayFilters[channel].processSamples(output[channel], input[channel], count);
-	}
+	if(profiler->isEnabled())
+		processStages<true>(plan, output, input, numChannel, count);
+	else
+		processStages<false>(plan, output, input, numChannel, count);
 
-	for(auto& filter : eqFilters) {
-		filter.second->processSamples(output, const_cast<const float**>(output), count);
-	}
+	// Used by processSideChannelSample for this block
+	if(!delayFilters.empty())
+		delayFilters.back()->updateParameters();
+}
 
-	expanderFilter.processSamples(output, const_cast<const float**>(output), count);
-	compressorFilter.processSamples(output, const_cast<const float**>(output), count);
+template<bool profile>
+void FilterChain::processStages(
+    const ExecutionPlan* plan, float** output, const float** input, size_t numChannel, size_t count) {
+	static const DspProfiler::Stage PROFILER_STAGES[] = {
+	    DspProfiler::Delay,
+	    DspProfiler::Eq,
+	    DspProfiler::Expander,
+	    DspProfiler::Compressor,
+	    DspProfiler::Reverb,
+	    DspProfiler::Convolution,
+	    DspProfiler::Volume,
+	};
+	const float** stageInput = input;
+	uint64_t startTime = 0;
 
-	for(uint32_t channel = 0; channel < numChannel; channel++) {
-		reverbFilters.at(channel).processSamples(output[channel], output[channel], count);
-	}
+	for(ExecutionPlan::Stage stage : plan->stages) {
+		if constexpr(profile)
+			startTime = DspProfiler::now();
 
-	for(uint32_t channel = 0; channel < numChannel; channel++) {
-		float volume = this->volume.at(channel).get() * masterVolume;
-		float peak = 0;
-		for(size_t i = 0; i < count; i++) {
-			output[channel][i] *= volume;
-			peak = fmaxf(peak, fabsf(output[channel][i]));
+		switch(stage) {
+			case ExecutionPlan::Delay:
+				for(uint32_t channel = 0; channel < numChannel; channel++) {
+					delayFilters[channel]->processSamples(output[channel], stageInput[channel], count);
+				}
+				break;
+			case ExecutionPlan::Eq:
+				BiquadCascade::processSamples(
+				    plan->eqBands.data(), plan->eqBands.size(), output, stageInput, numChannel, count);
+				break;
+			case ExecutionPlan::Expander:
+				expanderFilter.processSamples(output, stageInput, count);
+				break;
+			case ExecutionPlan::Compressor:
+				compressorFilter.processSamples(output, stageInput, count);
+				break;
+			case ExecutionPlan::Reverb:
+				for(uint32_t channel = 0; channel < numChannel; channel++) {
+					if(plan->reverbs[channel])
+						plan->reverbs[channel]->processSamples(output[channel], stageInput[channel], count);
+					else if(output[channel] != stageInput[channel])
+						std::copy_n(stageInput[channel], count, output[channel]);
+				}
+				break;
+			case ExecutionPlan::Convolution:
+				convolutionFilter.processSamples(output, stageInput, numChannel, count);
+				break;
+			case ExecutionPlan::GainAndPeak:
+				processGainAndPeak(plan, output, stageInput, numChannel, count);
+				break;
 		}
-		peaks[channel] = peak;
+
+		if constexpr(profile)
+			profiler->record(PROFILER_STAGES[stage], startTime, DspProfiler::now());
+
+		// Next stages work in place
+		stageInput = const_cast<const float**>(output);
 	}
+}
 
-	peakMeter.processSamples(peaks, numChannel, count);
+void FilterChain::processGainAndPeak(
+    const ExecutionPlan* plan, float** output, const float** input, size_t numChannel, size_t count) {
+	float* peaks = (float*) alloca(sizeof(float) * numChannel);
+	float* sumSquares = (float*) alloca(sizeof(float) * numChannel);
+
+	// Before output is written as it can be the same buffer as input
+	peakMeter.processExtendedMeters(input, plan->gains.data(), numChannel, count);
 
-	if(mute) {
-		for(uint32_t channel = 0; channel < numChannel; channel++) {
-			std::fill_n(output[channel], count, 0);
+	for(uint32_t channel = 0; channel < numChannel; channel++) {
+		const float* channelInput = input[channel];
+		float* channelOutput = output[channel];
+		float gain = plan->gains[channel];
+		float peak = 0;
+		float sumSquare = 0;
+
+		// max(|x * gain|) == max(|x|) * |gain| so the peak is computed on the input to avoid reading the output again,
+		// same for the sum of squares
+		if(plan->mute) {
+			for(size_t i = 0; i < count; i++) {
+				peak = fmaxf(peak, fabsf(channelInput[i]));
+				sumSquare += channelInput[i] * channelInput[i];
+			}
+			std::fill_n(channelOutput, count, 0);
+		} else if(plan->unityGain) {
+			for(size_t i = 0; i < count; i++) {
+				peak = fmaxf(peak, fabsf(channelInput[i]));
+				sumSquare += channelInput[i] * channelInput[i];
+			}
+			if(channelOutput != channelInput)
+				std::copy_n(channelInput, count, channelOutput);
+		} else {
+			for(size_t i = 0; i < count; i++) {
+				peak = fmaxf(peak, fabsf(channelInput[i]));
+				sumSquare += channelInput[i] * channelInput[i];
+				channelOutput[i] = channelInput[i] * gain;
+			}
 		}
+
+		peaks[channel] = peak * fabsf(gain);
+		sumSquares[channel] = sumSquare * gain * gain;
 	}
+
+	peakMeter.processSamples(peaks, sumSquares, numChannel, count);
 }
 
 float FilterChain::processSideChannelSample(float input) {
-	return delayFilters.back().processOneSample(input);
+	return delayFilters.back()->processOneSample(input);
 }
 
 void FilterChain::onFastTimer() {
 	peakMeter.onFastTimer();
+	convolutionFilter.onFastTimer();
 }
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "BiquadCascade.h"
 #include "CompressorFilter.h"
+#include "ConvolutionFilter.h"
 #include "DelayFilter.h"
 #include "DitheringFilter.h"
+#include "DspProfiler.h"
 #include "EqFilter.h"
 #include "ExpanderFilter.h"
 #include "PeakMeter.h"
@@ -11,34 +14,71 @@
 #include <Osc/OscContainer.h>
 #include <Osc/OscContainerArray.h>
 #include <Osc/OscVariable.h>
+#include <RealtimeSnapshot.h>
+#include <memory>
 #include <stddef.h>
 
 class FilterChain : public OscContainer {
 public:
 	FilterChain(OscContainer* parent,
 	            OscReadOnlyVariable<int32_t>* oscNumChannel,
-	            OscReadOnlyVariable<int32_t>* oscSampleRate);
+	            OscReadOnlyVariable<int32_t>* oscSampleRate,
+	            DspProfiler* profiler,
+	            DspArena* arena = nullptr);
+	~FilterChain();
 
-	void reset(double fs);
+	// Also reallocates the filter states, from the arena if it has been reserved since
+	void reset(double fs, size_t blockSize);
+	// Processing faster than realtime, see ConvolutionFilter::setOffline
+	void setOffline(bool offline);
 	void processSamples(float** output, const float** input, size_t numChannel, size_t count);
 	float processSideChannelSample(float input);
 
 	void onFastTimer();
 
 protected:
+	// Immutable list of the stages to run, rebuilt each time a parameter changes.
+	// Disabled stages are not part of the plan and delay, volume, peak measurement and mute are merged in a single pass
+	// when possible.
+	struct ExecutionPlan {
+		enum Stage { Delay, Eq, Expander, Compressor, Reverb, Convolution, GainAndPeak };
+
+		size_t numChannel = 0;
+		std::vector<Stage> stages;
+
+		std::vector<BiquadCascade::Band> eqBands;
+		std::vector<std::shared_ptr<double[]>> eqStates;
+		std::vector<std::shared_ptr<ReverbFilter::Processor>> reverbs;  // nullptr for channels without reverb
+		std::vector<float> gains;  // Per channel volume, master volume and polarity
+		bool unityGain = true;
+		bool mute = false;
+	};
+
 	void updateNumChannels(size_t numChannel);
+	void updateExecutionPlan();
+	template<bool profile>
+	void processStages(const ExecutionPlan* plan, float** output, const float** input, size_t numChannel, size_t count);
+	void processGainAndPeak(
+	    const ExecutionPlan* plan, float** output, const float** input, size_t numChannel, size_t count);
 
 private:
-	std::vector<DelayFilter> delayFilters;
+	DspArena* arena;
+	size_t numChannel = 0;
+	double fs = 48000;
+	std::vector<std::unique_ptr<DelayFilter>> delayFilters;
 	OscContainerArray<ReverbFilter> reverbFilters;
 	OscContainerArray<EqFilter> eqFilters;
 	CompressorFilter compressorFilter;
 	ExpanderFilter expanderFilter;
+	ConvolutionFilter convolutionFilter;
 	PeakMeter peakMeter;
+	DspProfiler* profiler;
 
 	OscVariable<int32_t> delay;
 	OscArray<float> volume;
 	OscVariable<float> masterVolume;
 	OscVariable<bool> mute;
 	OscVariable<bool> reverseAudioSignal;
+
+	RealtimeSnapshot<ExecutionPlan> executionPlan;
 };
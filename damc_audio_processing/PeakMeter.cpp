@@ -1,77 +1,369 @@
 #include "PeakMeter.h"
 #include <OscRoot.h>
+#include <SimdVector.h>
 #include <algorithm>
 #include <math.h>
 #include <spdlog/spdlog.h>
 
+namespace {
+
+// Interpolation filters for the 3 intermediate phases of the 4x oversampling, phase 0 is the sample itself
+struct TruePeakFilter {
+	static constexpr size_t TAPS = 12;
+	static constexpr size_t PHASES = 3;
+	float coefs[PHASES][TAPS];
+
+	TruePeakFilter() {
+		for(size_t phase = 0; phase < PHASES; phase++) {
+			double sum = 0;
+
+			// Hann windowed sinc centered between taps TAPS / 2 - 1 and TAPS / 2
+			for(size_t tap = 0; tap < TAPS; tap++) {
+				double x = (double) tap - (TAPS / 2 - 1) - (phase + 1) / 4.0;
+				double sinc = sin(M_PI * x) / (M_PI * x);
+				double window = 0.5 + 0.5 * cos(M_PI * x / (TAPS / 2));
+				coefs[phase][tap] = (float) (sinc * window);
+				sum += sinc * window;
+			}
+
+			for(size_t tap = 0; tap < TAPS; tap++)
+				coefs[phase][tap] /= sum;
+		}
+	}
+};
+
+const TruePeakFilter truePeakFilter;
+
+// Max of the interpolated samples between input[i + TAPS / 2 - 1] and input[i + TAPS / 2] for i in [0, count)
+template<size_t N> SIMD_ALWAYS_INLINE float interpolatedPeakLanes(const float* input, size_t count) {
+	using Vec = Simd::Vector<float, N>;
+	Vec peak = {};
+	size_t i = 0;
+
+	for(; i + N <= count; i += N) {
+		for(size_t phase = 0; phase < TruePeakFilter::PHASES; phase++) {
+			const float* coefs = truePeakFilter.coefs[phase];
+			Vec value = {};
+
+			for(size_t tap = 0; tap < TruePeakFilter::TAPS; tap++) {
+				Vec samples;
+				Simd::load(samples, input + i + tap);
+				value += coefs[tap] * samples;
+			}
+
+			value = value < 0 ? -value : value;
+			peak = value > peak ? value : peak;
+		}
+	}
+
+	float maxPeak = 0;
+	for(size_t lane = 0; lane < N; lane++)
+		maxPeak = std::max(maxPeak, peak[lane]);
+
+	for(; i < count; i++) {
+		for(size_t phase = 0; phase < TruePeakFilter::PHASES; phase++) {
+			const float* coefs = truePeakFilter.coefs[phase];
+			float value = 0;
+
+			for(size_t tap = 0; tap < TruePeakFilter::TAPS; tap++)
+				value += coefs[tap] * input[i + tap];
+
+			maxPeak = std::max(maxPeak, fabsf(value));
+		}
+	}
+
+	return maxPeak;
+}
+
+SIMD_TARGET_AVX512 float interpolatedPeakAvx512(const float* input, size_t count) {
+	return interpolatedPeakLanes<16>(input, count);
+}
+
+SIMD_TARGET_AVX2 float interpolatedPeakAvx2(const float* input, size_t count) {
+	return interpolatedPeakLanes<8>(input, count);
+}
+
+SIMD_TARGET_SSE2 float interpolatedPeakSse2(const float* input, size_t count) {
+	return interpolatedPeakLanes<4>(input, count);
+}
+
+float interpolatedPeakScalar(const float* input, size_t count) {
+	return interpolatedPeakLanes<1>(input, count);
+}
+
+float interpolatedPeak(const float* input, size_t count) {
+	Simd::Level level = Simd::getLevel();
+
+	if(level >= Simd::AVX512)
+		return interpolatedPeakAvx512(input, count);
+	else if(level >= Simd::AVX2)
+		return interpolatedPeakAvx2(input, count);
+	else if(level >= Simd::SSE2)
+		return interpolatedPeakSse2(input, count);
+	else
+		return interpolatedPeakScalar(input, count);
+}
+
+void atomicMax(std::atomic<float>& value, float newValue) {
+	float currentValue = value.load(std::memory_order_relaxed);
+	while(newValue > currentValue &&
+	      !value.compare_exchange_weak(currentValue, newValue, std::memory_order_relaxed)) {
+	}
+}
+
+void atomicAdd(std::atomic<float>& value, float increment) {
+	float currentValue = value.load(std::memory_order_relaxed);
+	while(!value.compare_exchange_weak(currentValue, currentValue + increment, std::memory_order_relaxed)) {
+	}
+}
+
+float toDb(float value, float factor) {
+	float valueDb = value > 0 ? factor * log10f(value) : -INFINITY;
+	return valueDb > -192 ? valueDb : -192;
+}
+
+}  // namespace
+
 PeakMeter::PeakMeter(OscContainer* parent,
                      OscReadOnlyVariable<int32_t>* oscNumChannel,
                      OscReadOnlyVariable<int32_t>* oscSampleRate)
     : oscRoot(parent->getRoot()),
       oscSampleRate(oscSampleRate),
       samplesInPeaks(0),
-      oscEnablePeakUpdate(parent, "meter_enable_per_channel", false) {
+      oscEnablePeakUpdate(parent, "meter_enable_per_channel", false),
+      oscEnableExtendedMeters(parent, "meter_enable_extended", false) {
+	static_assert(TRUE_PEAK_TAPS == TruePeakFilter::TAPS, "True-peak history doesn't match the filter length");
 
 	oscPeakGlobalPath = parent->getFullAddress() + "/meter";
 	oscPeakPerChannelPath = parent->getFullAddress() + "/meter_per_channel";
+	oscRmsPerChannelPath = parent->getFullAddress() + "/meter_rms_per_channel";
+	oscTruePeakPerChannelPath = parent->getFullAddress() + "/meter_true_peak_per_channel";
+	oscLoudnessMomentaryPath = parent->getFullAddress() + "/meter_loudness_momentary";
+	oscLoudnessShortTermPath = parent->getFullAddress() + "/meter_loudness_short_term";
 
 	oscNumChannel->addChangeCallback([this](int32_t newValue) {
+		numChannel = newValue;
 		levelsDb.resize(newValue, -192);
-
-		peakMutex.lock();
-		peaksPerChannel.resize(newValue, 0);
-		peakMutex.unlock();
+		rmsDb.resize(newValue, -192);
+		truePeaksDb.resize(newValue, -192);
+		oscPerChannelArguments.reserve(newValue);
+		updateMeters();
 	});
+	oscSampleRate->addChangeCallback([this](int32_t) { updateMeters(); });
+	oscEnableExtendedMeters.addChangeCallback([this](bool) { updateMeters(); });
 }
 
 PeakMeter::~PeakMeter() {
 }
 
-void PeakMeter::processSamples(const float* peaks, size_t numChannels, size_t samplesInPeaks) {
-	peakMutex.lock();
-	this->samplesInPeaks += samplesInPeaks;
+void PeakMeter::updateMeters() {
+	Meters newMeters;
+	double fs = oscSampleRate->get() > 0 ? oscSampleRate->get() : 48000;
+
+	newMeters.numChannel = numChannel;
+	newMeters.extendedMeters = oscEnableExtendedMeters;
+	newMeters.loudnessBlockSize = std::max<size_t>(1, (size_t) (fs / 10));
+	newMeters.levels.reset(new ChannelLevels[numChannel]);
+	newMeters.truePeakHistory.reset(new float[numChannel * (TRUE_PEAK_TAPS - 1)]());
+	newMeters.kWeightingState.reset(new double[2 * 2 * numChannel]);
+	newMeters.kWeightingOutput.reset(new float[numChannel * BLOCK_SIZE]);
+	newMeters.loudness.reset(new Loudness);
+
+	// K-weighting filters from ITU-R BS.1770, computed for the current sample rate
+	{
+		double K = tan(M_PI * 1681.974450955533 / fs);
+		double Q = 0.7071752369554196;
+		double Vh = pow(10.0, 3.999843853973347 / 20.0);
+		double Vb = pow(Vh, 0.4996667741545416);
+		double a0 = 1.0 + K / Q + K * K;
+		BiquadCascade::Band& band = newMeters.kWeighting[0];
+
+		band.b0 = (Vh + Vb * K / Q + K * K) / a0;
+		band.b1 = 2.0 * (K * K - Vh) / a0;
+		band.b2 = (Vh - Vb * K / Q + K * K) / a0;
+		band.a1 = 2.0 * (K * K - 1.0) / a0;
+		band.a2 = (1.0 - K / Q + K * K) / a0;
+	}
+	{
+		double K = tan(M_PI * 38.13547087602444 / fs);
+		double Q = 0.5003270373238773;
+		double a0 = 1.0 + K / Q + K * K;
+		BiquadCascade::Band& band = newMeters.kWeighting[1];
+
+		band.b0 = 1.0;
+		band.b1 = -2.0;
+		band.b2 = 1.0;
+		band.a1 = 2.0 * (K * K - 1.0) / a0;
+		band.a2 = (1.0 - K / Q + K * K) / a0;
+	}
+
+	for(size_t i = 0; i < 2; i++) {
+		newMeters.kWeighting[i].state = newMeters.kWeightingState.get() + i * 2 * numChannel;
+		BiquadCascade::initState(newMeters.kWeighting[i].state, numChannel);
+	}
+
+	meters.publish(std::move(newMeters));
+}
+
+void PeakMeter::processSamples(const float* peaks, const float* sumSquares, size_t numChannels, size_t samplesInPeaks) {
+	const Meters* meters = this->meters.acquire();
+
+	numChannels = std::min(numChannels, meters->numChannel);
+
 	for(size_t i = 0; i < numChannels; i++) {
-		this->peaksPerChannel[i] = fmaxf(peaks[i], this->peaksPerChannel[i]);
+		atomicMax(meters->levels[i].peak, peaks[i]);
+		atomicAdd(meters->levels[i].sumSquares, sumSquares[i]);
 	}
-	peakMutex.unlock();
+	this->samplesInPeaks.fetch_add(samplesInPeaks, std::memory_order_relaxed);
 }
 
-void PeakMeter::onFastTimer() {
-	int samples;
-	int32_t sampleRate = oscSampleRate->get();
-	std::vector<float> peaks(this->peaksPerChannel.size(), 0);
+void PeakMeter::processExtendedMeters(const float** samples, const float* gains, size_t numChannels, size_t count) {
+	const Meters* meters = this->meters.acquire();
 
-	peakMutex.lock();
-	samples = this->samplesInPeaks;
-	peaks.swap(this->peaksPerChannel);
-	this->samplesInPeaks = 0;
-	peakMutex.unlock();
+	numChannels = std::min(numChannels, meters->numChannel);
 
-	if(sampleRate == 0)
-		return;
+	if(meters->extendedMeters && numChannels > 0) {
+		processTruePeak(meters, samples, gains, numChannels, count);
+		processLoudness(meters, samples, gains, numChannels, count);
+	}
+}
+
+void PeakMeter::processTruePeak(
+    const Meters* meters, const float** samples, const float* gains, size_t numChannel, size_t count) {
+	static constexpr size_t HISTORY_SIZE = TRUE_PEAK_TAPS - 1;
+	float buffer[HISTORY_SIZE + BLOCK_SIZE];
+
+	for(size_t channel = 0; channel < numChannel; channel++) {
+		float* history = meters->truePeakHistory.get() + channel * HISTORY_SIZE;
+		float peak = 0;
+
+		std::copy_n(history, HISTORY_SIZE, buffer);
+
+		for(size_t offset = 0; offset < count; offset += BLOCK_SIZE) {
+			size_t blockSize = std::min(BLOCK_SIZE, count - offset);
+
+			std::copy_n(samples[channel] + offset, blockSize, buffer + HISTORY_SIZE);
+
+			for(size_t i = 0; i < blockSize; i++)
+				peak = std::max(peak, fabsf(buffer[i + HISTORY_SIZE]));
+			peak = std::max(peak, interpolatedPeak(buffer, blockSize));
+
+			// Keep the last samples for the next block
+			std::copy_n(buffer + blockSize, HISTORY_SIZE, buffer);
+		}
+
+		std::copy_n(buffer, HISTORY_SIZE, history);
+		atomicMax(meters->levels[channel].truePeak, peak * fabsf(gains[channel]));
+	}
+}
+
+void PeakMeter::processLoudness(
+    const Meters* meters, const float** samples, const float* gains, size_t numChannel, size_t count) {
+	Loudness& loudness = *meters->loudness;
+	const float** blockInput = (const float**) alloca(sizeof(float*) * numChannel);
+	float** blockOutput = (float**) alloca(sizeof(float*) * numChannel);
+	size_t blockSize;
+
+	for(size_t channel = 0; channel < numChannel; channel++)
+		blockOutput[channel] = meters->kWeightingOutput.get() + channel * BLOCK_SIZE;
+
+	for(size_t offset = 0; offset < count; offset += blockSize) {
+		blockSize = std::min({BLOCK_SIZE, count - offset, meters->loudnessBlockSize - loudness.blockSamples});
 
-	float deltaT = (float) samples / sampleRate;
+		for(size_t channel = 0; channel < numChannel; channel++)
+			blockInput[channel] = samples[channel] + offset;
+
+		// Filter state layout depends on the channel count, always process all channels of the meter
+		BiquadCascade::processSamples(meters->kWeighting, 2, blockOutput, blockInput, numChannel, blockSize);
+
+		for(size_t channel = 0; channel < numChannel; channel++) {
+			const float* filtered = blockOutput[channel];
+			float energy = 0;
+
+			for(size_t i = 0; i < blockSize; i++)
+				energy += filtered[i] * filtered[i];
+
+			loudness.blockEnergy += energy * gains[channel] * gains[channel];
+		}
+
+		loudness.blockSamples += blockSize;
+		if(loudness.blockSamples < meters->loudnessBlockSize)
+			continue;
+
+		// A 100ms block is complete, update the momentary and short-term windows
+		loudness.blocks[loudness.blockIndex] = loudness.blockEnergy / loudness.blockSamples;
+		loudness.blockIndex = (loudness.blockIndex + 1) % LOUDNESS_SHORT_TERM_BLOCKS;
+		loudness.blockEnergy = 0;
+		loudness.blockSamples = 0;
+
+		float momentary = 0;
+		float shortTerm = 0;
+		for(size_t i = 0; i < LOUDNESS_SHORT_TERM_BLOCKS; i++) {
+			size_t age = (loudness.blockIndex + LOUDNESS_SHORT_TERM_BLOCKS - 1 - i) % LOUDNESS_SHORT_TERM_BLOCKS;
+			if(i < LOUDNESS_MOMENTARY_BLOCKS)
+				momentary += loudness.blocks[age];
+			shortTerm += loudness.blocks[age];
+		}
+
+		loudness.momentary.store(momentary / LOUDNESS_MOMENTARY_BLOCKS, std::memory_order_relaxed);
+		loudness.shortTerm.store(shortTerm / LOUDNESS_SHORT_TERM_BLOCKS, std::memory_order_relaxed);
+	}
+}
+
+void PeakMeter::sendPerChannelLevels(const std::string& path, const std::vector<float>& levels) {
+	oscPerChannelArguments.clear();
+	for(auto v : levels) {
+		oscPerChannelArguments.emplace_back(v);
+	}
+	oscRoot->sendMessage(path, oscPerChannelArguments.data(), oscPerChannelArguments.size());
+}
+
+void PeakMeter::onFastTimer() {
+	int samples = samplesInPeaks.exchange(0);
+	int32_t sampleRate = oscSampleRate->get();
+	const Meters& meters = this->meters.get();
+	size_t numChannel = std::min(levelsDb.size(), meters.numChannel);
+
+	float deltaT = sampleRate != 0 ? (float) samples / sampleRate : 0;
 	float maxLevel = 0;
 
-	for(size_t channel = 0; channel < peaks.size(); channel++) {
-		float peakDb = peaks[channel] != 0 ? 20.0 * log10(peaks[channel]) : -INFINITY;
+	for(size_t channel = 0; channel < numChannel; channel++) {
+		ChannelLevels& levels = meters.levels[channel];
+		float peak = levels.peak.exchange(0, std::memory_order_relaxed);
+		float truePeak = levels.truePeak.exchange(0, std::memory_order_relaxed);
+		float sumSquares = levels.sumSquares.exchange(0, std::memory_order_relaxed);
+		float peakDb = peak != 0 ? 20.0 * log10(peak) : -INFINITY;
 
 		float decayAmount = 11.76470588235294 * deltaT;  // -20dB / 1.7s
 		float levelDb = std::max(levelsDb[channel] - decayAmount, peakDb);
 		levelsDb[channel] = levelDb > -192 ? levelDb : -192;
 		if(channel == 0 || levelsDb[channel] > maxLevel)
 			maxLevel = levelsDb[channel];
+
+		if(samples > 0) {
+			rmsDb[channel] = toDb(sumSquares / samples, 10);
+			truePeaksDb[channel] = toDb(truePeak, 20);
+		}
 	}
 
+	if(sampleRate == 0)
+		return;
+
 	if(oscEnablePeakUpdate.get()) {
 		OscArgument argument = maxLevel;
 		oscRoot->sendMessage(oscPeakGlobalPath, &argument, 1);
 	}
 
-	oscPeakPerChannelArguments.clear();
-	oscPeakPerChannelArguments.reserve(levelsDb.size());
-	for(auto v : levelsDb) {
-		oscPeakPerChannelArguments.emplace_back(v);
+	sendPerChannelLevels(oscPeakPerChannelPath, levelsDb);
+
+	if(meters.extendedMeters) {
+		// Loudness in LUFS from the mean square of K-weighted samples
+		OscArgument momentary = toDb(meters.loudness->momentary.load(std::memory_order_relaxed), 10) - 0.691f;
+		OscArgument shortTerm = toDb(meters.loudness->shortTerm.load(std::memory_order_relaxed), 10) - 0.691f;
+
+		sendPerChannelLevels(oscRmsPerChannelPath, rmsDb);
+		sendPerChannelLevels(oscTruePeakPerChannelPath, truePeaksDb);
+		oscRoot->sendMessage(oscLoudnessMomentaryPath, &momentary, 1);
+		oscRoot->sendMessage(oscLoudnessShortTermPath, &shortTerm, 1);
 	}
-	oscRoot->sendMessage(oscPeakPerChannelPath, oscPeakPerChannelArguments.data(), oscPeakPerChannelArguments.size());
 }
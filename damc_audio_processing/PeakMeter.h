@@ -1,16 +1,28 @@
 #pragma once
 
+#include "BiquadCascade.h"
 #include <Osc/OscVariable.h>
-#include <mutex>
+#include <RealtimeSnapshot.h>
+#include <atomic>
+#include <memory>
 #include <stdint.h>
 #include <string>
-#include <mutex>
 #include <vector>
 
 class OscContainer;
 
 class ControlInterface;
 
+/*
+ * Level meters of a filter chain.
+ *
+ * The audio thread accumulates levels in atomics which are read and reset by the main thread on each fast timer tick,
+ * no lock is taken by either side.
+ *
+ * Peak and RMS are always measured. When extended meters are enabled, 4x oversampled true-peak and EBU R128
+ * momentary (400ms) and short-term (3s) loudness are measured too. Loudness is computed from 100ms blocks of
+ * K-weighted energy kept in a ring buffer, all channels have a weight of 1.
+ */
 class PeakMeter {
 public:
 	PeakMeter(OscContainer* parent,
@@ -18,21 +30,75 @@ public:
 	          OscReadOnlyVariable<int32_t>* oscSampleRate);
 	~PeakMeter();
 
-	void processSamples(const float* peaks, size_t numChannels, size_t samplesInPeaks);
+	void processSamples(const float* peaks, const float* sumSquares, size_t numChannels, size_t samplesInPeaks);
+	// True-peak and loudness, samples are before gains are applied
+	void processExtendedMeters(const float** samples, const float* gains, size_t numChannels, size_t count);
 
 	void onFastTimer();
 
+protected:
+	static constexpr size_t BLOCK_SIZE = 64;
+	static constexpr size_t TRUE_PEAK_TAPS = 12;
+	static constexpr size_t LOUDNESS_MOMENTARY_BLOCKS = 4;
+	static constexpr size_t LOUDNESS_SHORT_TERM_BLOCKS = 30;
+
+	// Written by the audio thread, read and reset by the main thread
+	struct ChannelLevels {
+		std::atomic<float> peak{0};
+		std::atomic<float> truePeak{0};
+		std::atomic<float> sumSquares{0};
+	};
+
+	struct Loudness {
+		// Audio thread only
+		float blockEnergy = 0;
+		size_t blockSamples = 0;
+		size_t blockIndex = 0;
+		float blocks[LOUDNESS_SHORT_TERM_BLOCKS] = {};
+
+		// Mean square of K-weighted samples, written by the audio thread on each completed block
+		std::atomic<float> momentary{0};
+		std::atomic<float> shortTerm{0};
+	};
+
+	struct Meters {
+		size_t numChannel = 0;
+		bool extendedMeters = false;
+		size_t loudnessBlockSize = 4800;
+		std::unique_ptr<ChannelLevels[]> levels;
+
+		// Audio thread only
+		std::unique_ptr<float[]> truePeakHistory;  // Last TRUE_PEAK_TAPS - 1 samples of each channel
+		std::unique_ptr<double[]> kWeightingState;
+		std::unique_ptr<float[]> kWeightingOutput;  // BLOCK_SIZE samples per channel
+		BiquadCascade::Band kWeighting[2];
+		std::unique_ptr<Loudness> loudness;
+	};
+
+	void updateMeters();
+	void processTruePeak(const Meters* meters, const float** samples, const float* gains, size_t numChannel, size_t count);
+	void processLoudness(const Meters* meters, const float** samples, const float* gains, size_t numChannel, size_t count);
+	void sendPerChannelLevels(const std::string& path, const std::vector<float>& levels);
+
 private:
 	OscRoot* oscRoot;
 	OscReadOnlyVariable<int32_t>* oscSampleRate;
 
+	size_t numChannel = 0;
 	std::vector<float> levelsDb;
-	std::mutex peakMutex;
-	int samplesInPeaks;
-	std::vector<float> peaksPerChannel;
+	std::vector<float> rmsDb;
+	std::vector<float> truePeaksDb;
+	std::atomic<int> samplesInPeaks;
 	std::string oscPeakGlobalPath;
 	std::string oscPeakPerChannelPath;
-	std::vector<OscArgument> oscPeakPerChannelArguments;
+	std::string oscRmsPerChannelPath;
+	std::string oscTruePeakPerChannelPath;
+	std::string oscLoudnessMomentaryPath;
+	std::string oscLoudnessShortTermPath;
+	std::vector<OscArgument> oscPerChannelArguments;
 
 	OscVariable<bool> oscEnablePeakUpdate;
+	OscVariable<bool> oscEnableExtendedMeters;
+
+	RealtimeSnapshot<Meters> meters;
 };
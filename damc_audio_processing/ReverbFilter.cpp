@@ -4,43 +4,161 @@
 #include <math.h>
 #include <string.h>
 
-ReverbFilter::ReverbFilter(OscContainer* parent, const std::string& name)
+namespace {
+
+constexpr size_t BLOCK_SIZE = 64;
+
+template<typename Node>
+void processNode(const Node* nodes, size_t nodeIndex, float* buffer, float* data, size_t count, size_t position) {
+	const Node& node = nodes[nodeIndex];
+	float* line = buffer + node.lineOffset;
+	float* input = buffer + node.inputOffset;
+	float& previousOutput = buffer[node.previousOutputOffset];
+	float gain = node.gain;
+	float outputGain = 1 - gain * gain;
+	size_t mask = node.lineMask;
+
+	// Samples read from the delay line must be written in a previous block, without delay the block is one sample
+	size_t maxBlockSize = std::min<size_t>(BLOCK_SIZE, std::max(node.delay, 1u));
+	size_t blockSize;
+
+	for(size_t offset = 0; offset < count; offset += blockSize) {
+		float* block = data + offset;
+		size_t blockPosition = position + offset;
+
+		blockSize = std::min(maxBlockSize, count - offset);
+		std::copy_n(block, blockSize, input);
+
+		if(node.delay == 0)
+			line[blockPosition & mask] = input[0] + gain * previousOutput;
+
+		// Read the delayed block in up to 2 parts when it wraps around the end of the delay line
+		size_t readIndex = (blockPosition - node.delay) & mask;
+		size_t firstPart = std::min(blockSize, mask + 1 - readIndex);
+		std::copy_n(line + readIndex, firstPart, block);
+		std::copy_n(line, blockSize - firstPart, block + firstPart);
+
+		for(size_t child = nodeIndex + 1; child < node.end; child = nodes[child].end)
+			processNode(nodes, child, buffer, block, blockSize, blockPosition);
+
+		if(node.delay != 0) {
+			line[blockPosition & mask] = input[0] + gain * previousOutput;
+			for(size_t i = 1; i < blockSize; i++)
+				line[(blockPosition + i) & mask] = input[i] + gain * block[i - 1];
+		}
+		previousOutput = block[blockSize - 1];
+
+		for(size_t i = 0; i < blockSize; i++)
+			block[i] = -gain * input[i] + outputGain * block[i];
+	}
+}
+
+}  // namespace
+
+ReverbFilter::ReverbFilter(OscContainer* parent,
+                           const std::string& name,
+                           DspArena* arena,
+                           ReverbFilter* parentReverberator)
     : OscContainer(parent, name),
+      arena(arena),
+      parentReverberator(parentReverberator),
       enabled(this, "enabled", false),
       delay(this, "delay", 1440),
       gain(this, "gain", 0.893),
-      reverberators(this, "innerReverberators") {
-	reverberators.setFactory(
-	    [](OscContainer* parent, int name) { return new ReverbFilter(parent, std::to_string(name)); });
-	delay.addChangeCallback([this](int32_t oscValue) { delayFilter.setParameters(oscValue); });
+      reverberators(this, "innerReverberators"),
+      processor(std::make_shared<Processor>()) {
+	reverberators.setFactory([this](OscContainer* parent, int name) {
+		return new ReverbFilter(parent, std::to_string(name), this->arena, this);
+	});
+
+	auto onChangeCallback = [this](auto) { updateNetwork(); };
+	enabled.addChangeCallback(onChangeCallback);
+	delay.addChangeCallback(onChangeCallback);
+	gain.addChangeCallback(onChangeCallback);
+	reverberators.addChangeCallback([this]() { updateNetwork(); });
 }
 
-void ReverbFilter::reset(int depth, unsigned int innerReverberatorCount) {
-	this->delayFilter.reset();
+void ReverbFilter::compileNodes(std::vector<Node>& nodes, size_t& bufferSize) const {
+	size_t index = nodes.size();
+	size_t lineSize = 1;
+	Node node;
+
+	node.delay = std::max(0, delay.get());
+	node.gain = gain;
+
+	while(lineSize < (size_t) node.delay + 1)
+		lineSize *= 2;
+
+	node.lineOffset = bufferSize;
+	node.lineMask = lineSize - 1;
+	node.previousOutputOffset = node.lineOffset + lineSize;
+	node.inputOffset = node.previousOutputOffset + 1;
+	bufferSize = node.inputOffset + BLOCK_SIZE;
 
+	nodes.push_back(node);
+	for(auto& reverberator : reverberators)
+		reverberator.second->compileNodes(nodes, bufferSize);
+	nodes[index].end = nodes.size();
+}
+
+void ReverbFilter::updateNetwork(bool clearBuffer) {
+	if(parentReverberator) {
+		parentReverberator->updateNetwork(clearBuffer);
+		return;
+	}
+
+	const Network& previousNetwork = processor->network.get();
+	Network newNetwork;
+	size_t bufferSize = 0;
+
+	newNetwork.enabled = enabled;
+	compileNodes(newNetwork.nodes, bufferSize);
+
+	// Keep the reverb tail when only gains changed
+	bool sameLayout = !clearBuffer && previousNetwork.buffer &&
+	                  std::equal(newNetwork.nodes.begin(),
+	                             newNetwork.nodes.end(),
+	                             previousNetwork.nodes.begin(),
+	                             previousNetwork.nodes.end(),
+	                             [](const Node& a, const Node& b) { return a.delay == b.delay && a.end == b.end; });
+
+	if(sameLayout)
+		newNetwork.buffer = previousNetwork.buffer;
+	else
+		newNetwork.buffer = DspArena::makeBuffer<float>(arena, bufferSize);
+
+	processor->network.publish(std::move(newNetwork));
+}
+
+void ReverbFilter::reset(int depth, unsigned int innerReverberatorCount) {
 	if(depth > 0) {
 		reverberators.resize(innerReverberatorCount);
 		for(auto& filter : reverberators)
 			filter.second->reset(depth - 1, innerReverberatorCount);
 	}
+
+	if(!parentReverberator)
+		updateNetwork(true);
 }
 
 void ReverbFilter::processSamples(float* output, const float* input, size_t count) {
-	if(enabled) {
-		for(size_t i = 0; i < count; i++) {
-			output[i] = processOneSample(input[i]);
-		}
-	}
+	processor->processSamples(output, input, count);
 }
 
-float ReverbFilter::processOneSample(float input) {
-	float delayedSample = delayFilter.processOneSample(input + previousDelayOutput * gain);
+void ReverbFilter::Processor::processSamples(float* output, const float* input, size_t count) {
+	const Network* network = this->network.acquire();
 
-	for(auto& reverberator : reverberators)
-		delayedSample = reverberator.second->processOneSample(delayedSample);
-
-	previousDelayOutput = delayedSample;
+	if(network->buffer.get() != activeBuffer) {
+		activeBuffer = network->buffer.get();
+		position = 0;
+	}
 
-	float gain = this->gain;
-	return -gain * input + (1 - (gain * gain)) * delayedSample;
+	if(network->enabled) {
+		if(output != input)
+			std::copy_n(input, count, output);
+		processNode(network->nodes.data(), 0, network->buffer.get(), output, count, position);
+		position += count;
+	} else if(output != input) {
+		std::copy_n(input, count, output);
+	}
 }
@@ -1,25 +1,79 @@
 #pragma once
 
-#include "DelayFilter.h"
+#include <DspArena.h>
 #include <Osc/OscContainer.h>
 #include <Osc/OscContainerArray.h>
 #include <Osc/OscVariable.h>
+#include <RealtimeSnapshot.h>
+#include <memory>
 #include <stddef.h>
 #include <vector>
 
+/*
+ * Allpass reverberator, each one can contain inner reverberators applied in series on its delayed signal.
+ *
+ * The OSC tree only holds the parameters. The top-level reverberator compiles the whole tree into a flat list of nodes
+ * using delay lines from a single buffer and the audio thread processes it by blocks.
+ */
 class ReverbFilter : public OscContainer {
 public:
-	ReverbFilter(OscContainer* parent, const std::string& name);
+	class Processor;
+
+	ReverbFilter(OscContainer* parent,
+	             const std::string& name,
+	             DspArena* arena = nullptr,
+	             ReverbFilter* parentReverberator = nullptr);
 	void reset(int depth = 1, unsigned int innerReverberatorCount = 5);
 	void processSamples(float* output, const float* input, size_t count);
-	float processOneSample(float input);
+
+	bool isEnabled() const { return enabled; }
+	void addEnableChangeCallback(std::function<void(bool)> callback) { enabled.addChangeCallback(callback); }
+	// Keep a reference on this to process samples after this filter might have been destroyed
+	const std::shared_ptr<Processor>& getProcessor() const { return processor; }
+
+protected:
+	// Reverberator in pre-order, inner reverberators of nodes[i] are in nodes[i + 1] to nodes[nodes[i].end - 1]
+	struct Node {
+		unsigned int delay;
+		float gain;
+		size_t end;
+		size_t lineOffset;
+		size_t lineMask;
+		size_t previousOutputOffset;
+		size_t inputOffset;
+	};
+
+	struct Network {
+		bool enabled = false;
+		std::vector<Node> nodes;
+		// Delay lines, previous output of each node and scratch input blocks
+		std::shared_ptr<float[]> buffer;
+	};
+
+	void updateNetwork(bool clearBuffer = false);
+	void compileNodes(std::vector<Node>& nodes, size_t& bufferSize) const;
 
 private:
+	DspArena* arena;
+	ReverbFilter* parentReverberator;
+
 	OscVariable<bool> enabled;
 	OscVariable<int32_t> delay;
-	DelayFilter delayFilter;
 	OscVariable<float> gain;
 	OscContainerArray<ReverbFilter> reverberators;
 
-	float previousDelayOutput = 0.0f;
+	std::shared_ptr<Processor> processor;
+};
+
+// Audio thread state of a top-level reverberator, the network is published by its ReverbFilter
+class ReverbFilter::Processor {
+public:
+	void processSamples(float* output, const float* input, size_t count);
+
+private:
+	friend class ReverbFilter;
+
+	RealtimeSnapshot<Network> network;
+	const float* activeBuffer = nullptr;
+	size_t position = 0;
 };
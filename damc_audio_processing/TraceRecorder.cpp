@@ -0,0 +1,229 @@
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <spdlog/details/os.h>
+#include <spdlog/spdlog.h>
+#include <stdio.h>
+
+namespace {
+
+struct FileCloser {
+	void operator()(FILE* file) { fclose(file); }
+};
+
+std::string escapeJson(const std::string& value) {
+	std::string result;
+
+	for(char c : value) {
+		if(c == '"' || c == '\\') {
+			result += '\\';
+			result += c;
+		} else if((unsigned char) c < 0x20) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			result += escaped;
+		} else {
+			result += c;
+		}
+	}
+
+	return result;
+}
+
+}  // namespace
+
+TraceRecorder::TraceRecorder(OscContainer* parent, const std::string& fileNamePrefix)
+    : OscContainer(parent, "trace"),
+      fileNamePrefix(fileNamePrefix),
+      oscEnable(this, "enable", false, false),
+      oscCapture(this, "capture", false, false),
+      oscCaptureOnXrun(this, "captureOnXrun", true),
+      oscPostTriggerMs(this, "postTriggerMs", 100),
+      oscXrunCount(this, "xrunCount", 0, false),
+      oscLastFile(this, "lastFile") {
+	trackNames[0] = "jack";
+
+	oscEnable.addChangeCallback([this](bool newValue) {
+		// Allocated on first use only as it takes a few MB
+		if(newValue && !events)
+			events.reset(new Event[EVENT_CAPACITY]);
+		updateRecordingState();
+	});
+
+	oscCapture.addCheckCallback([this](bool newValue) -> bool {
+		if(newValue && !oscEnable) {
+			SPDLOG_ERROR("{}: can't capture, trace is not enabled", getFullAddress());
+			return false;
+		}
+		return true;
+	});
+	oscCapture.addChangeCallback([this](bool newValue) {
+		if(newValue)
+			trigger(now());
+	});
+
+	oscCaptureOnXrun.addChangeCallback([this](bool newValue) { captureOnXrunEnabled = newValue; });
+
+	oscPostTriggerMs.addCheckCallback([](int32_t newValue) { return newValue >= 0 && newValue <= 60000; });
+}
+
+void TraceRecorder::setTrackName(int32_t track, const std::string& name) {
+	trackNames[track] = name;
+}
+
+void TraceRecorder::record(EventType type, int32_t track, const char* name, uint64_t timeNs, int64_t value) {
+	if(!isEnabled())
+		return;
+
+	uint64_t index = writeIndex.fetch_add(1, std::memory_order_relaxed);
+	Event& event = events[index % EVENT_CAPACITY];
+
+	event.timeNs = timeNs;
+	event.value = value;
+	event.name = name;
+	event.track = track;
+	event.type = type;
+	event.sequence.store(index + 1, std::memory_order_release);
+}
+
+void TraceRecorder::recordDuration(int32_t track, const char* name, uint64_t startNs, uint64_t endNs) {
+	record(Duration, track, name, startNs, endNs - startNs);
+}
+
+void TraceRecorder::recordCounter(int32_t track, const char* name, uint64_t timeNs, int64_t value) {
+	record(Counter, track, name, timeNs, value);
+}
+
+void TraceRecorder::notifyXrun(int32_t track) {
+	xruns.fetch_add(1, std::memory_order_relaxed);
+
+	if(!isEnabled())
+		return;
+
+	uint64_t timeNs = now();
+	record(Instant, track, "xrun", timeNs, 0);
+	if(captureOnXrunEnabled.load(std::memory_order_relaxed))
+		trigger(timeNs);
+}
+
+void TraceRecorder::trigger(uint64_t timeNs) {
+	// The first trigger defines the capture window, later ones are part of it
+	uint64_t expected = 0;
+	triggerTimeNs.compare_exchange_strong(expected, timeNs);
+}
+
+void TraceRecorder::updateRecordingState() {
+	recording.store(oscEnable && !frozen && events, std::memory_order_release);
+}
+
+void TraceRecorder::onFastTimer() {
+	int32_t newXruns = xruns.exchange(0, std::memory_order_relaxed);
+	if(newXruns)
+		oscXrunCount = oscXrunCount + newXruns;
+
+	if(frozen) {
+		char timestamp[32];
+		std::tm localTime = spdlog::details::os::localtime();
+		strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", &localTime);
+
+		std::string fileName = fileNamePrefix + timestamp + ".json";
+		if(writeTrace(fileName)) {
+			SPDLOG_INFO("{}: trace written to {}", getFullAddress(), fileName);
+			oscLastFile.set(fileName);
+		}
+
+		// Events before the current write index are not part of the next capture
+		startIndex = writeIndex.load(std::memory_order_relaxed);
+		triggerTimeNs = 0;
+		frozen = false;
+		oscCapture = false;
+		updateRecordingState();
+		return;
+	}
+
+	uint64_t triggerTime = triggerTimeNs.load();
+	if(triggerTime != 0 && now() >= triggerTime + (uint64_t) oscPostTriggerMs.get() * 1000000) {
+		// Writers that saw recording enabled finish before the next fast timer
+		frozen = true;
+		updateRecordingState();
+	}
+}
+
+bool TraceRecorder::writeTrace(const std::string& fileName) {
+	uint64_t endIndex = writeIndex.load(std::memory_order_acquire);
+	uint64_t beginIndex = std::max(startIndex, endIndex > EVENT_CAPACITY ? endIndex - EVENT_CAPACITY : 0);
+
+	std::unique_ptr<FILE, FileCloser> file(fopen(fileName.c_str(), "wb"));
+	if(!file) {
+		SPDLOG_ERROR("{}: failed to open trace file {}", getFullAddress(), fileName);
+		return false;
+	}
+
+	// Timestamps are relative to the first event to keep them short
+	uint64_t originNs = UINT64_MAX;
+	for(uint64_t index = beginIndex; index < endIndex; index++) {
+		const Event& event = events[index % EVENT_CAPACITY];
+		if(event.sequence.load(std::memory_order_acquire) == index + 1)
+			originNs = std::min(originNs, event.timeNs);
+	}
+
+	std::map<int32_t, std::string> escapedTrackNames;
+	fprintf(file.get(), "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	fprintf(file.get(), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"damc_server\"}}");
+	for(const auto& trackName : trackNames) {
+		std::string name = escapeJson(trackName.second);
+		escapedTrackNames[trackName.first] = name;
+		fprintf(file.get(),
+		        ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+		        trackName.first,
+		        name.c_str());
+	}
+
+	for(uint64_t index = beginIndex; index < endIndex; index++) {
+		const Event& event = events[index % EVENT_CAPACITY];
+		if(event.sequence.load(std::memory_order_acquire) != index + 1)
+			continue;
+
+		double timeUs = (event.timeNs - originNs) / 1000.0;
+
+		switch(event.type) {
+			case Duration:
+				fprintf(file.get(),
+				        ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				        event.name,
+				        event.track,
+				        timeUs,
+				        event.value / 1000.0);
+				break;
+			case Counter: {
+				// Counters are global to the process, the track name makes them unique
+				auto it = escapedTrackNames.find(event.track);
+				std::string trackName = it != escapedTrackNames.end() ? it->second : std::to_string(event.track);
+				fprintf(file.get(),
+				        ",\n{\"name\":\"%s %s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+				        "\"args\":{\"value\":%lld}}",
+				        trackName.c_str(),
+				        event.name,
+				        event.track,
+				        timeUs,
+				        (long long) event.value);
+				break;
+			}
+			case Instant:
+				fprintf(file.get(),
+				        ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+				        event.name,
+				        event.track,
+				        timeUs);
+				break;
+		}
+	}
+
+	fprintf(file.get(), "\n]}\n");
+
+	if(ferror(file.get())) {
+		SPDLOG_ERROR("{}: failed to write trace file {}", getFullAddress(), fileName);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Osc/OscContainer.h>
+#include <Osc/OscVariable.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/*
+ * Timing trace of the audio callbacks to investigate xruns.
+ *
+ * When enabled, audio threads record timestamped events in a ring buffer of the last EVENT_CAPACITY events: the
+ * duration of each callback and of its stages, the fill level of endpoint buffers and JACK xruns. Each track is shown
+ * as a thread in trace viewers, track 0 is used for the JACK clients and the shared client cycles.
+ *
+ * A capture is triggered with "capture" or automatically on xrun. Recording continues for postTriggerMs after the
+ * trigger then the ring buffer content is written to a Chrome trace JSON file, which can be opened with Perfetto or
+ * chrome://tracing, and recording restarts with an empty buffer.
+ *
+ * Recording is wait-free: writers reserve a slot with a single atomic increment. Names must be string literals as
+ * only pointers are stored.
+ */
+class TraceRecorder : public OscContainer {
+public:
+	TraceRecorder(OscContainer* parent, const std::string& fileNamePrefix);
+
+	void setTrackName(int32_t track, const std::string& name);
+
+	// Any thread
+	bool isEnabled() const { return recording.load(std::memory_order_acquire); }
+	static uint64_t now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		           std::chrono::steady_clock::now().time_since_epoch())
+		    .count();
+	}
+	void recordDuration(int32_t track, const char* name, uint64_t startNs, uint64_t endNs);
+	void recordCounter(int32_t track, const char* name, uint64_t timeNs, int64_t value);
+	// Called from the JACK notification thread
+	void notifyXrun(int32_t track);
+
+	void onFastTimer();
+
+protected:
+	static constexpr size_t EVENT_CAPACITY = 1 << 18;
+
+	enum EventType { Duration, Counter, Instant };
+
+	struct Event {
+		// Index + 1 of the event stored in the slot, written last
+		std::atomic<uint64_t> sequence{0};
+		uint64_t timeNs;
+		int64_t value;  // Duration in ns or counter value
+		const char* name;
+		int32_t track;
+		EventType type;
+	};
+
+	void record(EventType type, int32_t track, const char* name, uint64_t timeNs, int64_t value);
+	void trigger(uint64_t timeNs);
+	void updateRecordingState();
+	bool writeTrace(const std::string& fileName);
+
+private:
+	std::string fileNamePrefix;
+	std::map<int32_t, std::string> trackNames;
+	std::unique_ptr<Event[]> events;
+	alignas(64) std::atomic<uint64_t> writeIndex{0};
+	uint64_t startIndex = 0;  // First event of the current capture
+	std::atomic<bool> recording{false};
+	std::atomic<bool> captureOnXrunEnabled{false};
+	std::atomic<uint64_t> triggerTimeNs{0};  // 0 when no capture is pending
+	std::atomic<int32_t> xruns{0};
+	// Recording is stopped, the buffer is written on the next fast timer once writers are done
+	bool frozen = false;
+
+	OscVariable<bool> oscEnable;
+	OscVariable<bool> oscCapture;
+	OscVariable<bool> oscCaptureOnXrun;
+	OscVariable<int32_t> oscPostTriggerMs;
+	OscVariable<int32_t> oscXrunCount;
+	OscReadOnlyVariable<std::string> oscLastFile;
+};
@@ -0,0 +1,421 @@
+#include <CompressorFilter.h>
+#include <DelayFilter.h>
+#include <DspProfiler.h>
+#include <EqFilter.h>
+#include <ExpanderFilter.h>
+#include <FilteringChain.h>
+#include <OscRoot.h>
+#include <ReverbFilter.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iterator>
+#include <json.h>
+#include <math.h>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../binauralSynthesis/Convolver.h"
+#include "../damc_server/ChannelStrip/ResamplingFilter.h"
+
+/*
+ * DSP micro-benchmarks, without JACK.
+ *
+ * Each benchmark processes blocks of white noise for each buffer size and channel count until the minimum duration is
+ * reached and reports the mean time per sample of each channel and the mean block time relative to the period at
+ * 48 kHz. Results are written as JSON to stdout, progress to stderr.
+ */
+
+static const double SAMPLE_RATE = 48000;
+
+static const size_t BLOCK_SIZES[] = {32, 64, 128, 256, 512, 1024, 2048, 4096};
+static const size_t CHANNEL_COUNTS[] = {1, 2, 4, 8, 16, 32};
+static const size_t QUICK_BLOCK_SIZES[] = {64, 1024};
+static const size_t QUICK_CHANNEL_COUNTS[] = {2, 8};
+
+struct Options {
+	bool quick = false;
+	double minDurationSeconds = 0.05;
+	std::vector<std::string> benchmarks;
+};
+
+// Synthetic input and output buffers of numChannel x blockSize samples
+class AudioBuffers {
+public:
+	AudioBuffers(size_t numChannel, size_t blockSize)
+	    : input(numChannel, std::vector<float>(blockSize)), output(numChannel, std::vector<float>(blockSize)) {
+		for(size_t channel = 0; channel < numChannel; channel++) {
+			for(float& sample : input[channel])
+				sample = (rand() / (float) RAND_MAX - 0.5f) * 0.5f;
+			inputPointers.push_back(input[channel].data());
+			outputPointers.push_back(output[channel].data());
+		}
+	}
+
+	const float** getInputs() { return inputPointers.data(); }
+	float** getOutputs() { return outputPointers.data(); }
+
+private:
+	std::vector<std::vector<float>> input;
+	std::vector<std::vector<float>> output;
+	std::vector<const float*> inputPointers;
+	std::vector<float*> outputPointers;
+};
+
+class BenchmarkRunner {
+public:
+	BenchmarkRunner(const Options& options) : options(options) {}
+
+	bool isSelected(const std::string& benchmark) const {
+		return options.benchmarks.empty() ||
+		       std::find(options.benchmarks.begin(), options.benchmarks.end(), benchmark) != options.benchmarks.end();
+	}
+
+	template<typename Function> void forEachSize(Function function) {
+		const size_t* blockSizes = options.quick ? QUICK_BLOCK_SIZES : BLOCK_SIZES;
+		size_t blockSizeCount = options.quick ? std::size(QUICK_BLOCK_SIZES) : std::size(BLOCK_SIZES);
+		const size_t* channelCounts = options.quick ? QUICK_CHANNEL_COUNTS : CHANNEL_COUNTS;
+		size_t channelCountCount = options.quick ? std::size(QUICK_CHANNEL_COUNTS) : std::size(CHANNEL_COUNTS);
+
+		for(size_t i = 0; i < blockSizeCount; i++) {
+			for(size_t j = 0; j < channelCountCount; j++)
+				function(blockSizes[i], channelCounts[j]);
+		}
+	}
+
+	// Time processBlock and add a result, processBlock must process one block of all channels
+	void run(const std::string& benchmark,
+	         const std::string& variant,
+	         size_t blockSize,
+	         size_t numChannel,
+	         const std::function<void()>& processBlock) {
+		// Let filters reach their steady state (allocations, FFT plans, caches)
+		for(int i = 0; i < 4; i++)
+			processBlock();
+
+		size_t blockCount = 0;
+		double totalNs = 0;
+		double maxBlockNs = 0;
+
+		while(blockCount < 16 || totalNs < options.minDurationSeconds * 1e9) {
+			auto start = std::chrono::steady_clock::now();
+			processBlock();
+			auto end = std::chrono::steady_clock::now();
+
+			double blockNs = std::chrono::duration<double, std::nano>(end - start).count();
+			totalNs += blockNs;
+			maxBlockNs = std::max(maxBlockNs, blockNs);
+			blockCount++;
+		}
+
+		double meanBlockNs = totalNs / blockCount;
+		double periodNs = blockSize * 1e9 / SAMPLE_RATE;
+
+		nlohmann::json result;
+		result["benchmark"] = benchmark;
+		result["variant"] = variant;
+		result["blockSize"] = blockSize;
+		result["channels"] = numChannel;
+		result["blocks"] = blockCount;
+		result["nsPerSample"] = meanBlockNs / (blockSize * numChannel);
+		result["meanBlockNs"] = meanBlockNs;
+		result["maxBlockNs"] = maxBlockNs;
+		result["cpuPercent"] = meanBlockNs * 100 / periodNs;
+		results.push_back(result);
+
+		fprintf(stderr,
+		        "%-12s %-28s block %4d, %2d channels: %8.3f ns/sample, %7.3f%% CPU\n",
+		        benchmark.c_str(),
+		        variant.c_str(),
+		        (int) blockSize,
+		        (int) numChannel,
+		        meanBlockNs / (blockSize * numChannel),
+		        meanBlockNs * 100 / periodNs);
+	}
+
+	nlohmann::json getReport() const {
+		nlohmann::json report;
+		report["sampleRate"] = SAMPLE_RATE;
+		report["minDurationSeconds"] = options.minDurationSeconds;
+		report["results"] = results;
+		return report;
+	}
+
+private:
+	Options options;
+	nlohmann::json results = nlohmann::json::array();
+};
+
+// Whole strip processing with a set of enabled stages, configured through OSC like the server does
+static void benchmarkFilterChain(BenchmarkRunner& runner) {
+	static const char* const STAGE_SETS[] = {
+	    "none",
+	    "delay",
+	    "eq",
+	    "expander",
+	    "compressor",
+	    "reverb",
+	    "volume",
+	    "eq+compressor",
+	    "delay+eq+expander+compressor+reverb+volume",
+	};
+
+	runner.forEachSize([&runner](size_t blockSize, size_t numChannel) {
+		for(const char* stageSet : STAGE_SETS) {
+			std::string stages = std::string("+") + stageSet + "+";
+			auto hasStage = [&stages](const char* stage) {
+				return stages.find(std::string("+") + stage + "+") != std::string::npos;
+			};
+
+			OscRoot oscRoot(false);
+			OscVariable<int32_t> oscNumChannel(&oscRoot, "channels", 0);
+			OscReadOnlyVariable<int32_t> oscSampleRate(&oscRoot, "sample_rate", SAMPLE_RATE);
+			DspProfiler profiler(&oscRoot, nullptr, 0);
+			FilterChain filters(&oscRoot, &oscNumChannel, &oscSampleRate, &profiler);
+
+			oscNumChannel = numChannel;
+
+			if(hasStage("delay"))
+				oscRoot.execute("filterChain/delay", {OscArgument(480)});
+			if(hasStage("eq")) {
+				// The 6 default bands
+				for(int band = 0; band < 6; band++) {
+					std::string address = "filterChain/eqFilters/" + std::to_string(band) + "/";
+					oscRoot.execute(address + "type", {OscArgument((int32_t) FilterType::Peak)});
+					oscRoot.execute(address + "f0", {OscArgument(100.0f * (band + 1))});
+					oscRoot.execute(address + "gain", {OscArgument(3.0f)});
+					oscRoot.execute(address + "enable", {OscArgument(true)});
+				}
+			}
+			if(hasStage("expander"))
+				oscRoot.execute("filterChain/expanderFilter/enable", {OscArgument(true)});
+			if(hasStage("compressor"))
+				oscRoot.execute("filterChain/compressorFilter/enable", {OscArgument(true)});
+			if(hasStage("reverb")) {
+				for(size_t channel = 0; channel < numChannel; channel++)
+					oscRoot.execute("filterChain/reverbFilter/" + std::to_string(channel) + "/enabled",
+					                {OscArgument(true)});
+			}
+			if(hasStage("volume"))
+				oscRoot.execute("filterChain/volume", {OscArgument(-6.0f)});
+
+			filters.reset(SAMPLE_RATE, blockSize);
+
+			AudioBuffers buffers(numChannel, blockSize);
+			runner.run("filterChain", stageSet, blockSize, numChannel, [&]() {
+				filters.processSamples(buffers.getOutputs(), buffers.getInputs(), numChannel, blockSize);
+			});
+		}
+	});
+}
+
+static void benchmarkEq(BenchmarkRunner& runner) {
+	runner.forEachSize([&runner](size_t blockSize, size_t numChannel) {
+		OscRoot oscRoot(false);
+		EqFilter filter(&oscRoot, "eq");
+		AudioBuffers buffers(numChannel, blockSize);
+
+		filter.init(numChannel);
+		filter.reset(SAMPLE_RATE);
+		filter.setParameters(true, FilterType::Peak, 1000, 3, 0.7);
+
+		runner.run("eq", "peak", blockSize, numChannel, [&]() {
+			filter.processSamples(buffers.getOutputs(), buffers.getInputs(), blockSize);
+		});
+	});
+}
+
+template<class Filter> static void benchmarkDynamics(BenchmarkRunner& runner, const char* name) {
+	runner.forEachSize([&runner, name](size_t blockSize, size_t numChannel) {
+		OscRoot oscRoot(false);
+		Filter filter(&oscRoot);
+		AudioBuffers buffers(numChannel, blockSize);
+
+		filter.init(numChannel);
+		filter.reset(SAMPLE_RATE);
+		oscRoot.execute(filter.getName() + "/enable", {OscArgument(true)});
+
+		runner.run(name, "default", blockSize, numChannel, [&]() {
+			filter.processSamples(buffers.getOutputs(), buffers.getInputs(), blockSize);
+		});
+	});
+}
+
+static void benchmarkReverb(BenchmarkRunner& runner) {
+	runner.forEachSize([&runner](size_t blockSize, size_t numChannel) {
+		OscRoot oscRoot(false);
+		std::vector<std::unique_ptr<ReverbFilter>> filters;
+		AudioBuffers buffers(numChannel, blockSize);
+
+		for(size_t channel = 0; channel < numChannel; channel++) {
+			filters.emplace_back(new ReverbFilter(&oscRoot, std::to_string(channel)));
+			filters.back()->reset();
+			oscRoot.execute(std::to_string(channel) + "/enabled", {OscArgument(true)});
+		}
+
+		runner.run("reverb", "default", blockSize, numChannel, [&]() {
+			for(size_t channel = 0; channel < numChannel; channel++)
+				filters[channel]->processSamples(
+				    buffers.getOutputs()[channel], buffers.getInputs()[channel], blockSize);
+		});
+	});
+}
+
+static void benchmarkDelay(BenchmarkRunner& runner) {
+	runner.forEachSize([&runner](size_t blockSize, size_t numChannel) {
+		std::vector<DelayFilter> filters(numChannel);
+		AudioBuffers buffers(numChannel, blockSize);
+
+		for(DelayFilter& filter : filters)
+			filter.setParameters(480);
+
+		runner.run("delay", "480", blockSize, numChannel, [&]() {
+			for(size_t channel = 0; channel < numChannel; channel++)
+				filters[channel].processSamples(buffers.getOutputs()[channel], buffers.getInputs()[channel], blockSize);
+		});
+	});
+}
+
+static void benchmarkResampling(BenchmarkRunner& runner) {
+	// Rational ratio with precomputed phases and arbitrary ratio as used with clock drift compensation
+	static const struct {
+		const char* name;
+		bool driftTracking;
+		float clockDrift;
+		ResamplingFilter::Mode expectedMode;
+	} VARIANTS[] = {{"44100to48000", false, 0.0f, ResamplingFilter::M_Rational},
+	                {"44100to48000+drift", true, 1e-4f, ResamplingFilter::M_Interpolated}};
+
+	runner.forEachSize([&runner](size_t blockSize, size_t numChannel) {
+		for(const auto& variant : VARIANTS) {
+			std::vector<ResamplingFilter> filters(numChannel);
+			AudioBuffers buffers(numChannel, blockSize);
+			std::vector<float> output;
+
+			for(ResamplingFilter& filter : filters) {
+				filter.setDriftTracking(variant.driftTracking);
+				filter.reset(44100);
+				filter.setTargetSamplingRate(SAMPLE_RATE);
+				filter.setClockDrift(variant.clockDrift);
+				filter.updateParameters();
+			}
+			output.resize(filters[0].getMaxRequiredOutputSize(blockSize));
+
+			if(filters[0].getMode() != variant.expectedMode) {
+				fprintf(stderr,
+				        "resampling %s: unexpected mode %d instead of %d, skipped\n",
+				        variant.name,
+				        (int) filters[0].getMode(),
+				        (int) variant.expectedMode);
+				continue;
+			}
+
+			runner.run("resampling", variant.name, blockSize, numChannel, [&]() {
+				for(size_t channel = 0; channel < numChannel; channel++) {
+					filters[channel].updateParameters();
+					filters[channel].processSamples(output.data(), buffers.getInputs()[channel], blockSize);
+				}
+			});
+		}
+	});
+}
+
+static void benchmarkConvolver(BenchmarkRunner& runner) {
+	// HRTF length and a longer filter
+	static const size_t FILTER_LENGTHS[] = {256, 2048};
+
+	runner.forEachSize([&runner](size_t blockSize, size_t numChannel) {
+		for(size_t filterLength : FILTER_LENGTHS) {
+			std::vector<float> impulseResponse(filterLength);
+			std::vector<Convolver> convolvers(numChannel);
+			AudioBuffers buffers(numChannel, blockSize);
+
+			for(size_t i = 0; i < filterLength; i++)
+				impulseResponse[i] = (rand() / (float) RAND_MAX - 0.5f) * expf(-(float) i / (filterLength / 4));
+
+			for(Convolver& convolver : convolvers) {
+				convolver.setBlockSize(blockSize);
+				convolver.setConvolver(impulseResponse.data(), impulseResponse.size());
+			}
+
+			runner.run("convolver", "ir" + std::to_string(filterLength), blockSize, numChannel, [&]() {
+				for(size_t channel = 0; channel < numChannel; channel++)
+					convolvers[channel].processSamples(buffers.getOutputs()[channel],
+					                                   const_cast<float*>(buffers.getInputs()[channel]),
+					                                   blockSize);
+			});
+		}
+	});
+}
+
+static void printUsage(const char* program) {
+	fprintf(stderr,
+	        "Usage: %s [--quick] [--min-duration SECONDS] [--output FILE] [BENCHMARK...]\n"
+	        "Benchmarks: filterChain eq compressor expander reverb delay resampling convolver\n",
+	        program);
+}
+
+int main(int argc, char* argv[]) {
+	Options options;
+	const char* outputFileName = nullptr;
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "--quick") == 0) {
+			options.quick = true;
+			options.minDurationSeconds = 0.01;
+		} else if(strcmp(argv[i], "--min-duration") == 0 && i + 1 < argc) {
+			options.minDurationSeconds = atof(argv[++i]);
+		} else if(strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			outputFileName = argv[++i];
+		} else if(argv[i][0] == '-') {
+			printUsage(argv[0]);
+			return 1;
+		} else {
+			options.benchmarks.push_back(argv[i]);
+		}
+	}
+
+	// Filters log their configuration changes
+	spdlog::set_level(spdlog::level::warn);
+	srand(0);
+
+	BenchmarkRunner runner(options);
+
+	if(runner.isSelected("filterChain"))
+		benchmarkFilterChain(runner);
+	if(runner.isSelected("eq"))
+		benchmarkEq(runner);
+	if(runner.isSelected("compressor"))
+		benchmarkDynamics<CompressorFilter>(runner, "compressor");
+	if(runner.isSelected("expander"))
+		benchmarkDynamics<ExpanderFilter>(runner, "expander");
+	if(runner.isSelected("reverb"))
+		benchmarkReverb(runner);
+	if(runner.isSelected("delay"))
+		benchmarkDelay(runner);
+	if(runner.isSelected("resampling"))
+		benchmarkResampling(runner);
+	if(runner.isSelected("convolver"))
+		benchmarkConvolver(runner);
+
+	std::string report = runner.getReport().dump(1, '\t') + "\n";
+
+	if(outputFileName) {
+		FILE* file = fopen(outputFileName, "wb");
+		if(!file) {
+			fprintf(stderr, "Failed to open %s\n", outputFileName);
+			return 1;
+		}
+		fwrite(report.data(), 1, report.size(), file);
+		fclose(file);
+	} else {
+		fwrite(report.data(), 1, report.size(), stdout);
+	}
+
+	return 0;
+}
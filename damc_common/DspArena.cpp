@@ -0,0 +1,169 @@
+#include "DspArena.h"
+#include <errno.h>
+#include <spdlog/spdlog.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+constexpr size_t PAGE_SIZE = 4096;
+
+}  // namespace
+
+void DspArena::Deleter::operator()(void* pointer) const {
+	if(arena)
+		arena->deallocate(pointer);
+	else
+		deallocateHeap(pointer);
+}
+
+DspArena::~DspArena() {
+	for(auto& region : regions) {
+		if(region->liveBlocks)
+			SPDLOG_ERROR("DSP arena destroyed with {} buffers still in use", region->liveBlocks);
+		unmapRegion(region.get());
+	}
+}
+
+void DspArena::reserve(size_t size) {
+	size = (size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+
+	if(currentRegion && currentRegion->size == size)
+		return;
+
+	currentRegion = nullptr;
+	fullWarningLogged = false;
+
+	if(size > 0) {
+		std::unique_ptr<Region> region(new Region);
+		if(mapRegion(region.get(), size)) {
+			currentRegion = region.get();
+			regions.push_back(std::move(region));
+		}
+	}
+
+	releaseUnusedRegions();
+}
+
+size_t DspArena::getUsedSize() const {
+	return currentRegion ? currentRegion->used : 0;
+}
+
+void* DspArena::allocate(size_t size) {
+	uint8_t sizeClass = 0;
+	while((MIN_BLOCK_SIZE << sizeClass) < size)
+		sizeClass++;
+	size_t blockSize = MIN_BLOCK_SIZE << sizeClass;
+
+	Region* region = currentRegion;
+	void* pointer;
+
+	if(!region)
+		return allocateHeap(size);
+
+	if(region->freeLists[sizeClass]) {
+		FreeBlock* block = region->freeLists[sizeClass];
+		region->freeLists[sizeClass] = block->next;
+		pointer = block;
+	} else if(region->used + blockSize <= region->size) {
+		// Blocks are powers of two bigger than MIN_BLOCK_SIZE, so used stays aligned
+		pointer = region->base + region->used;
+		region->used += blockSize;
+	} else {
+		if(!fullWarningLogged) {
+			SPDLOG_WARN("DSP arena of {} kB is full, allocating {} bytes from the heap", region->size / 1024, size);
+			fullWarningLogged = true;
+		}
+		return allocateHeap(size);
+	}
+
+	region->liveBlocks++;
+	blocks[pointer] = Block{region, sizeClass};
+
+	return pointer;
+}
+
+void DspArena::deallocate(void* pointer) {
+	auto it = blocks.find(pointer);
+	if(it == blocks.end()) {
+		deallocateHeap(pointer);
+		return;
+	}
+
+	Region* region = it->second.region;
+	FreeBlock* block = static_cast<FreeBlock*>(pointer);
+	block->next = region->freeLists[it->second.sizeClass];
+	region->freeLists[it->second.sizeClass] = block;
+	region->liveBlocks--;
+	blocks.erase(it);
+
+	if(region->liveBlocks == 0 && region != currentRegion)
+		releaseUnusedRegions();
+}
+
+void DspArena::releaseUnusedRegions() {
+	for(size_t i = 0; i < regions.size();) {
+		if(regions[i]->liveBlocks == 0 && regions[i].get() != currentRegion) {
+			unmapRegion(regions[i].get());
+			regions.erase(regions.begin() + i);
+		} else {
+			i++;
+		}
+	}
+}
+
+void* DspArena::allocateHeap(size_t size) {
+	return ::operator new(size, std::align_val_t(MIN_BLOCK_SIZE));
+}
+
+void DspArena::deallocateHeap(void* pointer) {
+	::operator delete(pointer, std::align_val_t(MIN_BLOCK_SIZE));
+}
+
+bool DspArena::mapRegion(Region* region, size_t size) {
+#ifdef _WIN32
+	void* base = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if(!base) {
+		SPDLOG_ERROR("Failed to allocate DSP arena of {} kB: {}", size / 1024, GetLastError());
+		return false;
+	}
+	if(!VirtualLock(base, size))
+		SPDLOG_WARN("Failed to lock DSP arena of {} kB in memory: {}", size / 1024, GetLastError());
+#else
+	void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(base == MAP_FAILED) {
+		SPDLOG_ERROR("Failed to allocate DSP arena of {} kB: {}", size / 1024, strerror(errno));
+		return false;
+	}
+	if(mlock(base, size) != 0) {
+		SPDLOG_WARN("Failed to lock DSP arena of {} kB in memory: {}, check RLIMIT_MEMLOCK (ulimit -l)",
+		            size / 1024,
+		            strerror(errno));
+	}
+#endif
+
+	// Fault in all pages now, even when locking failed
+	volatile char* pages = static_cast<char*>(base);
+	for(size_t offset = 0; offset < size; offset += PAGE_SIZE)
+		pages[offset] = 0;
+
+	region->base = static_cast<char*>(base);
+	region->size = size;
+
+	return true;
+}
+
+void DspArena::unmapRegion(Region* region) {
+#ifdef _WIN32
+	VirtualUnlock(region->base, region->size);
+	VirtualFree(region->base, 0, MEM_RELEASE);
+#else
+	munlock(region->base, region->size);
+	munmap(region->base, region->size);
+#endif
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Locked memory for the DSP state of a strip (delay lines, filter histories, dynamics state).
+ *
+ * reserve() allocates one region, pre-faults it and locks it in RAM so the audio thread never takes a page fault on
+ * this state. Buffers are carved from the region by the main thread in power of two blocks, freed blocks are kept in
+ * a free list per size and reused for the next allocation of the same size.
+ *
+ * When no arena is used, it is not reserved yet (or reserved with a size of 0) or it is full, buffers are allocated
+ * from the heap instead. Buffers only keep a pointer to the arena in their deleter, so the arena must outlive them.
+ * When reserve() is called with another size, the previous region is released once all of its buffers are freed.
+ *
+ * Allocations and deallocations must be done by the main thread.
+ */
+class DspArena {
+public:
+	struct Deleter {
+		DspArena* arena;
+		void operator()(void* pointer) const;
+	};
+	template<typename T> using Buffer = std::unique_ptr<T[], Deleter>;
+
+	DspArena() = default;
+	DspArena(const DspArena&) = delete;
+	DspArena& operator=(const DspArena&) = delete;
+	~DspArena();
+
+	void reserve(size_t size);
+	size_t getUsedSize() const;
+
+	// Value initialized, arena can be nullptr to allocate from the heap
+	template<typename T> static Buffer<T> makeBuffer(DspArena* arena, size_t count);
+
+protected:
+	static constexpr size_t MIN_BLOCK_SIZE = 64;  // Cache line, also the alignment of all buffers
+	static constexpr size_t SIZE_CLASS_COUNT = 40;
+
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	struct Region {
+		char* base = nullptr;
+		size_t size = 0;
+		size_t used = 0;
+		size_t liveBlocks = 0;
+		FreeBlock* freeLists[SIZE_CLASS_COUNT] = {};
+	};
+
+	struct Block {
+		Region* region;
+		uint8_t sizeClass;
+	};
+
+	void* allocate(size_t size);
+	void deallocate(void* pointer);
+	void releaseUnusedRegions();
+
+	static void* allocateHeap(size_t size);
+	static void deallocateHeap(void* pointer);
+	static bool mapRegion(Region* region, size_t size);
+	static void unmapRegion(Region* region);
+
+private:
+	std::vector<std::unique_ptr<Region>> regions;
+	Region* currentRegion = nullptr;  // Used for new allocations
+	std::unordered_map<void*, Block> blocks;
+	bool fullWarningLogged = false;
+};
+
+template<typename T> DspArena::Buffer<T> DspArena::makeBuffer(DspArena* arena, size_t count) {
+	static_assert(std::is_trivially_destructible<T>::value, "Buffer destructor doesn't run element destructors");
+	static_assert(alignof(T) <= MIN_BLOCK_SIZE, "Buffer alignment is not enough for the type");
+
+	size_t size = std::max<size_t>(count * sizeof(T), 1);
+	void* memory = arena ? arena->allocate(size) : allocateHeap(size);
+	T* data = static_cast<T*>(memory);
+
+	for(size_t i = 0; i < count; i++)
+		new(&data[i]) T();
+
+	return Buffer<T>(data, Deleter{arena});
+}
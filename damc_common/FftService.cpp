@@ -0,0 +1,104 @@
+#include "FftService.h"
+#include "Utils.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <stdio.h>
+
+static_assert(sizeof(std::complex<float>) == sizeof(fftwf_complex), "cannot cast std::complex to fftwf_complex");
+
+namespace {
+struct FftState {
+	std::mutex mutex;
+	std::map<size_t, std::unique_ptr<FftService::ForwardPlan>> forwardPlans;
+	std::map<size_t, std::unique_ptr<FftService::InversePlan>> inversePlans;
+	std::string wisdomFileName;
+};
+}  // namespace
+
+static FftState& getState() {
+	static FftState state;
+	return state;
+}
+
+const FftService::ForwardPlan* FftService::getForwardPlan(size_t size) {
+	FftState& state = getState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	std::unique_ptr<ForwardPlan>& plan = state.forwardPlans[size];
+	if(!plan) {
+		plan.reset(new ForwardPlan);
+		plan->plan = createPlan(size, true);
+		plan->size = size;
+		saveWisdom();
+	}
+
+	return plan.get();
+}
+
+const FftService::InversePlan* FftService::getInversePlan(size_t size) {
+	FftState& state = getState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	std::unique_ptr<InversePlan>& plan = state.inversePlans[size];
+	if(!plan) {
+		plan.reset(new InversePlan);
+		plan->plan = createPlan(size, false);
+		plan->size = size;
+		saveWisdom();
+	}
+
+	return plan.get();
+}
+
+FftService::Buffer<float> FftService::allocateReal(size_t size) {
+	return Buffer<float>(fftwf_alloc_real(std::max(size, size_t(1))));
+}
+
+FftService::Buffer<std::complex<float>> FftService::allocateComplex(size_t size) {
+	return Buffer<std::complex<float>>(
+	    reinterpret_cast<std::complex<float>*>(fftwf_alloc_complex(std::max(size, size_t(1)))));
+}
+
+fftwf_plan FftService::createPlan(size_t size, bool forward) {
+	// FFTW_MEASURE overwrites the arrays, plan on scratch buffers
+	Buffer<float> timeDomain = allocateReal(size);
+	Buffer<std::complex<float>> freqDomain = allocateComplex(size / 2 + 1);
+	fftwf_complex* freqDomainData = reinterpret_cast<fftwf_complex*>(freqDomain.get());
+
+	SPDLOG_DEBUG("Creating {} FFT plan of size {}", forward ? "forward" : "inverse", size);
+
+	if(forward)
+		return fftwf_plan_dft_r2c_1d(size, timeDomain.get(), freqDomainData, FFTW_MEASURE);
+	else
+		return fftwf_plan_dft_c2r_1d(size, freqDomainData, timeDomain.get(), FFTW_MEASURE);
+}
+
+bool FftService::setWisdomFile(const std::string& fileName) {
+	FftState& state = getState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	state.wisdomFileName = fileName;
+
+	if(!fftwf_import_wisdom_from_filename(fileName.c_str())) {
+		SPDLOG_INFO("No FFT wisdom loaded from {}, plans will be measured", fileName);
+		return false;
+	}
+
+	SPDLOG_INFO("Loaded FFT wisdom from {}", fileName);
+	return true;
+}
+
+void FftService::saveWisdom() {
+	FftState& state = getState();
+
+	if(state.wisdomFileName.empty())
+		return;
+
+	bool saved = Utils::writeFileAtomically(state.wisdomFileName, [](const std::string& temporaryFileName) {
+		return fftwf_export_wisdom_to_filename(temporaryFileName.c_str()) != 0;
+	});
+	if(!saved)
+		SPDLOG_WARN("Failed to save FFT wisdom to {}", state.wisdomFileName);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <complex>
+#include <memory>
+#include <stddef.h>
+#include <string>
+
+#include <fftw3.h>
+
+/*
+ * Process wide FFT plans and buffers, shared by all FFT users.
+ *
+ * Plans are created with FFTW_MEASURE on first use and cached by size and direction. They are never destroyed so a
+ * plan pointer stays valid for the whole process. The FFTW planner isn't thread-safe, so planning and wisdom accesses
+ * are serialized with a mutex. When a wisdom file is set, it is loaded once and saved each time a new plan is measured
+ * so later starts skip the measurements.
+ *
+ * Executing a plan is realtime-safe: it neither allocates nor plans. Buffers given to execute() must be aligned like
+ * the ones returned by allocateReal() and allocateComplex(), getAlignedCount() keeps arrays stored back to back in
+ * the same buffer aligned.
+ */
+class FftService {
+public:
+	static constexpr size_t ALIGNMENT = 64;
+
+	struct Deleter {
+		void operator()(void* data) { fftwf_free(data); }
+	};
+	template<typename T> using Buffer = std::unique_ptr<T[], Deleter>;
+
+	// Real to complex transform of size samples to size / 2 + 1 values
+	class ForwardPlan {
+	public:
+		size_t getSize() const { return size; }
+		void execute(const float* timeDomain, std::complex<float>* freqDomain) const {
+			fftwf_execute_dft_r2c(
+			    plan, const_cast<float*>(timeDomain), reinterpret_cast<fftwf_complex*>(freqDomain));
+		}
+
+	private:
+		friend class FftService;
+		fftwf_plan plan;
+		size_t size;
+	};
+
+	// Complex to real transform of size / 2 + 1 values to size samples, not normalized. freqDomain is overwritten.
+	class InversePlan {
+	public:
+		size_t getSize() const { return size; }
+		void execute(std::complex<float>* freqDomain, float* timeDomain) const {
+			fftwf_execute_dft_c2r(plan, reinterpret_cast<fftwf_complex*>(freqDomain), timeDomain);
+		}
+
+	private:
+		friend class FftService;
+		fftwf_plan plan;
+		size_t size;
+	};
+
+	// Not realtime-safe, get plans before starting audio processing
+	static const ForwardPlan* getForwardPlan(size_t size);
+	static const InversePlan* getInversePlan(size_t size);
+
+	static Buffer<float> allocateReal(size_t size);
+	static Buffer<std::complex<float>> allocateComplex(size_t size);
+	template<typename T> static constexpr size_t getAlignedCount(size_t count) {
+		return (count + ALIGNMENT / sizeof(T) - 1) & ~(ALIGNMENT / sizeof(T) - 1);
+	}
+
+	// Load wisdom from fileName and save it there when new plans are measured
+	static bool setWisdomFile(const std::string& fileName);
+
+private:
+	static fftwf_plan createPlan(size_t size, bool forward);
+	static void saveWisdom();
+};
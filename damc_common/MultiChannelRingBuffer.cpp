@@ -0,0 +1,60 @@
+#include "MultiChannelRingBuffer.h"
+#include <algorithm>
+
+void MultiChannelRingBuffer::reset(size_t numChannel, size_t minCapacity) {
+	// Power of 2 capacity so indices can be masked
+	capacity = 1;
+	while(capacity < minCapacity)
+		capacity *= 2;
+
+	this->numChannel = numChannel;
+	data.reset(new float[numChannel * capacity]());
+	writeIndex = 0;
+	readIndex = 0;
+}
+
+size_t MultiChannelRingBuffer::getWriteAvailable() const {
+	return capacity - (writeIndex.load(std::memory_order_relaxed) - readIndex.load(std::memory_order_acquire));
+}
+
+size_t MultiChannelRingBuffer::write(const float* const* samples, size_t frameCount) {
+	size_t position = writeIndex.load(std::memory_order_relaxed);
+
+	frameCount = std::min(frameCount, getWriteAvailable());
+
+	size_t offset = position & (capacity - 1);
+	size_t firstPart = std::min(frameCount, capacity - offset);
+
+	for(size_t channel = 0; channel < numChannel; channel++) {
+		float* channelData = &data[channel * capacity];
+		std::copy_n(samples[channel], firstPart, channelData + offset);
+		std::copy_n(samples[channel] + firstPart, frameCount - firstPart, channelData);
+	}
+
+	writeIndex.store(position + frameCount, std::memory_order_release);
+
+	return frameCount;
+}
+
+size_t MultiChannelRingBuffer::getReadAvailable() const {
+	return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_relaxed);
+}
+
+size_t MultiChannelRingBuffer::read(float* const* samples, size_t frameCount) {
+	size_t position = readIndex.load(std::memory_order_relaxed);
+
+	frameCount = std::min(frameCount, getReadAvailable());
+
+	size_t offset = position & (capacity - 1);
+	size_t firstPart = std::min(frameCount, capacity - offset);
+
+	for(size_t channel = 0; channel < numChannel; channel++) {
+		const float* channelData = &data[channel * capacity];
+		std::copy_n(channelData + offset, firstPart, samples[channel]);
+		std::copy_n(channelData, frameCount - firstPart, samples[channel] + firstPart);
+	}
+
+	readIndex.store(position + frameCount, std::memory_order_release);
+
+	return frameCount;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+
+/*
+ * Single producer, single consumer ring buffer of audio frames.
+ *
+ * All channels share the same read and write indices so they always have the same fill level and a whole block of
+ * frames is transferred with one pair of atomic operations. Samples are stored planar, each channel has its own
+ * contiguous area of getCapacity() samples.
+ *
+ * reset() is not thread safe and must be called while neither side is running.
+ */
+class MultiChannelRingBuffer {
+public:
+	void reset(size_t numChannel, size_t minCapacity);
+
+	size_t getNumChannel() const { return numChannel; }
+	size_t getCapacity() const { return capacity; }
+
+	// Producer thread
+	size_t getWriteAvailable() const;
+	// Write up to frameCount frames of all channels, return the number of frames written
+	size_t write(const float* const* samples, size_t frameCount);
+
+	// Consumer thread
+	size_t getReadAvailable() const;
+	// Read up to frameCount frames of all channels, return the number of frames read
+	size_t read(float* const* samples, size_t frameCount);
+
+private:
+	size_t numChannel = 0;
+	size_t capacity = 0;
+	std::unique_ptr<float[]> data;
+
+	// Free running frame counters, on their own cache line to avoid false sharing between both threads
+	alignas(64) std::atomic<size_t> writeIndex{0};
+	alignas(64) std::atomic<size_t> readIndex{0};
+};
@@ -17,6 +17,8 @@ public:
 	OscGenericArray(OscContainer* parent, std::string name) noexcept;
 
 	void setFactory(OscFactoryFunction factoryFunction);
+	// Called after items are added or removed
+	void addChangeCallback(std::function<void()> onChange);
 
 	// T& operator[](size_t index) { return *value.at(index); }
 	// const T& operator[](size_t index) const { return *value.at(index); }
@@ -95,6 +97,10 @@ template<typename T> void OscGenericArray<T>::setFactory(OscFactoryFunction fact
 	this->factoryFunction = factoryFunction;
 }
 
+template<typename T> void OscGenericArray<T>::addChangeCallback(std::function<void()> onChange) {
+	keys.addChangeCallback([onChange](const std::vector<int32_t>&, const std::vector<int32_t>&) { onChange(); });
+}
+
 template<typename T> bool OscGenericArray<T>::contains(size_t index) const {
 	return value.count(index) > 0;
 }
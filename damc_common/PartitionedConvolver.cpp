@@ -0,0 +1,111 @@
+#include "PartitionedConvolver.h"
+#include <algorithm>
+
+void PartitionedConvolver::init(size_t inputNumber, size_t outputNumber, size_t blockSize, size_t maxImpulseSize) {
+	this->inputNumber = inputNumber;
+	this->outputNumber = outputNumber;
+	this->blockSize = blockSize;
+	this->maxImpulseSize = maxImpulseSize;
+	partitionCount = std::max((maxImpulseSize + blockSize - 1) / blockSize, size_t(1));
+	spectrumSize = blockSize + 1;
+
+	// Keep each buffer aligned like the ones used to create the plans
+	spectrumStride = FftService::getAlignedCount<std::complex<float>>(spectrumSize);
+	inputStride = FftService::getAlignedCount<float>(2 * blockSize);
+
+	// Plans are shared by all convolvers of the same size
+	partitions = FftService::allocateComplex(inputNumber * outputNumber * partitionCount * spectrumStride);
+	delayLine = FftService::allocateComplex(inputNumber * partitionCount * spectrumStride);
+	accumulator = FftService::allocateComplex(spectrumStride);
+	inputBuffers = FftService::allocateReal(std::max(inputNumber, size_t(1)) * inputStride);
+	outputBuffer = FftService::allocateReal(2 * blockSize);
+	forwardPlan = FftService::getForwardPlan(2 * blockSize);
+	inversePlan = FftService::getInversePlan(2 * blockSize);
+
+	std::fill_n(partitions.get(), inputNumber * outputNumber * partitionCount * spectrumStride, 0);
+	std::fill_n(delayLine.get(), inputNumber * partitionCount * spectrumStride, 0);
+	std::fill_n(inputBuffers.get(), std::max(inputNumber, size_t(1)) * inputStride, 0.0f);
+	delayLinePos = 0;
+}
+
+void PartitionedConvolver::setImpulseResponse(size_t input, size_t output, const float* samples, size_t size) {
+	// Normalization of the inverse transform is included in partitions
+	const float scale = 1.0f / (2 * blockSize);
+	float* partition = outputBuffer.get();
+
+	size = std::min(size, maxImpulseSize);
+
+	for(size_t p = 0; p < partitionCount; p++) {
+		std::fill_n(partition, 2 * blockSize, 0.0f);
+		for(size_t i = 0; i < blockSize && p * blockSize + i < size; i++) {
+			partition[i] = samples[p * blockSize + i] * scale;
+		}
+
+		forwardPlan->execute(partition, getPartition(input, output, p));
+	}
+}
+
+void PartitionedConvolver::setPartitions(size_t input, size_t output, const std::complex<float>* spectra) {
+	std::copy_n(spectra, partitionCount * spectrumStride, getPartition(input, output, 0));
+}
+
+void PartitionedConvolver::processSamples(float** outputs, const float* const* inputs, size_t nframes) {
+	if(nframes != blockSize)
+		return;
+
+	// Overlap-save: transform the previous and the current block of each input, stored in its delay line
+	for(size_t input = 0; input < inputNumber; input++) {
+		float* inputBuffer = getInputBuffer(input);
+
+		std::copy_n(inputBuffer + blockSize, blockSize, inputBuffer);
+		std::copy_n(inputs[input], blockSize, inputBuffer + blockSize);
+
+		forwardPlan->execute(inputBuffer, getDelayLine(input, delayLinePos));
+	}
+
+	// Multiply each partition with the spectrum of the input delayed by the same number of blocks, then one inverse
+	// transform per output of the sum of all inputs. The first half of the output is aliased.
+	float* acc = reinterpret_cast<float*>(accumulator.get());
+	for(size_t output = 0; output < outputNumber; output++) {
+		std::fill_n(acc, 2 * spectrumSize, 0.0f);
+
+		for(size_t input = 0; input < inputNumber; input++) {
+			for(size_t p = 0; p < partitionCount; p++) {
+				size_t delayedPos = (delayLinePos + partitionCount - p) % partitionCount;
+				const float* x = reinterpret_cast<const float*>(getDelayLine(input, delayedPos));
+				const float* h = reinterpret_cast<const float*>(getPartition(input, output, p));
+
+				for(size_t k = 0; k < spectrumSize; k++) {
+					float xr = x[2 * k], xi = x[2 * k + 1];
+					float hr = h[2 * k], hi = h[2 * k + 1];
+					acc[2 * k] += xr * hr - xi * hi;
+					acc[2 * k + 1] += xr * hi + xi * hr;
+				}
+			}
+		}
+
+		inversePlan->execute(accumulator.get(), outputBuffer.get());
+		std::copy_n(outputBuffer.get() + blockSize, blockSize, outputs[output]);
+	}
+
+	delayLinePos = (delayLinePos + 1) % partitionCount;
+}
+
+void PartitionedConvolver::skip(size_t count) {
+	// Only the first silent block overlaps with the previous input, the spectrum of the others is 0
+	for(size_t i = 0; i < count && i < partitionCount; i++) {
+		for(size_t input = 0; input < inputNumber; input++) {
+			float* inputBuffer = getInputBuffer(input);
+			std::complex<float>* spectrum = getDelayLine(input, delayLinePos);
+
+			std::copy_n(inputBuffer + blockSize, blockSize, inputBuffer);
+			std::fill_n(inputBuffer + blockSize, blockSize, 0.0f);
+			if(i == 0)
+				forwardPlan->execute(inputBuffer, spectrum);
+			else
+				std::fill_n(spectrum, spectrumSize, 0);
+		}
+
+		delayLinePos = (delayLinePos + 1) % partitionCount;
+	}
+}
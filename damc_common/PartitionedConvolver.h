@@ -0,0 +1,71 @@
+#pragma once
+
+#include <complex>
+#include <memory>
+#include <stddef.h>
+
+#include "FftService.h"
+
+/*
+ * Uniformly partitioned overlap-save convolution of N inputs with N x M impulse responses mixed into M outputs.
+ *
+ * Impulse responses are split in partitions of blockSize samples, each one transformed once. Each input block is
+ * transformed once and stored in a frequency-domain delay line, its spectrum is multiplied with all partitions and
+ * accumulated into one spectrum per output, which is transformed back. The cost per sample grows with log(blockSize) +
+ * IR length / blockSize instead of IR length, and a block needs N + M transforms instead of 2 x N x M with one
+ * convolution per input and output. Using the JACK period as block size adds no latency.
+ *
+ * A single channel convolution is the 1 x 1 case.
+ */
+class PartitionedConvolver {
+public:
+	// Not realtime-safe, impulse responses start silent
+	void init(size_t inputNumber, size_t outputNumber, size_t blockSize, size_t maxImpulseSize);
+	// size is truncated to maxImpulseSize
+	void setImpulseResponse(size_t input, size_t output, const float* samples, size_t size);
+
+	// 0 before init()
+	size_t getBlockSize() const { return blockSize; }
+	size_t getPartitionCount() const { return partitionCount; }
+	size_t getSpectrumStride() const { return spectrumStride; }
+
+	// Spectra of all partitions of an impulse response, partitionCount x spectrumStride values
+	const std::complex<float>* getPartitions(size_t input, size_t output) const {
+		return &partitions[(input * outputNumber + output) * partitionCount * spectrumStride];
+	}
+	void setPartitions(size_t input, size_t output, const std::complex<float>* spectra);
+
+	// nframes must be the block size given to init(), outputs can be the same buffers as inputs
+	void processSamples(float** outputs, const float* const* inputs, size_t nframes);
+	// Advance the history by count silent input blocks, without computing outputs
+	void skip(size_t count);
+
+protected:
+	std::complex<float>* getPartition(size_t input, size_t output, size_t partition) {
+		return &partitions[((input * outputNumber + output) * partitionCount + partition) * spectrumStride];
+	}
+	std::complex<float>* getDelayLine(size_t input, size_t position) {
+		return &delayLine[(input * partitionCount + position) * spectrumStride];
+	}
+	float* getInputBuffer(size_t input) { return &inputBuffers[input * inputStride]; }
+
+private:
+	size_t inputNumber = 0;
+	size_t outputNumber = 0;
+	size_t blockSize = 0;
+	size_t maxImpulseSize = 0;
+	size_t partitionCount = 0;
+	size_t spectrumSize = 0;
+	size_t spectrumStride = 0;
+	size_t inputStride = 0;
+	size_t delayLinePos = 0;
+
+	FftService::Buffer<std::complex<float>> partitions;
+	FftService::Buffer<std::complex<float>> delayLine;
+	FftService::Buffer<std::complex<float>> accumulator;
+	// Previous and current block of each input
+	FftService::Buffer<float> inputBuffers;
+	FftService::Buffer<float> outputBuffer;
+	const FftService::ForwardPlan* forwardPlan = nullptr;
+	const FftService::InversePlan* inversePlan = nullptr;
+};
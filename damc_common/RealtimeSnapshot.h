@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/*
+ * Publish DSP parameters from the main thread to the audio thread.
+ *
+ * The main thread builds a complete copy of the parameters and publishes it with a single atomic store. The audio
+ * thread calls acquire() once per block and uses the returned parameters for the whole block, so it never sees a
+ * partially updated set. Neither side takes a lock and the audio thread never allocates or frees memory.
+ *
+ * Replaced copies are freed by the main thread in publish() or reclaim(), unless the audio thread is still using it.
+ * At most one replaced copy is kept alive this way (the one last acquired by the audio thread).
+ *
+ * There must be only one audio thread calling acquire() for a given snapshot.
+ */
+template<typename T> class RealtimeSnapshot {
+public:
+	RealtimeSnapshot() : RealtimeSnapshot(T{}) {}
+	explicit RealtimeSnapshot(T initialValue);
+	RealtimeSnapshot(const RealtimeSnapshot&) = delete;
+	RealtimeSnapshot& operator=(const RealtimeSnapshot&) = delete;
+
+	// Main thread
+	const T& get() const { return *current; }
+	void publish(T value);
+	void reclaim();
+
+	// Audio thread, the returned value stays valid until the next call to acquire()
+	const T* acquire();
+
+private:
+	std::atomic<T*> published;
+	std::atomic<T*> inUse;
+
+	std::unique_ptr<T> current;
+	std::vector<std::unique_ptr<T>> retired;
+};
+
+template<typename T>
+RealtimeSnapshot<T>::RealtimeSnapshot(T initialValue)
+    : published(nullptr), inUse(nullptr), current(new T(std::move(initialValue))) {
+	published = current.get();
+}
+
+template<typename T> void RealtimeSnapshot<T>::publish(T value) {
+	std::unique_ptr<T> newValue(new T(std::move(value)));
+
+	published = newValue.get();
+	retired.push_back(std::move(current));
+	current = std::move(newValue);
+
+	reclaim();
+}
+
+template<typename T> void RealtimeSnapshot<T>::reclaim() {
+	// This load is ordered after the store to published, so either the audio thread has marked the old value as in
+	// use and it is kept, or it will see the new value when checking published again in acquire()
+	T* usedValue = inUse;
+
+	retired.erase(std::remove_if(retired.begin(),
+	                             retired.end(),
+	                             [usedValue](const std::unique_ptr<T>& value) { return value.get() != usedValue; }),
+	              retired.end());
+}
+
+template<typename T> const T* RealtimeSnapshot<T>::acquire() {
+	T* value = published;
+	T* markedValue;
+
+	// Mark the value as in use, then check it wasn't replaced in the meantime (it might have been freed otherwise)
+	do {
+		markedValue = value;
+		inUse = markedValue;
+		value = published;
+	} while(value != markedValue);
+
+	return value;
+}
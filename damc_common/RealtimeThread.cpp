@@ -0,0 +1,54 @@
+#include "RealtimeThread.h"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_AMD64) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SSE_ENABLED
+#endif
+
+#ifdef SSE_ENABLED
+#include <xmmintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Below the JACK threads (70 by default), helper threads work ahead of them or are decoupled by buffers
+constexpr int HELPER_THREAD_PRIORITY = 60;
+
+}  // namespace
+
+void RealtimeThread::setFloatingPointMode() {
+#ifdef SSE_ENABLED
+	unsigned int oldMXCSR = _mm_getcsr();      /* read the old MXCSR setting */
+	unsigned int newMXCSR = oldMXCSR | 0x8040; /* set DAZ and FZ bits */
+	_mm_setcsr(newMXCSR);                      /* write the new MXCSR setting to the MXCSR */
+#elif defined(__aarch64__)
+	uint64_t fpcr;
+	__asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+	fpcr |= 1 << 24; /* set FZ bit */
+	__asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+#endif
+}
+
+void RealtimeThread::setHelperThreadPriority(const char* threadName) {
+#ifdef _WIN32
+	if(!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+		SPDLOG_WARN("Failed to set {} thread priority: {}", threadName, GetLastError());
+#else
+	struct sched_param param = {};
+	param.sched_priority = std::min(HELPER_THREAD_PRIORITY, sched_get_priority_max(SCHED_FIFO));
+
+	int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	if(ret != 0)
+		SPDLOG_WARN(
+		    "Failed to set {} thread realtime priority {}: {}", threadName, param.sched_priority, strerror(ret));
+#endif
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+/*
+ * Setup of the current thread when it runs DSP code or feeds the audio threads.
+ *
+ * Used by damc_server for JACK threads and by the helper threads of the audio processing, like network streams or
+ * the convolution tail worker, which need a realtime priority to not cause underruns under a normal system load.
+ */
+class RealtimeThread {
+public:
+	// FTZ and DAZ on x86, FZ on ARM
+	static void setFloatingPointMode();
+	// Realtime priority below the JACK threads
+	static void setHelperThreadPriority(const char* threadName);
+};
@@ -0,0 +1,50 @@
+#include "SimdVector.h"
+#include <atomic>
+
+static std::atomic<Simd::Level> maxLevel{Simd::AVX512};
+
+Simd::Level Simd::getSupportedLevel() {
+	static const Level supportedLevel = []() {
+#ifdef SIMD_X86_DISPATCH
+		__builtin_cpu_init();
+#ifndef _WIN32
+		// GCC doesn't realign the stack for 32/64 bytes vectors on Windows (GCC bug 54412), so wide vectors are only
+		// used on other platforms
+		if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+			return AVX512;
+		if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return AVX2;
+#endif
+		if(__builtin_cpu_supports("sse2"))
+			return SSE2;
+#endif
+		return Scalar;
+	}();
+
+	return supportedLevel;
+}
+
+Simd::Level Simd::getLevel() {
+	Level supportedLevel = getSupportedLevel();
+	Level max = maxLevel.load(std::memory_order_relaxed);
+
+	return supportedLevel < max ? supportedLevel : max;
+}
+
+void Simd::setMaxLevel(Level level) {
+	maxLevel.store(level, std::memory_order_relaxed);
+}
+
+const char* Simd::getLevelName(Level level) {
+	switch(level) {
+		case Scalar:
+			return "scalar";
+		case SSE2:
+			return "sse2";
+		case AVX2:
+			return "avx2";
+		case AVX512:
+			return "avx512";
+	}
+	return "unknown";
+}
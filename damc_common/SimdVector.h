@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Portable SIMD lane types for the multi-channel DSP kernels.
+ *
+ * Kernels are written once as templates over the lane count using GCC vector extensions, then instantiated inside
+ * functions tagged with SIMD_TARGET_* so the compiler emits SSE2/AVX2/AVX-512 code for each of them. The right
+ * instantiation is selected at runtime with Simd::getLevel().
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86_DISPATCH
+#define SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f,avx512dq")))
+#else
+#define SIMD_TARGET_SSE2
+#define SIMD_TARGET_AVX2
+#define SIMD_TARGET_AVX512
+#endif
+
+#define SIMD_ALWAYS_INLINE inline __attribute__((always_inline))
+
+namespace Simd {
+
+enum Level { Scalar, SSE2, AVX2, AVX512 };
+
+// Highest instruction set usable by kernels, capped by setMaxLevel()
+Level getLevel();
+Level getSupportedLevel();
+void setMaxLevel(Level level);
+const char* getLevelName(Level level);
+
+template<typename T, size_t N> using Vector __attribute__((vector_size(sizeof(T) * N))) = T;
+
+// Vectors are passed by reference as passing them by value changes the ABI depending on enabled instruction sets
+template<typename V, typename T> SIMD_ALWAYS_INLINE void broadcast(V& v, T value) {
+	v = V{} + value;
+}
+
+template<typename V, typename T> SIMD_ALWAYS_INLINE void load(V& v, const T* data) {
+	memcpy(&v, data, sizeof(v));
+}
+
+template<typename V, typename T> SIMD_ALWAYS_INLINE void store(T* data, const V& v) {
+	memcpy(data, &v, sizeof(v));
+}
+
+}  // namespace Simd
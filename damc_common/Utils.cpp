@@ -1,4 +1,5 @@
 #include "Utils.h"
+#include <stdio.h>
 
 bool Utils::isNumber(std::string_view s) {
 	for(char c : s) {
@@ -8,3 +9,22 @@ bool Utils::isNumber(std::string_view s) {
 	// empty string not considered as a number
 	return !s.empty();
 }
+
+bool Utils::writeFileAtomically(const std::string& fileName, const std::function<bool(const std::string&)>& write) {
+	// Write to a temporary file so an interrupted save never leaves a truncated file
+	std::string temporaryFileName = fileName + ".tmp";
+
+	if(!write(temporaryFileName)) {
+		remove(temporaryFileName.c_str());
+		return false;
+	}
+
+	// rename() doesn't replace existing files on Windows
+	remove(fileName.c_str());
+	if(rename(temporaryFileName.c_str(), fileName.c_str()) != 0) {
+		remove(temporaryFileName.c_str());
+		return false;
+	}
+
+	return true;
+}
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <functional>
+#include <string>
 #include <string_view>
 #include <vector>
 
 namespace Utils {
 
 bool isNumber(std::string_view s);
+// write() is given the name of a temporary file, it replaces fileName only if write() succeeded
+bool writeFileAtomically(const std::string& fileName, const std::function<bool(const std::string&)>& write);
 
 #define SPDLOG_LOG_WITH_LEVEL(level, ...) SPDLOG_LOGGER_CALL(spdlog::default_logger_raw(), level, __VA_ARGS__)
 
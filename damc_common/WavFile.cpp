@@ -0,0 +1,188 @@
+#include "WavFile.h"
+#include <algorithm>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+constexpr uint16_t WAVE_FORMAT_PCM = 1;
+constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+constexpr uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+struct FileCloser {
+	void operator()(FILE* file) { fclose(file); }
+};
+
+void writeU16(uint8_t* data, uint16_t value) {
+	data[0] = value & 0xFF;
+	data[1] = value >> 8;
+}
+
+void writeU32(uint8_t* data, uint32_t value) {
+	writeU16(data, value & 0xFFFF);
+	writeU16(data + 2, value >> 16);
+}
+
+uint16_t readU16(const uint8_t* data) {
+	return data[0] | (data[1] << 8);
+}
+
+uint32_t readU32(const uint8_t* data) {
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+float readSample(const uint8_t* data, uint16_t format, uint16_t bitsPerSample) {
+	if(format == WAVE_FORMAT_IEEE_FLOAT) {
+		if(bitsPerSample == 32) {
+			uint32_t value = readU32(data);
+			float sample;
+			memcpy(&sample, &value, sizeof(sample));
+			return sample;
+		} else {
+			uint64_t value = readU32(data) | ((uint64_t) readU32(data + 4) << 32);
+			double sample;
+			memcpy(&sample, &value, sizeof(sample));
+			return sample;
+		}
+	}
+
+	switch(bitsPerSample) {
+		case 16:
+			return (int16_t) readU16(data) / 32768.0f;
+		case 24:
+			return (int32_t) ((data[0] << 8) | (data[1] << 16) | ((uint32_t) data[2] << 24)) / 2147483648.0f;
+		default:
+			return (int32_t) readU32(data) / 2147483648.0f;
+	}
+}
+
+}  // namespace
+
+bool WavFile::read(const std::string& fileName, int32_t* sampleRate, std::vector<std::vector<float>>* channels) {
+	std::unique_ptr<FILE, FileCloser> file(fopen(fileName.c_str(), "rb"));
+	uint8_t header[12];
+
+	if(!file) {
+		SPDLOG_ERROR("Failed to open WAV file {}", fileName);
+		return false;
+	}
+
+	if(fread(header, 1, sizeof(header), file.get()) != sizeof(header) || memcmp(header, "RIFF", 4) != 0 ||
+	   memcmp(header + 8, "WAVE", 4) != 0) {
+		SPDLOG_ERROR("{} is not a WAV file", fileName);
+		return false;
+	}
+
+	uint16_t format = 0;
+	uint16_t numChannel = 0;
+	uint16_t bitsPerSample = 0;
+	uint32_t rate = 0;
+	std::vector<uint8_t> data;
+
+	// Chunks are word aligned, the data chunk comes after the fmt chunk
+	uint8_t chunkHeader[8];
+	while(fread(chunkHeader, 1, sizeof(chunkHeader), file.get()) == sizeof(chunkHeader)) {
+		uint32_t chunkSize = readU32(chunkHeader + 4);
+		long paddedSize = chunkSize + (chunkSize & 1);
+
+		if(memcmp(chunkHeader, "fmt ", 4) == 0) {
+			uint8_t fmt[40] = {};
+			if(chunkSize < 16 || fread(fmt, 1, std::min<size_t>(chunkSize, sizeof(fmt)), file.get()) < 16)
+				break;
+			if(chunkSize > sizeof(fmt))
+				fseek(file.get(), paddedSize - sizeof(fmt), SEEK_CUR);
+			else if(chunkSize & 1)
+				fseek(file.get(), 1, SEEK_CUR);
+
+			format = readU16(fmt);
+			numChannel = readU16(fmt + 2);
+			rate = readU32(fmt + 4);
+			bitsPerSample = readU16(fmt + 14);
+			// The actual format is the first 2 bytes of the subformat GUID
+			if(format == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 26)
+				format = readU16(fmt + 24);
+		} else if(memcmp(chunkHeader, "data", 4) == 0) {
+			data.resize(chunkSize);
+			data.resize(fread(data.data(), 1, chunkSize, file.get()));
+			break;
+		} else {
+			fseek(file.get(), paddedSize, SEEK_CUR);
+		}
+	}
+
+	bool supported =
+	    (format == WAVE_FORMAT_PCM && (bitsPerSample == 16 || bitsPerSample == 24 || bitsPerSample == 32)) ||
+	    (format == WAVE_FORMAT_IEEE_FLOAT && (bitsPerSample == 32 || bitsPerSample == 64));
+	if(!supported || numChannel == 0) {
+		SPDLOG_ERROR("{}: unsupported WAV format {} with {} bits per sample and {} channels",
+		             fileName,
+		             format,
+		             bitsPerSample,
+		             numChannel);
+		return false;
+	}
+
+	size_t frameSize = numChannel * bitsPerSample / 8;
+	size_t numFrame = data.size() / frameSize;
+
+	channels->assign(numChannel, std::vector<float>(numFrame));
+	for(size_t i = 0; i < numFrame; i++) {
+		for(size_t channel = 0; channel < numChannel; channel++) {
+			(*channels)[channel][i] =
+			    readSample(&data[i * frameSize + channel * bitsPerSample / 8], format, bitsPerSample);
+		}
+	}
+
+	*sampleRate = rate;
+
+	return true;
+}
+
+bool WavFile::write(const std::string& fileName,
+                    int32_t sampleRate,
+                    const std::vector<std::vector<float>>& channels) {
+	uint16_t numChannel = channels.size();
+	size_t numFrame = channels.empty() ? 0 : channels[0].size();
+	size_t frameSize = numChannel * sizeof(float);
+	uint32_t dataSize = numFrame * frameSize;
+	uint8_t header[44];
+
+	memcpy(header, "RIFF", 4);
+	writeU32(header + 4, sizeof(header) - 8 + dataSize);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	writeU32(header + 16, 16);
+	writeU16(header + 20, WAVE_FORMAT_IEEE_FLOAT);
+	writeU16(header + 22, numChannel);
+	writeU32(header + 24, sampleRate);
+	writeU32(header + 28, sampleRate * frameSize);
+	writeU16(header + 32, frameSize);
+	writeU16(header + 34, 32);
+	memcpy(header + 36, "data", 4);
+	writeU32(header + 40, dataSize);
+
+	// Interleaved little endian samples
+	std::vector<uint8_t> data(dataSize);
+	for(size_t i = 0; i < numFrame; i++) {
+		for(size_t channel = 0; channel < numChannel; channel++) {
+			uint32_t value;
+			memcpy(&value, &channels[channel][i], sizeof(value));
+			writeU32(&data[i * frameSize + channel * sizeof(float)], value);
+		}
+	}
+
+	std::unique_ptr<FILE, FileCloser> file(fopen(fileName.c_str(), "wb"));
+	if(!file) {
+		SPDLOG_ERROR("Failed to open WAV file {} for writing", fileName);
+		return false;
+	}
+
+	if(fwrite(header, 1, sizeof(header), file.get()) != sizeof(header) ||
+	   fwrite(data.data(), 1, data.size(), file.get()) != data.size()) {
+		SPDLOG_ERROR("Failed to write WAV file {}", fileName);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * Minimal RIFF WAVE reader and writer.
+ *
+ * Supports reading 16, 24 and 32 bits integer PCM and 32 and 64 bits float samples, including WAVE_FORMAT_EXTENSIBLE
+ * files. Samples are converted to float and deinterleaved.
+ * Files are written as 32 bits float samples.
+ */
+class WavFile {
+public:
+	static bool read(const std::string& fileName, int32_t* sampleRate, std::vector<std::vector<float>>* channels);
+	// All channels must have the same size
+	static bool write(const std::string& fileName, int32_t sampleRate, const std::vector<std::vector<float>>& channels);
+};
@@ -22,6 +22,7 @@ ChannelStrip::ChannelStrip(OscContainer* parent, ControlInterface* controlInterf
       outputInstance(index),
       controlInterface(controlInterface),
       client(nullptr),
+      hostedInSharedClient(false),
       jackSampleRateMeasure(this, "realSampleRate"),
 
       enableAudio(false),
@@ -31,8 +32,11 @@ ChannelStrip::ChannelStrip(OscContainer* parent, ControlInterface* controlInterf
       oscDisplayName(this, "display_name", oscName.get()),
       oscNumChannel(this, "channels", 2),
       oscSampleRate(this, "sample_rate"),
+      oscInternalInputs(this, "internal_inputs"),
+      oscDspArenaSizeKb(this, "dsp_arena_size_kb", 4096),
 
-      filters(this, &oscNumChannel, &oscSampleRate),
+      profiler(this, controlInterface->getTraceRecorder(), index + 1),
+      filters(this, &oscNumChannel, &oscSampleRate, &profiler, &arena),
       displayNameUpdateRequested(false) {
 	oscType.addCheckCallback([this](int newValue) -> bool {
 		if(client) {
@@ -89,17 +93,33 @@ ChannelStrip::ChannelStrip(OscContainer* parent, ControlInterface* controlInterf
 		SPDLOG_DEBUG("{}: Changing channel number to {}", oscDisplayName.get(), newValue);
 	});
 
+	oscDspArenaSizeKb.addCheckCallback([this](int32_t newValue) {
+		if(client) {
+			SPDLOG_ERROR("Can't change DSP arena size when output is enabled");
+			return false;
+		}
+
+		if(newValue < 0) {
+			SPDLOG_ERROR("Invalid value: {}", newValue);
+			return false;
+		}
+
+		return true;
+	});
+
+	oscInternalInputs.addChangeCallback(
+	    [this](const std::vector<std::string>&, const std::vector<std::string>& newValue) {
+		    if(client && hostedInSharedClient)
+			    this->controlInterface->getJackHost()->setInternalSources(this, newValue);
+	    });
+
 	if(audioRunning) {
 		activate();
 	}
 }
 
 ChannelStrip::~ChannelStrip() {
-	if(client) {
-		jack_deactivate(client);
-		jack_client_close(client);
-		client = nullptr;
-	}
+	closeJackClient();
 }
 
 void ChannelStrip::activate() {
@@ -129,65 +149,98 @@ int ChannelStrip::start() {
 	if(client || !endpoint)
 		return 0;
 
+	JackHost* jackHost = controlInterface->getJackHost();
 	std::string jackClientName = JACK_CLIENT_NAME_PREFIX + oscName.get();
-	SPDLOG_INFO("Opening jack client {}", jackClientName.c_str());
-	client = jack_client_open(jackClientName.c_str(), JackNullOption, &status);
-	if(client == NULL) {
-		SPDLOG_ERROR("Failed to open jack: {}", status);
-		return -3;
+
+	hostedInSharedClient = jackHost->isEnabled();
+	if(hostedInSharedClient) {
+		SPDLOG_INFO("Hosting {} in shared jack client", oscName.get());
+		client = jackHost->getClient();
+		if(client == NULL)
+			return -3;
+	} else {
+		SPDLOG_INFO("Opening jack client {}", jackClientName.c_str());
+		client = jack_client_open(jackClientName.c_str(), JackNullOption, &status);
+		if(client == NULL) {
+			SPDLOG_ERROR("Failed to open jack: {}", status);
+			return -3;
+		}
+
+		SPDLOG_INFO("Opened jack client");
 	}
 
-	SPDLOG_INFO("Opened jack client");
+	controlInterface->getTraceRecorder()->setTrackName(outputInstance + 1, oscName.get());
 
 	jackSampleRate = jack_get_sample_rate(client);
-	filters.reset(jackSampleRate);
+
+	// Filter states are reallocated from the arena by reset, 0 keeps them on the heap
+	arena.reserve((size_t) oscDspArenaSizeKb.get() * 1024);
+	filters.reset(jackSampleRate, jack_get_buffer_size(client));
+	SPDLOG_DEBUG("{}: {} kB of DSP arena used", oscName.get(), arena.getUsedSize() / 1024);
 	oscSampleRate.setDefault(jackSampleRate);
 
 	int additionnalPortFlags = 0;
 	if(oscType != Loopback)
 		additionnalPortFlags |= JackPortIsTerminal;
 
-	inputPorts.resize(oscNumChannel);
-	outputPorts.resize(oscNumChannel);
+	inputPorts.clear();
+	outputPorts.clear();
 	for(int32_t i = 0; i < oscNumChannel; i++) {
 		char name[64];
 
 		sprintf(name, "input_%d", (int) (i + 1));
-
-		inputPorts[i] =
-		    jack_port_register(client, name, JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput | additionnalPortFlags, 0);
-		if(inputPorts[i] == 0) {
+		inputPorts.push_back(registerPort(name, JackPortIsInput | additionnalPortFlags));
+		if(inputPorts.back() == 0) {
 			SPDLOG_ERROR("cannot register input port \"{}\"!", name);
-			jack_client_close(client);
-			client = nullptr;
+			closeJackClient();
 			return -4;
 		}
 
 		sprintf(name, "output_%d", (int) (i + 1));
-		outputPorts[i] =
-		    jack_port_register(client, name, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput | additionnalPortFlags, 0);
-		if(outputPorts[i] == 0) {
+		outputPorts.push_back(registerPort(name, JackPortIsOutput | additionnalPortFlags));
+		if(outputPorts.back() == 0) {
 			SPDLOG_ERROR("cannot register output port \"{}\"!", name);
-			jack_client_close(client);
-			client = nullptr;
+			closeJackClient();
 			return -4;
 		}
 	}
 
 	if(oscType != DeviceInput && oscType != RemoteInput) {
-		inputPorts.push_back(jack_port_register(
-		    client, "side_channel", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput | additionnalPortFlags, 0));
+		inputPorts.push_back(registerPort("side_channel", JackPortIsInput | additionnalPortFlags));
 		if(inputPorts.back() == 0) {
 			SPDLOG_ERROR("cannot register input port \"{}\"!", "side_channel");
-			jack_client_close(client);
-			client = nullptr;
+			closeJackClient();
 			return -4;
 		}
 	}
 
+	if(!hostedInSharedClient && !oscInternalInputs.getData().empty()) {
+		SPDLOG_WARN("{}: internal inputs are ignored when singleJackClient is disabled", oscName.get());
+	}
+
 	endpoint->start(outputInstance, oscNumChannel, jackSampleRate, jack_get_buffer_size(client));
 
+	if(hostedInSharedClient) {
+		// Used to mix internal inputs together or with the JACK input
+		internalInputBuffers.resize(oscNumChannel);
+		for(std::vector<float>& buffer : internalInputBuffers)
+			buffer.resize(jack_get_buffer_size(client));
+
+		// The shared client belongs to the host, it has no display name of its own
+		clientUuid = 0;
+		jackHost->addProcessCallback(&processHostedSamplesStatic,
+		                             this,
+		                             oscName.get(),
+		                             oscInternalInputs.getData(),
+		                             inputPorts,
+		                             outputPorts);
+		SPDLOG_INFO("Processing interface {}...", outputInstance);
+		return 0;
+	}
+
 	jack_set_process_callback(client, &processSamplesStatic, this);
+	jack_set_xrun_callback(client, &onJackXrunStatic, this);
+	controlInterface->getRealtimeThreadSetup()->registerClient(client);
 
 	const char* pszClientUuid = ::jack_get_uuid_for_client_name(client, jackClientName.c_str());
 	if(pszClientUuid) {
@@ -213,15 +266,45 @@ void ChannelStrip::stop() {
 	SPDLOG_INFO("Stopping jack client {}", oscName.get());
 
 	if(client) {
-		jack_deactivate(client);
-		jack_client_close(client);
-		client = nullptr;
+		closeJackClient();
 
 		if(endpoint)
 			endpoint->stop();
 	}
 }
 
+jack_port_t* ChannelStrip::registerPort(const char* name, unsigned long flags) {
+	if(hostedInSharedClient) {
+		// Prefix with the strip name as all strips share the same client
+		std::string portName = oscName.get() + "/" + name;
+		return controlInterface->getJackHost()->registerPort(portName, flags);
+	}
+
+	return jack_port_register(client, name, JACK_DEFAULT_AUDIO_TYPE, flags, 0);
+}
+
+void ChannelStrip::closeJackClient() {
+	if(!client)
+		return;
+
+	if(hostedInSharedClient) {
+		JackHost* jackHost = controlInterface->getJackHost();
+
+		jackHost->removeProcessCallback(this);
+		for(jack_port_t* port : inputPorts)
+			jackHost->unregisterPort(port);
+		for(jack_port_t* port : outputPorts)
+			jackHost->unregisterPort(port);
+	} else {
+		jack_deactivate(client);
+		jack_client_close(client);
+	}
+
+	inputPorts.clear();
+	outputPorts.clear();
+	client = nullptr;
+}
+
 bool ChannelStrip::updateType(int newValue) {
 	IAudioEndpoint* newEndpoint = nullptr;
 
@@ -337,13 +420,32 @@ void ChannelStrip::onJackPropertyChangeCallback(jack_uuid_t subject,
 	}
 }
 
+int ChannelStrip::onJackXrunStatic(void* arg) {
+	ChannelStrip* thisInstance = (ChannelStrip*) arg;
+
+	thisInstance->controlInterface->getTraceRecorder()->notifyXrun(thisInstance->outputInstance + 1);
+
+	return 0;
+}
+
 int ChannelStrip::processSamplesStatic(jack_nframes_t nframes, void* arg) {
 	ChannelStrip* thisInstance = (ChannelStrip*) arg;
 
 	thisInstance->jackSampleRateMeasure.notifySampleProcessed(nframes);
 
 	if(thisInstance->endpoint->direction == IAudioEndpoint::D_Output)
-		return thisInstance->processSamples(nframes);
+		return thisInstance->processSamples(nframes, nullptr);
+	else
+		return thisInstance->processInputSamples(nframes);
+}
+
+int ChannelStrip::processHostedSamplesStatic(jack_nframes_t nframes, const JackHost::HostedInputs& inputs, void* arg) {
+	ChannelStrip* thisInstance = (ChannelStrip*) arg;
+
+	thisInstance->jackSampleRateMeasure.notifySampleProcessed(nframes);
+
+	if(thisInstance->endpoint->direction == IAudioEndpoint::D_Output)
+		return thisInstance->processSamples(nframes, &inputs);
 	else
 		return thisInstance->processInputSamples(nframes);
 }
@@ -356,18 +458,71 @@ int ChannelStrip::processInputSamples(jack_nframes_t nframes) {
 		return 0;
 	}
 
+	bool profile = profiler.isEnabled();
+	uint64_t startTime = profile ? DspProfiler::now() : 0;
+
 	for(int32_t i = 0; i < oscNumChannel; i++) {
 		buffers[i] = (jack_default_audio_sample_t*) jack_port_get_buffer(outputPorts[i], nframes);
 	}
 
 	endpoint->postProcessSamples(buffers, oscNumChannel, nframes);
 
+	if(profile) {
+		uint64_t endpointEndTime = DspProfiler::now();
+		profiler.record(DspProfiler::Endpoint, startTime, endpointEndTime);
+		recordBufferFill(endpointEndTime);
+	}
+
 	filters.processSamples(buffers, const_cast<const float**>(buffers), oscNumChannel, nframes);
 
+	if(profile)
+		profiler.record(DspProfiler::Total, startTime, DspProfiler::now());
+
 	return 0;
 }
 
-int ChannelStrip::processSamples(jack_nframes_t nframes) {
+const float* ChannelStrip::getInternalInput(int32_t channel,
+                                            jack_nframes_t nframes,
+                                            const JackHost::HostedInputs& hostedInputs) {
+	const float* singleSource = nullptr;
+	size_t sourceCount = 0;
+
+	for(const std::vector<jack_port_t*>& sourcePorts : hostedInputs.internalSources) {
+		if(channel < (int32_t) sourcePorts.size()) {
+			singleSource = (const float*) jack_port_get_buffer(sourcePorts[channel], nframes);
+			sourceCount++;
+		}
+	}
+
+	bool jackInputConnected = hostedInputs.jackInputConnected[channel];
+
+	// No copy in the common case of a strip fed only by another one
+	if(sourceCount == 1 && !jackInputConnected)
+		return singleSource;
+
+	if(sourceCount == 0 || nframes > internalInputBuffers[channel].size())
+		return (const float*) jack_port_get_buffer(inputPorts[channel], nframes);
+
+	float* mixBuffer = internalInputBuffers[channel].data();
+	if(jackInputConnected) {
+		const float* jackInput = (const float*) jack_port_get_buffer(inputPorts[channel], nframes);
+		std::copy_n(jackInput, nframes, mixBuffer);
+	} else {
+		std::fill_n(mixBuffer, nframes, 0.0f);
+	}
+
+	for(const std::vector<jack_port_t*>& sourcePorts : hostedInputs.internalSources) {
+		if(channel < (int32_t) sourcePorts.size()) {
+			const float* source = (const float*) jack_port_get_buffer(sourcePorts[channel], nframes);
+			for(jack_nframes_t i = 0; i < nframes; i++)
+				mixBuffer[i] += source[i];
+		}
+	}
+
+	return mixBuffer;
+}
+
+int ChannelStrip::processSamples(jack_nframes_t nframes, const JackHost::HostedInputs* hostedInputs) {
 	float* outputs[32];
 	const float* inputs[32];
 
@@ -376,8 +531,14 @@ int ChannelStrip::processSamples(jack_nframes_t nframes) {
 		return 0;
 	}
 
+	bool profile = profiler.isEnabled();
+	uint64_t startTime = profile ? DspProfiler::now() : 0;
+
 	for(int32_t i = 0; i < oscNumChannel; i++) {
-		inputs[i] = (jack_default_audio_sample_t*) jack_port_get_buffer(inputPorts[i], nframes);
+		if(hostedInputs && !hostedInputs->internalSources.empty())
+			inputs[i] = getInternalInput(i, nframes, *hostedInputs);
+		else
+			inputs[i] = (jack_default_audio_sample_t*) jack_port_get_buffer(inputPorts[i], nframes);
 		outputs[i] = (jack_default_audio_sample_t*) jack_port_get_buffer(outputPorts[i], nframes);
 	}
 
@@ -392,11 +553,28 @@ int ChannelStrip::processSamples(jack_nframes_t nframes) {
 		}
 	}
 
-	endpoint->postProcessSamples(outputs, oscNumChannel, nframes);
+	if(profile) {
+		uint64_t endpointStartTime = DspProfiler::now();
+		endpoint->postProcessSamples(outputs, oscNumChannel, nframes);
+
+		uint64_t endTime = DspProfiler::now();
+		profiler.record(DspProfiler::Endpoint, endpointStartTime, endTime);
+		profiler.record(DspProfiler::Total, startTime, endTime);
+		recordBufferFill(endTime);
+	} else {
+		endpoint->postProcessSamples(outputs, oscNumChannel, nframes);
+	}
 
 	return 0;
 }
 
+void ChannelStrip::recordBufferFill(uint64_t timeNs) {
+	int32_t bufferFill = endpoint->getBufferFill();
+
+	if(bufferFill >= 0)
+		profiler.recordCounter("buffer fill", timeNs, bufferFill);
+}
+
 void ChannelStrip::onFastTimer() {
 	if(!client)
 		return;
@@ -422,4 +600,5 @@ void ChannelStrip::onSlowTimer() {
 		endpoint->onSlowTimer();
 
 	jackSampleRateMeasure.onTimeoutTimer();
+	profiler.onSlowTimer();
 }
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <DspArena.h>
 #include <FilteringChain.h>
 #include "IAudioEndpoint.h"
 #include "SampleRateMeasure.h"
 #include <Osc/OscCombinedVariable.h>
 #include <Osc/OscContainer.h>
+#include <Osc/OscFlatArray.h>
 #include <stdint.h>
 #include <uv.h>
 
@@ -12,6 +14,8 @@
 #include <jack/jack.h>
 #include <jack/metadata.h>
 
+#include "../JackHost.h"
+
 class ControlInterface;
 
 class ChannelStrip : public OscContainer {
@@ -59,10 +63,16 @@ public:
 protected:
 	bool updateType(int newValue);
 	void updateEnabledState(bool enable);
+	jack_port_t* registerPort(const char* name, unsigned long flags);
+	void closeJackClient();
 
+	static int onJackXrunStatic(void* arg);
 	static int processSamplesStatic(jack_nframes_t nframes, void* arg);
+	static int processHostedSamplesStatic(jack_nframes_t nframes, const JackHost::HostedInputs& inputs, void* arg);
 	int processInputSamples(jack_nframes_t nframes);
-	int processSamples(jack_nframes_t nframes);
+	int processSamples(jack_nframes_t nframes, const JackHost::HostedInputs* hostedInputs);
+	const float* getInternalInput(int32_t channel, jack_nframes_t nframes, const JackHost::HostedInputs& hostedInputs);
+	void recordBufferFill(uint64_t timeNs);
 
 	void updateJackDisplayName();
 	static void onJackPropertyChangeCallback(jack_uuid_t subject,
@@ -75,10 +85,12 @@ private:
 	ControlInterface* controlInterface;
 	std::unique_ptr<IAudioEndpoint> endpoint;
 	jack_client_t* client;
+	bool hostedInSharedClient;
 	jack_uuid_t clientUuid;
 	int jackSampleRate;
 	std::vector<jack_port_t*> inputPorts;
 	std::vector<jack_port_t*> outputPorts;
+	std::vector<std::vector<float>> internalInputBuffers;
 
 	SampleRateMeasure jackSampleRateMeasure;
 
@@ -89,7 +101,11 @@ private:
 	OscVariable<std::string> oscDisplayName;
 	OscVariable<int32_t> oscNumChannel;
 	OscReadOnlyVariable<int32_t> oscSampleRate;
+	OscFlatArray<std::string> oscInternalInputs;
+	OscVariable<int32_t> oscDspArenaSizeKb;
 
+	DspArena arena;  // before filters as they allocate their state from it
+	DspProfiler profiler;
 	FilterChain filters;
 
 	bool displayNameUpdateRequested;
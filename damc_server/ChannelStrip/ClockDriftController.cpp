@@ -0,0 +1,36 @@
+#include "ClockDriftController.h"
+#include <algorithm>
+#include <math.h>
+
+void ClockDriftController::reset(double samplingRate, double targetFill) {
+	this->samplingRate = samplingRate;
+	this->targetFill = targetFill;
+	smoothedFill = 0;
+	integral = 0;
+	initialized = false;
+	drift = 0;
+}
+
+void ClockDriftController::update(double bufferFill, size_t frameCount) {
+	double dt = frameCount / samplingRate;
+	double naturalFrequency = 2 * M_PI * LOOP_BANDWIDTH;
+	double proportionalGain = M_SQRT2 * naturalFrequency;
+	double integralGain = naturalFrequency * naturalFrequency;
+
+	if(!initialized) {
+		smoothedFill = bufferFill;
+		initialized = true;
+	}
+	smoothedFill += (bufferFill - smoothedFill) * std::min(1.0, dt / FILL_SMOOTHING_TIME);
+
+	// Fill error in seconds, a positive drift makes the resampler produce more samples
+	double error = (smoothedFill - targetFill) / samplingRate;
+	double newIntegral = integral + integralGain * error * dt;
+	double value = -(proportionalGain * error + newIntegral);
+
+	// Stop integrating while saturated to avoid windup
+	if(fabs(value) <= MAX_DRIFT)
+		integral = newIntegral;
+
+	drift.store(std::clamp(value, -MAX_DRIFT, MAX_DRIFT), std::memory_order_relaxed);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+/*
+ * Automatic clock drift compensation between 2 audio clocks connected by a ring buffer.
+ *
+ * The thread reading the ring buffer calls update() with the buffer fill on each callback. A PI loop adjusts the
+ * drift so the fill converges to the target, like a second order DLL with a bandwidth of LOOP_BANDWIDTH.
+ * The thread writing the ring buffer passes getDrift() to ResamplingFilter::setClockDrift().
+ */
+class ClockDriftController {
+public:
+	void reset(double samplingRate, double targetFill);
+
+	// Reader thread, bufferFill and frameCount in samples at samplingRate
+	void update(double bufferFill, size_t frameCount);
+
+	// Any thread
+	float getDrift() const { return drift.load(std::memory_order_relaxed); }
+	double getTargetFill() const { return targetFill; }
+
+private:
+	static constexpr double LOOP_BANDWIDTH = 0.02;
+	// The fill has a sawtooth shape with the size of read and write blocks, smooth it before feeding the loop
+	static constexpr double FILL_SMOOTHING_TIME = 1.0;
+	static constexpr double MAX_DRIFT = 0.001;
+
+	double samplingRate = 48000;
+	double targetFill = 0;
+	double smoothedFill = 0;
+	double integral = 0;
+	bool initialized = false;
+
+	std::atomic<float> drift{0};
+};
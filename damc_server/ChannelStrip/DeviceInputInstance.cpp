@@ -12,9 +12,12 @@ DeviceInputInstance::DeviceInputInstance(OscContainer* parent)
       oscDeviceName(this, "deviceName", "default_in"),
       oscClockDrift(this, "clockDrift", 0.0f),
       oscMeasuredClockDrift(this, "measuredClockDrift", 0.0f),
+      oscAutoClockDrift(this, "autoClockDrift", false),
+      oscTargetBufferFill(this, "targetBufferFill", 0),
       oscBufferSize(this, "bufferSize", 0),
       oscActualBufferSize(this, "actualBufferSize", 0),
       oscDeviceSampleRate(this, "deviceSampleRate", 48000),
+      oscResamplingTaps(this, "resamplingTaps", 64),
 #ifdef _WIN32
       oscExclusiveMode(this, "exclusiveMode", true),
 #endif
@@ -27,6 +30,10 @@ DeviceInputInstance::DeviceInputInstance(OscContainer* parent)
 	oscDeviceName.addCheckCallback([this](const std::string&) { return stream == nullptr; });
 	oscBufferSize.addCheckCallback([this](int newValue) { return stream == nullptr && newValue >= 0; });
 	oscDeviceSampleRate.addCheckCallback([this](int newValue) { return stream == nullptr && newValue > 0; });
+	oscAutoClockDrift.addCheckCallback([this](bool) { return stream == nullptr; });
+	oscTargetBufferFill.addCheckCallback([this](int newValue) { return stream == nullptr && newValue >= 0; });
+	oscResamplingTaps.addCheckCallback(
+	    [this](int newValue) { return stream == nullptr && ResamplingFilter::isValidTapCount(newValue); });
 
 #ifdef _WIN32
 	oscExclusiveMode.addCheckCallback([this](int) { return stream == nullptr; });
@@ -140,15 +147,20 @@ int DeviceInputInstance::start(int index, size_t numChannel, int sampleRate, int
 	                         ? oscBufferSize
 	                         : Pa_GetDeviceInfo(inputDeviceIndex)->defaultLowInputLatency * oscDeviceSampleRate + 0.5;
 
-	resampledBuffer.reserve(oscDeviceSampleRate);
 	resamplingFilters.resize(numChannel);
-	ringBuffers.clear();
+	// With automatic drift compensation, the buffer fill stays around the target instead of drifting away
+	size_t blockSize = jackBufferSize + bufferSize * sampleRate / oscDeviceSampleRate;
+	size_t targetFill = oscTargetBufferFill > 0 ? oscTargetBufferFill : blockSize;
+	size_t ringBufferSize = oscAutoClockDrift ? targetFill + blockSize : blockSize * 3;
+
+	clockDriftController.reset(sampleRate, targetFill);
+	ringBuffer.reset(numChannel, ringBufferSize);
+	resampledBuffers.resize(numChannel);
+	resampledBufferPointers.resize(numChannel);
 	for(size_t i = 0; i < numChannel; i++) {
-		std::unique_ptr<jack_ringbuffer_t, void (*)(jack_ringbuffer_t*)> buffer(nullptr, &jack_ringbuffer_free);
-		buffer.reset(jack_ringbuffer_create((jackBufferSize + bufferSize * sampleRate / oscDeviceSampleRate) * 3 *
-		                                    sizeof(jack_default_audio_sample_t)));
-		ringBuffers.emplace_back(std::move(buffer));
-
+		resampledBuffers[i].reserve(oscDeviceSampleRate);
+		resamplingFilters[i].setTapCount(oscResamplingTaps);
+		resamplingFilters[i].setDriftTracking(oscAutoClockDrift);
 		resamplingFilters[i].reset(oscDeviceSampleRate);
 		resamplingFilters[i].setTargetSamplingRate(sampleRate);
 		resamplingFilters[i].setClockDrift(this->oscClockDrift);
@@ -222,7 +234,7 @@ int DeviceInputInstance::renderCallbackStatic(const void* input,
                                               PaStreamCallbackFlags statusFlags,
                                               void* userData) {
 	DeviceInputInstance* thisInstance = (DeviceInputInstance*) userData;
-	size_t numChannel = thisInstance->ringBuffers.size();
+	size_t numChannel = thisInstance->ringBuffer.getNumChannel();
 	const jack_default_audio_sample_t* const* inputBuffers = (const jack_default_audio_sample_t**) input;
 
 	return thisInstance->renderCallback(inputBuffers, numChannel, frameCount);
@@ -233,19 +245,21 @@ int DeviceInputInstance::renderCallback(const float* const* samples, size_t numC
 	deviceSampleRateMeasure.notifySampleProcessed(nframes);
 
 	for(size_t i = 0; i < numChannel; i++) {
-		size_t dataSize;
-		resamplingFilters[i].processSamples(resampledBuffer, samples[i], nframes);
-
-		dataSize = resampledBuffer.size() * sizeof(resampledBuffer[0]);
+		if(oscAutoClockDrift)
+			resamplingFilters[i].setClockDrift(clockDriftController.getDrift());
+		resamplingFilters[i].processSamples(resampledBuffers[i], samples[i], nframes);
+		resampledBufferPointers[i] = resampledBuffers[i].data();
+	}
 
-		size_t availableData = jack_ringbuffer_write_space(ringBuffers[i].get());
+	// All filters have the same state so they output the same number of samples
+	size_t frameCount = resampledBuffers[0].size();
+	size_t availableSpace = ringBuffer.getWriteAvailable();
 
-		if(dataSize < availableData) {
-			jack_ringbuffer_write(ringBuffers[i].get(), (const char*) resampledBuffer.data(), dataSize);
-		} else {
-			overflowOccured = true;
-			overflowSize = availableData;
-		}
+	if(frameCount < availableSpace) {
+		ringBuffer.write(resampledBufferPointers.data(), frameCount);
+	} else {
+		overflowOccured = true;
+		overflowSize = availableSpace;
 	}
 
 	return paContinue;
@@ -258,23 +272,26 @@ int DeviceInputInstance::postProcessSamples(float** samples, size_t numChannel,
 	if(!stream)
 		return 0;
 
-	for(size_t i = 0; i < ringBuffers.size(); i++) {
-		availableData = jack_ringbuffer_read_space(ringBuffers[i].get());
+	availableData = ringBuffer.getReadAvailable();
 
-		if(availableData >= nframes * sizeof(samples[i][0])) {
-			jack_ringbuffer_read(ringBuffers[i].get(), (char*) samples[i], nframes * sizeof(samples[i][0]));
-		} else {
+	if(availableData >= nframes) {
+		ringBuffer.read(samples, nframes);
+	} else {
+		for(size_t i = 0; i < ringBuffer.getNumChannel(); i++) {
 			memset(reinterpret_cast<char*>(samples[i]), 0, nframes * sizeof(samples[i][0]));
-			underflowOccured = true;
-			underflowSize = availableData;
 		}
+		underflowOccured = true;
+		underflowSize = availableData;
 	}
 
+	if(oscAutoClockDrift)
+		clockDriftController.update(availableData, nframes);
+
 	if(underflowOccured) {
 		this->underflowOccured = true;
 		bufferLatencyHistory.clear();
 	} else if(availableData) {
-		bufferLatencyHistory.push_back(availableData / sizeof(jack_default_audio_sample_t));
+		bufferLatencyHistory.push_back(availableData);
 
 		if(bufferLatencyHistory.size() == bufferLatencyMeasurePeriodSize) {
 			double averageLatency = 0;
@@ -302,6 +319,10 @@ int DeviceInputInstance::postProcessSamples(float** samples, size_t numChannel,
 	return 0;
 }
 
+int32_t DeviceInputInstance::getBufferFill() {
+	return stream ? ringBuffer.getReadAvailable() : -1;
+}
+
 void DeviceInputInstance::onFastTimer() {
 	if(clockDriftPpm) {
 		SPDLOG_DEBUG("{}: average latency: {}", oscDeviceName.get(), previousAverageLatency);
@@ -330,5 +351,8 @@ void DeviceInputInstance::onSlowTimer() {
 		oscIsRunning = true;
 	}
 
+	if(oscAutoClockDrift && oscIsRunning)
+		oscMeasuredClockDrift = clockDriftController.getDrift() * 1000000.0f;
+
 	deviceSampleRateMeasure.onTimeoutTimer();
 }
@@ -13,9 +13,12 @@ DeviceOutputInstance::DeviceOutputInstance(OscContainer* parent)
       oscDeviceName(this, "deviceName", "default_out"),
       oscClockDrift(this, "clockDrift", 0.0f),
       oscMeasuredClockDrift(this, "measuredClockDrift", 0.0f),
+      oscAutoClockDrift(this, "autoClockDrift", false),
+      oscTargetBufferFill(this, "targetBufferFill", 0),
       oscBufferSize(this, "bufferSize", 0),
       oscActualBufferSize(this, "actualBufferSize", 0),
       oscDeviceSampleRate(this, "deviceSampleRate", 48000),
+      oscResamplingTaps(this, "resamplingTaps", 64),
 #ifdef _WIN32
       oscExclusiveMode(this, "exclusiveMode", true),
 #endif
@@ -26,6 +29,10 @@ DeviceOutputInstance::DeviceOutputInstance(OscContainer* parent)
 	oscDeviceName.addCheckCallback([this](const std::string&) { return stream == nullptr; });
 	oscBufferSize.addCheckCallback([this](int newValue) { return stream == nullptr && newValue >= 0; });
 	oscDeviceSampleRate.addCheckCallback([this](int newValue) { return stream == nullptr && newValue > 0; });
+	oscAutoClockDrift.addCheckCallback([this](bool) { return stream == nullptr; });
+	oscTargetBufferFill.addCheckCallback([this](int newValue) { return stream == nullptr && newValue >= 0; });
+	oscResamplingTaps.addCheckCallback(
+	    [this](int newValue) { return stream == nullptr && ResamplingFilter::isValidTapCount(newValue); });
 	oscDeviceSampleRate.addCheckCallback([this](int) { return stream == nullptr; });
 
 #ifdef _WIN32
@@ -147,15 +154,20 @@ int DeviceOutputInstance::start(int index, size_t numChannel, int sampleRate, in
 	                         ? oscBufferSize
 	                         : Pa_GetDeviceInfo(outputDeviceIndex)->defaultLowOutputLatency * oscDeviceSampleRate + 0.5;
 
-	resampledBuffer.reserve(sampleRate);
 	resamplingFilters.resize(numChannel);
-	ringBuffers.clear();
+	// With automatic drift compensation, the buffer fill stays around the target instead of drifting away
+	size_t blockSize = jackBufferSize + bufferSize * sampleRate / oscDeviceSampleRate;
+	size_t targetFill = oscTargetBufferFill > 0 ? oscTargetBufferFill : blockSize;
+	size_t ringBufferSize = oscAutoClockDrift ? targetFill + blockSize : blockSize * 3;
+
+	clockDriftController.reset(oscDeviceSampleRate, targetFill);
+	ringBuffer.reset(numChannel, ringBufferSize);
+	resampledBuffers.resize(numChannel);
+	resampledBufferPointers.resize(numChannel);
 	for(size_t i = 0; i < numChannel; i++) {
-		std::unique_ptr<jack_ringbuffer_t, void (*)(jack_ringbuffer_t*)> buffer(nullptr, &jack_ringbuffer_free);
-		buffer.reset(jack_ringbuffer_create((jackBufferSize + bufferSize * sampleRate / oscDeviceSampleRate) * 3 *
-		                                    sizeof(jack_default_audio_sample_t)));
-		ringBuffers.emplace_back(std::move(buffer));
-
+		resampledBuffers[i].reserve(sampleRate);
+		resamplingFilters[i].setTapCount(oscResamplingTaps);
+		resamplingFilters[i].setDriftTracking(oscAutoClockDrift);
 		resamplingFilters[i].reset(sampleRate);
 		resamplingFilters[i].setTargetSamplingRate(oscDeviceSampleRate);
 		resamplingFilters[i].setClockDrift(oscClockDrift);
@@ -227,19 +239,21 @@ int DeviceOutputInstance::postProcessSamples(float** samples, size_t numChannel,
 		return 0;
 
 	for(size_t i = 0; i < numChannel; i++) {
-		size_t dataSize;
-		resamplingFilters[i].processSamples(resampledBuffer, samples[i], nframes);
-
-		dataSize = resampledBuffer.size() * sizeof(resampledBuffer[0]);
+		if(oscAutoClockDrift)
+			resamplingFilters[i].setClockDrift(clockDriftController.getDrift());
+		resamplingFilters[i].processSamples(resampledBuffers[i], samples[i], nframes);
+		resampledBufferPointers[i] = resampledBuffers[i].data();
+	}
 
-		size_t availableData = jack_ringbuffer_write_space(ringBuffers[i].get());
+	// All filters have the same state so they output the same number of samples
+	size_t frameCount = resampledBuffers[0].size();
+	size_t availableSpace = ringBuffer.getWriteAvailable();
 
-		if(dataSize < availableData) {
-			jack_ringbuffer_write(ringBuffers[i].get(), (const char*) resampledBuffer.data(), dataSize);
-		} else {
-			overflowOccured = true;
-			overflowSize = availableData;
-		}
+	if(frameCount < availableSpace) {
+		ringBuffer.write(resampledBufferPointers.data(), frameCount);
+	} else {
+		overflowOccured = true;
+		overflowSize = availableSpace;
 	}
 
 	//	jack_nframes_t current_frames;
@@ -261,6 +275,10 @@ int DeviceOutputInstance::postProcessSamples(float** samples, size_t numChannel,
 	return 0;
 }
 
+int32_t DeviceOutputInstance::getBufferFill() {
+	return stream ? ringBuffer.getReadAvailable() : -1;
+}
+
 int DeviceOutputInstance::renderCallback(const void* input,
                                          void* output,
                                          unsigned long frameCount,
@@ -277,24 +295,26 @@ int DeviceOutputInstance::renderCallback(const void* input,
 	thisInstance->isPaRunning = true;
 	thisInstance->deviceSampleRateMeasure.notifySampleProcessed(frameCount);
 
-	for(size_t i = 0; i < thisInstance->ringBuffers.size(); i++) {
-		availableData = jack_ringbuffer_read_space(thisInstance->ringBuffers[i].get());
+	availableData = thisInstance->ringBuffer.getReadAvailable();
 
-		if(availableData >= frameCount * sizeof(outputBuffers[i][0])) {
-			jack_ringbuffer_read(
-			    thisInstance->ringBuffers[i].get(), (char*) outputBuffers[i], frameCount * sizeof(outputBuffers[i][0]));
-		} else {
+	if(availableData >= frameCount) {
+		thisInstance->ringBuffer.read(outputBuffers, frameCount);
+	} else {
+		for(size_t i = 0; i < thisInstance->ringBuffer.getNumChannel(); i++) {
 			memset(reinterpret_cast<char*>(outputBuffers[i]), 0, frameCount * sizeof(outputBuffers[i][0]));
-			underflowOccured = true;
-			thisInstance->underflowSize = availableData;
 		}
+		underflowOccured = true;
+		thisInstance->underflowSize = availableData;
 	}
 
+	if(thisInstance->oscAutoClockDrift)
+		thisInstance->clockDriftController.update(availableData, frameCount);
+
 	if(underflowOccured) {
 		thisInstance->underflowOccured = true;
 		thisInstance->bufferLatencyHistory.clear();
 	} else if(availableData) {
-		thisInstance->bufferLatencyHistory.push_back(availableData / sizeof(jack_default_audio_sample_t));
+		thisInstance->bufferLatencyHistory.push_back(availableData);
 
 		if(thisInstance->bufferLatencyHistory.size() == thisInstance->bufferLatencyMeasurePeriodSize) {
 			double averageLatency = 0;
@@ -350,5 +370,8 @@ void DeviceOutputInstance::onSlowTimer() {
 		oscIsRunning = true;
 	}
 
+	if(oscAutoClockDrift && oscIsRunning)
+		oscMeasuredClockDrift = clockDriftController.getDrift() * 1000000.0f;
+
 	deviceSampleRateMeasure.onTimeoutTimer();
 }
@@ -3,13 +3,14 @@
 #include "IAudioEndpoint.h"
 #include <stdint.h>
 // Need to be after else stdint might conflict
+#include "ClockDriftController.h"
+#include "MultiChannelRingBuffer.h"
 #include "ResamplingFilter.h"
 #include "SampleRateMeasure.h"
 #include <Osc/OscContainer.h>
 #include <Osc/OscVariable.h>
 #include <atomic>
 #include <jack/jack.h>
-#include <jack/ringbuffer.h>
 #include <memory.h>
 #include <vector>
 
@@ -30,6 +31,7 @@ public:
 	virtual void onSlowTimer() override;
 
 	virtual int postProcessSamples(float** samples, size_t numChannel, uint32_t nframes) override;
+	virtual int32_t getBufferFill() override;
 
 protected:
 	static int renderCallback(const void* input,
@@ -41,18 +43,22 @@ protected:
 
 private:
 	PaStream* stream = nullptr;
-	std::vector<std::unique_ptr<jack_ringbuffer_t, void (*)(jack_ringbuffer_t*)>> ringBuffers;
+	MultiChannelRingBuffer ringBuffer;
 	std::vector<ResamplingFilter> resamplingFilters;
-	std::vector<float> resampledBuffer;
+	std::vector<std::vector<float>> resampledBuffers;
+	std::vector<const float*> resampledBufferPointers;
 	bool overflowOccured = false;
 	bool underflowOccured = false;
 
 	OscVariable<std::string> oscDeviceName;
 	OscVariable<float> oscClockDrift;
 	OscReadOnlyVariable<float> oscMeasuredClockDrift;
+	OscVariable<bool> oscAutoClockDrift;
+	OscVariable<int32_t> oscTargetBufferFill;
 	OscVariable<int32_t> oscBufferSize;
 	OscReadOnlyVariable<int32_t> oscActualBufferSize;
 	OscVariable<int32_t> oscDeviceSampleRate;
+	OscVariable<int32_t> oscResamplingTaps;
 #ifdef _WIN32
 	OscVariable<bool> oscExclusiveMode;
 #endif
@@ -70,4 +76,5 @@ private:
 	size_t underflowSize = 0;
 	size_t overflowSize = 0;
 	SampleRateMeasure deviceSampleRateMeasure;
+	ClockDriftController clockDriftController;
 };
@@ -15,6 +15,9 @@ public:
 	virtual void onSlowTimer() {}
 
 	virtual int postProcessSamples(float** samples, size_t numChannel, uint32_t nframes) = 0;
+	// Frames buffered between JACK and the device or the network, -1 if the endpoint has no buffer.
+	// Called from the audio thread after postProcessSamples.
+	virtual int32_t getBufferFill() { return -1; }
 
 	Direction direction = D_Output;
 };
@@ -0,0 +1,325 @@
+#include "JitterBuffer.h"
+#include <algorithm>
+#include <math.h>
+
+void JitterBuffer::reset(size_t numChannel) {
+	this->numChannel = numChannel;
+
+	slots.reset(new Slot[SLOT_COUNT]);
+	for(size_t i = 0; i < SLOT_COUNT; i++)
+		slots[i].data.reset(new float[numChannel * MAX_PACKET_FRAMES]);
+	currentPacket.reset(new float[numChannel * MAX_PACKET_FRAMES]());
+	nextPacket.reset(new float[numChannel * MAX_PACKET_FRAMES]());
+
+	syncPoint = makeTag(0, 0);
+	highestReceived = INVALID_TAG;
+	packetFrames = 0;
+	jitterFrames = 0;
+	jitterNs = 0;
+	playoutPosition = makeTag(0, 0);
+	targetFrames = 0;
+
+	lostPackets = 0;
+	latePackets = 0;
+	reorderedPackets = 0;
+	duplicatedPackets = 0;
+	underflows = 0;
+
+	producerGeneration = 0;
+	synchronized = false;
+	lastSequence = 0;
+	lastFrameCount = 0;
+	lastArrivalTimeNs = 0;
+	nsPerFrame = 0;
+	jitterPeakNs = 0;
+
+	consumerGeneration = 0;
+	nextSequence = 0;
+	prebuffering = true;
+	fadeInPending = false;
+	latencyAdjustment = KeepLatency;
+	playingTarget = 0;
+	concealedPackets = 0;
+	currentFrameCount = 0;
+	currentOffset = 0;
+}
+
+void JitterBuffer::writePacket(uint32_t sequence,
+                               const float* const* samples,
+                               size_t frameCount,
+                               uint64_t arrivalTimeNs,
+                               uint32_t nominalSampleRate) {
+	if(frameCount == 0 || frameCount > MAX_PACKET_FRAMES)
+		return;
+
+	if(nsPerFrame == 0)
+		nsPerFrame = 1e9 / (nominalSampleRate ? nominalSampleRate : 48000);
+
+	// Before the consumer applied the last resynchronization, its position is still in the previous generation
+	uint64_t position = playoutPosition.load(std::memory_order_acquire);
+	if(getGeneration(position) != producerGeneration)
+		position = syncPoint.load(std::memory_order_relaxed);
+	uint32_t base = getSequence(position);
+	int32_t offset = (int32_t) (sequence - base);
+	Slot& slot = slots[sequence % SLOT_COUNT];
+
+	if(!synchronized || offset >= (int32_t) SLOT_COUNT || offset <= -(int32_t) SLOT_COUNT) {
+		resynchronize(sequence);
+	} else if(slot.tag.load(std::memory_order_relaxed) == makeTag(producerGeneration, sequence)) {
+		duplicatedPackets.fetch_add(1, std::memory_order_relaxed);
+		return;
+	} else if((int32_t) (sequence - lastSequence) < 0) {
+		reorderedPackets.fetch_add(1, std::memory_order_relaxed);
+		updateJitter(sequence, frameCount, arrivalTimeNs);
+		if(offset < 0) {
+			latePackets.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+
+	// Invalidated while writing so the consumer can detect an overwrite while it copies the slot
+	slot.tag.store(INVALID_TAG, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.frameCount = frameCount;
+	for(size_t channel = 0; channel < numChannel; channel++)
+		std::copy_n(samples[channel], frameCount, slot.data.get() + channel * MAX_PACKET_FRAMES);
+
+	slot.tag.store(makeTag(producerGeneration, sequence), std::memory_order_release);
+
+	if((int32_t) (sequence - lastSequence) >= 0) {
+		updateJitter(sequence, frameCount, arrivalTimeNs);
+		packetFrames.store(frameCount, std::memory_order_relaxed);
+		highestReceived.store(makeTag(producerGeneration, sequence), std::memory_order_release);
+	}
+}
+
+void JitterBuffer::resynchronize(uint32_t sequence) {
+	producerGeneration++;
+	synchronized = true;
+	lastSequence = sequence;
+	lastArrivalTimeNs = 0;
+
+	syncPoint.store(makeTag(producerGeneration, sequence), std::memory_order_release);
+}
+
+void JitterBuffer::updateJitter(uint32_t sequence, size_t frameCount, uint64_t arrivalTimeNs) {
+	// Negative for reordered packets, which are then compared to where they should be before the last one
+	int32_t packetCount = (int32_t) (sequence - lastSequence);
+
+	if(lastArrivalTimeNs != 0 && packetCount != 0) {
+		double elapsedNs = (double) arrivalTimeNs - (double) lastArrivalTimeNs;
+		double elapsedFrames = (double) packetCount * lastFrameCount;
+
+		// Long term average, follows the real sample rate of the sender
+		if(packetCount > 0 && elapsedNs > 0)
+			nsPerFrame += (elapsedNs / elapsedFrames - nsPerFrame) / 1024;
+
+		double deviationNs = fabs(elapsedNs - elapsedFrames * nsPerFrame);
+		double decay = std::min(std::max(elapsedNs, 0.0) / JITTER_DECAY_NS, 1.0);
+		jitterPeakNs = std::max(deviationNs, jitterPeakNs * (1 - decay));
+
+		jitterNs.store(jitterPeakNs, std::memory_order_relaxed);
+		jitterFrames.store(jitterPeakNs / nsPerFrame, std::memory_order_relaxed);
+	}
+
+	if(packetCount >= 0) {
+		lastSequence = sequence;
+		lastFrameCount = frameCount;
+		lastArrivalTimeNs = arrivalTimeNs;
+	}
+}
+
+void JitterBuffer::read(float* const* samples, size_t frameCount) {
+	uint64_t sync = syncPoint.load(std::memory_order_acquire);
+	if(getGeneration(sync) != consumerGeneration) {
+		consumerGeneration = getGeneration(sync);
+		nextSequence = getSequence(sync);
+		prebuffering = true;
+	}
+
+	updateTargetFrames(frameCount);
+
+	// Applied on the next packet, compared to the target used when starting to play as the level varies with jitter
+	if(!prebuffering) {
+		size_t bufferedFrames = getBufferedFrames();
+		size_t target = targetFrames.load(std::memory_order_relaxed);
+		size_t packetSize = packetFrames.load(std::memory_order_relaxed);
+
+		if(target > playingTarget + packetSize)
+			latencyAdjustment = IncreaseLatency;
+		else if(bufferedFrames > target + packetSize &&
+		        (bufferedFrames > 2 * target || playingTarget > target + packetSize))
+			latencyAdjustment = DecreaseLatency;
+		else
+			latencyAdjustment = KeepLatency;
+	}
+
+	for(size_t done = 0; done < frameCount;) {
+		if(currentOffset == currentFrameCount && !loadNextPacket()) {
+			for(size_t channel = 0; channel < numChannel; channel++)
+				std::fill(samples[channel] + done, samples[channel] + frameCount, 0.0f);
+			break;
+		}
+
+		size_t count = std::min(frameCount - done, currentFrameCount - currentOffset);
+		for(size_t channel = 0; channel < numChannel; channel++) {
+			const float* source = currentPacket.get() + channel * MAX_PACKET_FRAMES + currentOffset;
+			std::copy_n(source, count, samples[channel] + done);
+		}
+
+		currentOffset += count;
+		done += count;
+	}
+
+	playoutPosition.store(makeTag(consumerGeneration, nextSequence), std::memory_order_release);
+}
+
+bool JitterBuffer::loadNextPacket() {
+	if(prebuffering) {
+		if(getBufferedFrames() < targetFrames.load(std::memory_order_relaxed))
+			return false;
+		prebuffering = false;
+		fadeInPending = true;
+		latencyAdjustment = KeepLatency;
+		playingTarget = targetFrames.load(std::memory_order_relaxed);
+	}
+
+	// The target increased, wait for it to be reached again
+	Slot& slot = slots[nextSequence % SLOT_COUNT];
+	bool available = slot.tag.load(std::memory_order_relaxed) == makeTag(consumerGeneration, nextSequence);
+	if(latencyAdjustment == IncreaseLatency && available) {
+		latencyAdjustment = KeepLatency;
+		prebuffering = true;
+		concealPacket();
+		return true;
+	}
+
+	size_t frameCount;
+	if(copySlot(nextSequence, currentPacket.get(), &frameCount)) {
+		nextSequence++;
+		currentFrameCount = frameCount;
+		currentOffset = 0;
+		concealedPackets = 0;
+
+		// Play this packet and the next one crossfaded in the time of one packet
+		size_t nextFrameCount;
+		if(latencyAdjustment == DecreaseLatency && copySlot(nextSequence, nextPacket.get(), &nextFrameCount) &&
+		   nextFrameCount == frameCount) {
+			latencyAdjustment = KeepLatency;
+			playingTarget -= std::min(playingTarget, frameCount);
+			for(size_t channel = 0; channel < numChannel; channel++) {
+				float* current = currentPacket.get() + channel * MAX_PACKET_FRAMES;
+				const float* next = nextPacket.get() + channel * MAX_PACKET_FRAMES;
+				for(size_t i = 0; i < frameCount; i++) {
+					float weight = (i + 0.5f) / frameCount;
+					current[i] = current[i] * (1 - weight) + next[i] * weight;
+				}
+			}
+			nextSequence++;
+		}
+
+		if(fadeInPending) {
+			size_t fadeFrames = std::min(FADE_FRAMES, frameCount);
+			for(size_t channel = 0; channel < numChannel; channel++) {
+				float* current = currentPacket.get() + channel * MAX_PACKET_FRAMES;
+				for(size_t i = 0; i < fadeFrames; i++)
+					current[i] *= (i + 0.5f) / fadeFrames;
+			}
+			fadeInPending = false;
+		}
+
+		return true;
+	}
+
+	// Missing packet, when later ones were received it won't be played in time
+	uint64_t highest = highestReceived.load(std::memory_order_acquire);
+	if(getGeneration(highest) == consumerGeneration && (int32_t) (getSequence(highest) - nextSequence) > 0) {
+		lostPackets.fetch_add(1, std::memory_order_relaxed);
+		nextSequence++;
+	} else {
+		underflows.fetch_add(1, std::memory_order_relaxed);
+		prebuffering = true;
+	}
+
+	concealPacket();
+
+	return true;
+}
+
+bool JitterBuffer::copySlot(uint32_t sequence, float* destination, size_t* frameCount) {
+	Slot& slot = slots[sequence % SLOT_COUNT];
+	uint64_t tag = makeTag(consumerGeneration, sequence);
+
+	if(slot.tag.load(std::memory_order_acquire) != tag)
+		return false;
+
+	size_t count = std::min(slot.frameCount, MAX_PACKET_FRAMES);
+	for(size_t channel = 0; channel < numChannel; channel++)
+		std::copy_n(slot.data.get() + channel * MAX_PACKET_FRAMES, count, destination + channel * MAX_PACKET_FRAMES);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if(slot.tag.load(std::memory_order_relaxed) != tag)
+		return false;
+
+	*frameCount = count;
+	return true;
+}
+
+void JitterBuffer::concealPacket() {
+	// Same duration as the previous packet, the first concealed packet repeats it with a fade out
+	if(currentFrameCount == 0)
+		currentFrameCount = FADE_FRAMES;
+
+	for(size_t channel = 0; channel < numChannel; channel++) {
+		float* current = currentPacket.get() + channel * MAX_PACKET_FRAMES;
+
+		if(concealedPackets == 0) {
+			for(size_t i = 0; i < currentFrameCount; i++)
+				current[i] *= 1 - (i + 0.5f) / currentFrameCount;
+		} else {
+			std::fill_n(current, currentFrameCount, 0.0f);
+		}
+	}
+
+	concealedPackets++;
+	fadeInPending = true;
+	currentOffset = 0;
+}
+
+size_t JitterBuffer::getBufferedFrames() const {
+	size_t frames = currentFrameCount - currentOffset;
+
+	uint64_t highest = highestReceived.load(std::memory_order_acquire);
+	if(getGeneration(highest) == consumerGeneration) {
+		int32_t packetCount = (int32_t) (getSequence(highest) - nextSequence) + 1;
+		if(packetCount > 0)
+			frames += packetCount * packetFrames.load(std::memory_order_relaxed);
+	}
+
+	return frames;
+}
+
+void JitterBuffer::updateTargetFrames(size_t readSize) {
+	// One read, one packet as data arrives by packets and the jitter with some margin
+	size_t packetSize = std::max<size_t>(packetFrames.load(std::memory_order_relaxed), 1);
+	size_t target = readSize + packetSize + jitterFrames.load(std::memory_order_relaxed) * 3 / 2;
+
+	targetFrames.store(std::min(target, SLOT_COUNT / 2 * packetSize), std::memory_order_relaxed);
+}
+
+JitterBuffer::Statistics JitterBuffer::getStatistics() const {
+	Statistics statistics;
+
+	statistics.lostPackets = lostPackets.load(std::memory_order_relaxed);
+	statistics.latePackets = latePackets.load(std::memory_order_relaxed);
+	statistics.reorderedPackets = reorderedPackets.load(std::memory_order_relaxed);
+	statistics.duplicatedPackets = duplicatedPackets.load(std::memory_order_relaxed);
+	statistics.underflows = underflows.load(std::memory_order_relaxed);
+
+	return statistics;
+}
+
+double JitterBuffer::getJitterSeconds() const {
+	return jitterNs.load(std::memory_order_relaxed) / 1e9;
+}
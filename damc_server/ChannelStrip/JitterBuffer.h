@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Jitter buffer of a network audio stream, between the receive thread (producer) and the JACK thread (consumer).
+ *
+ * Packets are stored in a slot indexed by their sequence number, so they are played in sequence order whatever their
+ * arrival order. Duplicates are dropped, packets arriving after their playout time are counted as late and dropped.
+ * When the next packet is missing but later ones were received, it is considered lost and concealed by repeating the
+ * previous packet with a fade out, longer gaps are filled with silence. When nothing is buffered anymore, the consumer
+ * waits again for the target depth before resuming with a fade in.
+ *
+ * The target depth follows the arrival jitter: the deviation of packet arrival times from their nominal spacing is
+ * tracked with a peak hold decaying over about 10 s. When the target increases, the playout pauses until the new
+ * target is reached. When it decreases or the buffer holds twice the target, for example when the sender clock is
+ * faster, a packet is crossfaded with the next one to reduce the latency.
+ *
+ * The producer resynchronizes the buffer when the sequence jumps outside of the slots window (sender restart).
+ * reset() is not thread safe and must be called while neither side is running.
+ */
+class JitterBuffer {
+public:
+	static constexpr size_t MAX_PACKET_FRAMES = 256;
+
+	struct Statistics {
+		uint32_t lostPackets;
+		uint32_t latePackets;
+		uint32_t reorderedPackets;
+		uint32_t duplicatedPackets;
+		uint32_t underflows;
+	};
+
+	void reset(size_t numChannel);
+
+	// Producer thread, frameCount must not be more than MAX_PACKET_FRAMES
+	// nominalSampleRate is used as the initial estimation of the packet spacing and can be 0 when unknown
+	void writePacket(uint32_t sequence,
+	                 const float* const* samples,
+	                 size_t frameCount,
+	                 uint64_t arrivalTimeNs,
+	                 uint32_t nominalSampleRate);
+
+	// Consumer thread, always write frameCount frames, missing data is concealed
+	void read(float* const* samples, size_t frameCount);
+	size_t getBufferedFrames() const;
+
+	// Any thread
+	Statistics getStatistics() const;
+	uint32_t getTargetFrames() const { return targetFrames.load(std::memory_order_relaxed); }
+	double getJitterSeconds() const;
+
+protected:
+	static constexpr size_t SLOT_COUNT = 256;
+	static constexpr size_t FADE_FRAMES = 64;
+	static constexpr uint64_t INVALID_TAG = UINT64_MAX;
+	static constexpr double JITTER_DECAY_NS = 10e9;
+
+	enum LatencyAdjustment { KeepLatency, IncreaseLatency, DecreaseLatency };
+
+	struct Slot {
+		std::atomic<uint64_t> tag{INVALID_TAG};  // Generation and sequence of the stored packet
+		size_t frameCount = 0;
+		std::unique_ptr<float[]> data;
+	};
+
+	static uint64_t makeTag(uint32_t generation, uint32_t sequence) { return (uint64_t) generation << 32 | sequence; }
+	static uint32_t getGeneration(uint64_t tag) { return tag >> 32; }
+	static uint32_t getSequence(uint64_t tag) { return (uint32_t) tag; }
+
+	void resynchronize(uint32_t sequence);
+	void updateJitter(uint32_t sequence, size_t frameCount, uint64_t arrivalTimeNs);
+
+	bool loadNextPacket();
+	bool copySlot(uint32_t sequence, float* destination, size_t* frameCount);
+	void concealPacket();
+	void updateTargetFrames(size_t readSize);
+
+private:
+	size_t numChannel = 0;
+	std::unique_ptr<Slot[]> slots;
+
+	// Written by the producer only
+	std::atomic<uint64_t> syncPoint{0};        // Generation and first sequence to play
+	std::atomic<uint64_t> highestReceived{0};  // Generation and highest sequence received
+	std::atomic<uint32_t> packetFrames{0};     // Frames of the last packet
+	std::atomic<uint32_t> jitterFrames{0};
+	std::atomic<double> jitterNs{0};
+
+	// Written by the consumer only
+	std::atomic<uint64_t> playoutPosition{0};  // Generation and next sequence to play
+	std::atomic<uint32_t> targetFrames{0};
+
+	std::atomic<uint32_t> lostPackets{0};
+	std::atomic<uint32_t> latePackets{0};
+	std::atomic<uint32_t> reorderedPackets{0};
+	std::atomic<uint32_t> duplicatedPackets{0};
+	std::atomic<uint32_t> underflows{0};
+
+	// Producer state
+	uint32_t producerGeneration = 0;
+	bool synchronized = false;
+	uint32_t lastSequence = 0;
+	size_t lastFrameCount = 0;
+	uint64_t lastArrivalTimeNs = 0;
+	double nsPerFrame = 0;
+	double jitterPeakNs = 0;
+
+	// Consumer state, the current packet is copied out of its slot when it starts playing
+	uint32_t consumerGeneration = 0;
+	uint32_t nextSequence = 0;
+	bool prebuffering = true;
+	bool fadeInPending = false;
+	LatencyAdjustment latencyAdjustment = KeepLatency;
+	size_t playingTarget = 0;  // Target when the playout started
+	size_t concealedPackets = 0;  // Consecutive
+	std::unique_ptr<float[]> currentPacket;
+	std::unique_ptr<float[]> nextPacket;  // For crossfades
+	size_t currentFrameCount = 0;
+	size_t currentOffset = 0;
+};
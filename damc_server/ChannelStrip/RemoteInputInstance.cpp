@@ -1,13 +1,29 @@
 #include "RemoteInputInstance.h"
+#include <algorithm>
 
 void RemoteInputInstance::stop() {
 	remoteUdpInput.stop();
 }
 
 void RemoteInputInstance::onSlowTimer() {
-	if(oscAddVbanHeader && vbanSampleRate != 0)
-		oscDeviceSampleRate = vbanSampleRate;
+	// The resampling filters are updated by the main thread, on the sample rate change callback
+	if(oscAddVbanHeader) {
+		int32_t vbanSampleRate = remoteUdpInput.getSampleRate();
+		if(vbanSampleRate != 0)
+			oscDeviceSampleRate = vbanSampleRate;
+	}
 	remoteUdpInput.onSlowTimer();
+
+	// Counted since the stream start
+	const JitterBuffer& jitterBuffer = remoteUdpInput.getJitterBuffer();
+	JitterBuffer::Statistics statistics = jitterBuffer.getStatistics();
+	oscPacketLossCount = statistics.lostPackets;
+	oscPacketLateCount = statistics.latePackets;
+	oscPacketReorderCount = statistics.reorderedPackets;
+	oscPacketDuplicateCount = statistics.duplicatedPackets;
+	oscUnderflowCount = statistics.underflows;
+	oscJitterBufferTarget = jitterBuffer.getTargetFrames();
+	oscMeasuredJitter = jitterBuffer.getJitterSeconds() * 1000;
 }
 
 RemoteInputInstance::RemoteInputInstance(OscContainer* parent)
@@ -16,12 +32,22 @@ RemoteInputInstance::RemoteInputInstance(OscContainer* parent)
       oscIp(this, "ip", "127.0.0.1"),
       oscPort(this, "port", 2305),
       oscDeviceSampleRate(this, "deviceSampleRate", 48000),
+      oscResamplingTaps(this, "resamplingTaps", 64),
       oscClockDrift(this, "clockDrift", 0.0f),
-      oscAddVbanHeader(this, "vbanFormat") {
+      oscAddVbanHeader(this, "vbanFormat"),
+      oscPacketLossCount(this, "packetLossCount", 0),
+      oscPacketLateCount(this, "packetLateCount", 0),
+      oscPacketReorderCount(this, "packetReorderCount", 0),
+      oscPacketDuplicateCount(this, "packetDuplicateCount", 0),
+      oscUnderflowCount(this, "underflowCount", 0),
+      oscJitterBufferTarget(this, "jitterBufferTarget", 0),
+      oscMeasuredJitter(this, "measuredJitter", 0.0f) {
 	direction = D_Input;
 
 	oscIp.addCheckCallback([this](auto) { return !remoteUdpInput.isStarted(); });
 	oscPort.addCheckCallback([this](auto) { return !remoteUdpInput.isStarted(); });
+	oscResamplingTaps.addCheckCallback(
+	    [this](int newValue) { return !remoteUdpInput.isStarted() && ResamplingFilter::isValidTapCount(newValue); });
 	oscDeviceSampleRate.addCheckCallback([](int newValue) { return newValue > 0; });
 
 	oscClockDrift.addChangeCallback([this](float newValue) {
@@ -33,12 +59,7 @@ RemoteInputInstance::RemoteInputInstance(OscContainer* parent)
 	oscDeviceSampleRate.addChangeCallback([this](int32_t newValue) {
 		for(auto& resamplingFilter : resamplingFilters) {
 			resamplingFilter.setSourceSamplingRate(newValue);
-		}
-	});
-
-	oscAddVbanHeader.addChangeCallback([this](bool newValue) {
-		if(!newValue) {
-			vbanSampleRate = 0;
+			resamplingFilter.setClockDrift(oscClockDrift);
 		}
 	});
 }
@@ -52,14 +73,13 @@ const char* RemoteInputInstance::getName() {
 }
 
 int RemoteInputInstance::start(int index, size_t numChannel, int sampleRate, int jackBufferSize) {
-	this->jackSampleRate = sampleRate;
-	this->vbanSampleRate = 0;
 	resamplingFilters.resize(2);
 	resampledBuffer[0].resize(sampleRate);
 	resampledBuffer[1].resize(sampleRate);
 	inBuffers[0].reserve(sampleRate);
 	inBuffers[1].reserve(sampleRate);
 	for(ResamplingFilter& resamplingFilter : resamplingFilters) {
+		resamplingFilter.setTapCount(oscResamplingTaps);
 		resamplingFilter.reset(oscDeviceSampleRate);
 		resamplingFilter.setTargetSamplingRate(sampleRate);
 		resamplingFilter.setClockDrift(this->oscClockDrift);
@@ -68,27 +88,20 @@ int RemoteInputInstance::start(int index, size_t numChannel, int sampleRate, int
 }
 
 int RemoteInputInstance::postProcessSamples(float** samples, size_t numChannel, jack_nframes_t nframes) {
-	if(oscAddVbanHeader) {
-		int32_t inputSampleRate = remoteUdpInput.getSampleRate();
-
-		if(inputSampleRate != 0 && inputSampleRate != vbanSampleRate) {
-			vbanSampleRate = inputSampleRate;
-			for(ResamplingFilter& resamplingFilter : resamplingFilters) {
-				resamplingFilter.setSourceSamplingRate(vbanSampleRate);
-				resamplingFilter.setTargetSamplingRate(jackSampleRate);
-				resamplingFilter.setClockDrift(this->oscClockDrift);
-			}
-		}
-	}
+	for(ResamplingFilter& resamplingFilter : resamplingFilters)
+		resamplingFilter.updateParameters();
 
-	size_t readSize =
-	    remoteUdpInput.receivePacket(resampledBuffer[0].data(), resampledBuffer[1].data(), resampledBuffer[0].size());
+	// Only what is needed for this period, the jitter buffer keeps the latency around its target
+	size_t missingFrames = nframes > inBuffers[0].size() ? nframes - inBuffers[0].size() : 0;
+	size_t readSize = std::min(resamplingFilters[0].getRequiredInputSize(missingFrames), resampledBuffer[0].size());
+	remoteUdpInput.readSamples(resampledBuffer[0].data(), resampledBuffer[1].data(), readSize);
 
 	for(size_t i = 0; i < resamplingFilters.size(); i++) {
-		for(size_t j = 0; j < readSize; j++) {
-			resamplingFilters[i].put(resampledBuffer[i][j]);
-			resamplingFilters[i].get(inBuffers[i], resamplingFilters[i].getDownSamplingRatio());
-		}
+		size_t previousSize = inBuffers[i].size();
+		inBuffers[i].resize(previousSize + resamplingFilters[i].getMaxRequiredOutputSize(readSize));
+		size_t outputSize =
+		    resamplingFilters[i].processSamples(inBuffers[i].data() + previousSize, resampledBuffer[i].data(), readSize);
+		inBuffers[i].resize(previousSize + outputSize);
 	}
 
 	if(numChannel == 1) {
@@ -115,3 +128,8 @@ int RemoteInputInstance::postProcessSamples(float** samples, size_t numChannel,
 
 	return 0;
 }
+
+int32_t RemoteInputInstance::getBufferFill() {
+	// Frames received but not output yet, before and after resampling
+	return remoteUdpInput.getBufferFill() + inBuffers[0].size();
+}
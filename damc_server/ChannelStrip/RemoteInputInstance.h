@@ -2,6 +2,7 @@
 
 #include "IAudioEndpoint.h"
 #include <Osc/OscContainer.h>
+#include <Osc/OscReadOnlyVariable.h>
 #include <Osc/OscVariable.h>
 #include <stdint.h>
 // Need to be after else stdint might conflict
@@ -21,18 +22,26 @@ public:
 	virtual void onSlowTimer() override;
 
 	virtual int postProcessSamples(float** samples, size_t numChannel, uint32_t nframes) override;
+	virtual int32_t getBufferFill() override;
 
 private:
 	RemoteUdpInput remoteUdpInput;
-	double jackSampleRate;
 	std::vector<float> resampledBuffer[2];
 	std::vector<float> inBuffers[2];
 	std::vector<ResamplingFilter> resamplingFilters;
-	int32_t vbanSampleRate;
 
 	OscVariable<std::string> oscIp;
 	OscVariable<int> oscPort;
 	OscVariable<int32_t> oscDeviceSampleRate;
+	OscVariable<int32_t> oscResamplingTaps;
 	OscVariable<float> oscClockDrift;
 	OscVariable<bool> oscAddVbanHeader;
+
+	OscReadOnlyVariable<int32_t> oscPacketLossCount;
+	OscReadOnlyVariable<int32_t> oscPacketLateCount;
+	OscReadOnlyVariable<int32_t> oscPacketReorderCount;
+	OscReadOnlyVariable<int32_t> oscPacketDuplicateCount;
+	OscReadOnlyVariable<int32_t> oscUnderflowCount;
+	OscReadOnlyVariable<int32_t> oscJitterBufferTarget;
+	OscReadOnlyVariable<float> oscMeasuredJitter;
 };
@@ -6,12 +6,17 @@ RemoteOutputInstance::RemoteOutputInstance(OscContainer* parent)
       oscIp(this, "ip", "127.0.0.1"),
       oscPort(this, "port", 2305),
       oscDeviceSampleRate(this, "deviceSampleRate", 48000),
+      oscResamplingTaps(this, "resamplingTaps", 64),
       oscClockDrift(this, "clockDrift", 0.0f),
-      oscAddVbanHeader(this, "vbanFormat") {
+      oscAddVbanHeader(this, "vbanFormat"),
+      oscPacedSend(this, "pacedSend", false) {
 	resamplingFilters.resize(2);
 
 	oscIp.addCheckCallback([this](auto) { return !remoteUdpOutput.isStarted(); });
 	oscPort.addCheckCallback([this](auto) { return !remoteUdpOutput.isStarted(); });
+	oscPacedSend.addCheckCallback([this](auto) { return !remoteUdpOutput.isStarted(); });
+	oscResamplingTaps.addCheckCallback(
+	    [this](int newValue) { return !remoteUdpOutput.isStarted() && ResamplingFilter::isValidTapCount(newValue); });
 	oscDeviceSampleRate.addCheckCallback([](int32_t newValue) { return newValue > 0; });
 
 	oscClockDrift.addChangeCallback([this](float newValue) {
@@ -39,11 +44,12 @@ int RemoteOutputInstance::start(int index, size_t numChannel, int sampleRate, in
 	outBuffers[0].resize(jackBufferSize);
 	outBuffers[1].resize(jackBufferSize);
 	for(ResamplingFilter& resamplingFilter : resamplingFilters) {
+		resamplingFilter.setTapCount(oscResamplingTaps);
 		resamplingFilter.reset(sampleRate);
 		resamplingFilter.setTargetSamplingRate(oscDeviceSampleRate);
 		resamplingFilter.setClockDrift(oscClockDrift);
 	}
-	return remoteUdpOutput.init(index, oscDeviceSampleRate, oscIp.c_str(), oscPort);
+	return remoteUdpOutput.init(index, oscDeviceSampleRate, oscIp.c_str(), oscPort, oscPacedSend);
 }
 
 void RemoteOutputInstance::stop() {
@@ -31,6 +31,8 @@ private:
 	OscVariable<std::string> oscIp;
 	OscVariable<int> oscPort;
 	OscVariable<int32_t> oscDeviceSampleRate;
+	OscVariable<int32_t> oscResamplingTaps;
 	OscVariable<float> oscClockDrift;
 	OscVariable<bool> oscAddVbanHeader;
+	OscVariable<bool> oscPacedSend;
 };
@@ -3,6 +3,7 @@
 #include <netinet/in.h>
 #endif
 #include "ChannelStrip.h"
+#include "UdpReceiveThread.h"
 #include <algorithm>
 #include <limits.h>
 #include <string.h>
@@ -10,6 +11,8 @@
 
 static long VBAN_SRList[] = {6000,   12000,  24000,  48000, 96000, 192000, 384000, 8000,   16000,  32000, 64000,
                              128000, 256000, 512000, 11025, 22050, 44100,  88200,  176400, 352800, 705600};
+#define VBAN_SR_MASK 0x1F
+#define VBAN_PROTOCOL_MASK 0xE0
 #define VBAN_PROTOCOL_AUDIO 0x00
 #define VBAN_PROTOCOL_SERIAL 0x20
 #define VBAN_PROTOCOL_TXT 0x40
@@ -27,22 +30,12 @@ static long VBAN_SRList[] = {6000,   12000,  24000,  48000, 96000, 192000, 38400
 #define VBAN_CODEC_PCM 0x00
 
 RemoteUdpInput::RemoteUdpInput(OscContainer* oscParent, const char* name)
-    : sampleRate(0), started(false), sampleRateMeasure(oscParent, name) {}
+    : rawSequence(0), sampleRate(0), started(false), receiving(false), sampleRateMeasure(oscParent, name) {}
 
 RemoteUdpInput::~RemoteUdpInput() {
 	stop();
 }
 
-static unsigned int highestPowerof2(unsigned int n) {
-	unsigned int res = 1;
-	while(res < INT_MAX) {
-		if(res <= n && res * 2 > n)
-			return res;
-		res *= 2;
-	}
-	return res;
-}
-
 int RemoteUdpInput::init(int index, const char* ip, int port) {
 	std::string streamName = ChannelStrip::JACK_CLIENT_NAME_PREFIX + std::to_string(index);
 	uint32_t targetIp = inet_addr(ip);
@@ -67,7 +60,8 @@ int RemoteUdpInput::init(int index, const char* ip, int port) {
 	uv_udp_init(uv_default_loop(), &udpSocket);
 	udpSocket.data = this;
 
-	sampleRing = jack_ringbuffer_create(highestPowerof2(48000));
+	jitterBuffer.reset(2);
+	rawSequence = 0;
 
 	int ret = uv_udp_bind(&udpSocket, (struct sockaddr*) &sin_server, 0);
 	if(ret < 0) {
@@ -83,11 +77,20 @@ int RemoteUdpInput::init(int index, const char* ip, int port) {
 		}
 	}
 
-	ret = uv_udp_recv_start(&udpSocket, &onAlloc, &onPacketReceived);
+	// Received on a dedicated thread, the main loop would delay packets while handling OSC or saving the config
+	uv_os_fd_t socket;
+	ret = uv_fileno((uv_handle_t*) &udpSocket, &socket);
+	if(ret < 0) {
+		SPDLOG_ERROR("Failed to get UDP socket on {}:{}: {} ({})", ip, port, uv_strerror(ret), ret);
+		return ret;
+	}
+
+	ret = UdpReceiveThread::addSocket((uv_os_sock_t) socket, &onPacketReceived, this);
 	if(ret < 0) {
-		SPDLOG_ERROR("Failed to reading UDP: {} ({})", uv_strerror(ret), ret);
+		SPDLOG_ERROR("Failed to receive UDP on {}:{}: {} ({})", ip, port, uv_strerror(ret), ret);
 		return ret;
 	}
+	receiving = true;
 
 	return 0;
 }
@@ -95,6 +98,12 @@ int RemoteUdpInput::init(int index, const char* ip, int port) {
 void RemoteUdpInput::stop() {
 	if(started) {
 		started = false;
+		if(receiving) {
+			uv_os_fd_t socket;
+			uv_fileno((uv_handle_t*) &udpSocket, &socket);
+			UdpReceiveThread::removeSocket((uv_os_sock_t) socket);
+			receiving = false;
+		}
 		uv_close((uv_handle_t*) &udpSocket, nullptr);
 	}
 }
@@ -107,71 +116,70 @@ void RemoteUdpInput::onSlowTimer() {
 	sampleRateMeasure.onTimeoutTimer();
 }
 
-void RemoteUdpInput::onAlloc(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) {
-	RemoteUdpInput* thisInstance = (RemoteUdpInput*) handle->data;
-	buf->base = (char*) &thisInstance->dataBuffer;
-	buf->len = sizeof(thisInstance->dataBuffer);
-}
-
-void RemoteUdpInput::onPacketReceived(
-    uv_udp_t* handle, ssize_t nread, const uv_buf_t* buf, const sockaddr* addr, unsigned flags) {
-	RemoteUdpInput* thisInstance = (RemoteUdpInput*) handle->data;
-	float buffer[16384];
+void RemoteUdpInput::onPacketReceived(void* arg, const uint8_t* data, size_t size) {
+	RemoteUdpInput* thisInstance = (RemoteUdpInput*) arg;
+	float samples[2][JitterBuffer::MAX_PACKET_FRAMES];
+	const float* channels[] = {samples[0], samples[1]};
+	uint64_t arrivalTime = uv_hrtime();
 	size_t sampleCount;
 	size_t channelCount;
 	const int16_t* inputSamples;
-	const size_t sampleSize = sizeof(float) * 2;
+	uint32_t sequence;
+	bool hasVbanHeader;
 
-	if(nread <= 0) {
-		SPDLOG_WARN("Bad udp read {}", nread);
+	if(size == 0)
 		return;
-	}
 
-	if(memcmp(&thisInstance->dataBuffer.header.vban, "VBAN", 4) == 0) {
-		channelCount = thisInstance->dataBuffer.header.format_nbc + 1;
-		sampleCount = (int) thisInstance->dataBuffer.header.format_nbs + 1;
-		thisInstance->sampleRate = VBAN_SRList[thisInstance->dataBuffer.header.format_SR];
-		inputSamples = thisInstance->dataBuffer.data;
+	if(size >= sizeof(VbanHeader) && memcmp(data, "VBAN", 4) == 0) {
+		const VbanHeader* header = (const VbanHeader*) data;
+		size_t sampleRateIndex = header->format_SR & VBAN_SR_MASK;
+
+		// Drop other protocols and invalid sample rates
+		if((header->format_SR & VBAN_PROTOCOL_MASK) != VBAN_PROTOCOL_AUDIO ||
+		   sampleRateIndex >= sizeof(VBAN_SRList) / sizeof(VBAN_SRList[0]))
+			return;
+
+		channelCount = header->format_nbc + 1;
+		sampleCount = (int) header->format_nbs + 1;
+		thisInstance->sampleRate = VBAN_SRList[sampleRateIndex];
+		inputSamples = (const int16_t*) (data + sizeof(VbanHeader));
+		sequence = header->nuFrame;
+		hasVbanHeader = true;
+		size -= sizeof(VbanHeader);
 	} else {
 		channelCount = 2;
-		sampleCount = nread / sizeof(int16_t) / channelCount;
+		sampleCount = size / sizeof(int16_t) / channelCount;
 		thisInstance->sampleRate = 0;
-		inputSamples = (int16_t*) &thisInstance->dataBuffer;
-	}
-
-	for(size_t i = 0; i < sampleCount; i++) {
-		buffer[i * 2] = inputSamples[i * channelCount] / 32768.0;
-		buffer[i * 2 + 1] = inputSamples[i * channelCount + 1] / 32768.0;
+		inputSamples = (const int16_t*) data;
+		sequence = thisInstance->rawSequence;
+		hasVbanHeader = false;
 	}
 
-	sampleCount = std::min(sampleCount, jack_ringbuffer_write_space(thisInstance->sampleRing) / sampleSize);
-
-	if(sampleCount > 0)
-		jack_ringbuffer_write(thisInstance->sampleRing, (const char*) buffer, sampleCount * sampleSize);
+	// Packets are received in a buffer of their size, don't read past it when the header doesn't match the data
+	size_t receivedSamples = size / sizeof(int16_t);
+	sampleCount = std::min(sampleCount, receivedSamples >= 2 ? (receivedSamples - 2) / channelCount + 1 : 0);
 
 	thisInstance->sampleRateMeasure.notifySampleProcessed(sampleCount);
-}
 
-size_t RemoteUdpInput::receivePacket(float* samplesLeft, float* samplesRight, size_t maxSamples) {
-	float buffer[16384];
-	size_t sampleRead;
-	size_t sizeToRead;
-	const size_t sampleSize = sizeof(samplesLeft[0]) * 2;
+	// VBAN packets have at most 256 samples, raw packets are split so each part has its own sequence number
+	for(size_t offset = 0; offset < sampleCount; offset += JitterBuffer::MAX_PACKET_FRAMES) {
+		size_t count = std::min(sampleCount - offset, JitterBuffer::MAX_PACKET_FRAMES);
+		const int16_t* packetSamples = inputSamples + offset * channelCount;
 
-	sizeToRead = maxSamples * sampleSize;
-	if(sizeToRead > sizeof(buffer))
-		sizeToRead = sizeof(buffer);
+		for(size_t i = 0; i < count; i++) {
+			samples[0][i] = packetSamples[i * channelCount] / 32768.0;
+			samples[1][i] = packetSamples[i * channelCount + 1] / 32768.0;
+		}
 
-	// Ensure multiple of sampleSize
-	sizeToRead = std::min(sizeToRead, jack_ringbuffer_read_space(sampleRing) / sampleSize * sampleSize);
+		thisInstance->jitterBuffer.writePacket(sequence++, channels, count, arrivalTime, thisInstance->sampleRate);
+	}
 
-	sampleRead = jack_ringbuffer_read(sampleRing, (char*) buffer, sizeToRead);
-	sampleRead /= sampleSize;
+	if(!hasVbanHeader)
+		thisInstance->rawSequence = sequence;
+}
 
-	for(size_t i = 0; i < sampleRead; i++) {
-		samplesLeft[i] = buffer[i * 2];
-		samplesRight[i] = buffer[i * 2 + 1];
-	}
+void RemoteUdpInput::readSamples(float* samplesLeft, float* samplesRight, size_t count) {
+	float* channels[] = {samplesLeft, samplesRight};
 
-	return sampleRead;
+	jitterBuffer.read(channels, count);
 }
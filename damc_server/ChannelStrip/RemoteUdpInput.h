@@ -1,8 +1,8 @@
 #pragma once
 
+#include "JitterBuffer.h"
 #include "SampleRateMeasure.h"
 #include <atomic>
-#include <jack/ringbuffer.h>
 #include <uv.h>
 
 class RemoteUdpInput {
@@ -15,13 +15,15 @@ public:
 	bool isStarted();
 	void onSlowTimer();
 
-	size_t receivePacket(float* samplesLeft, float* samplesRight, size_t maxSamples);
+	// JACK thread, missing samples are concealed by the jitter buffer
+	void readSamples(float* samplesLeft, float* samplesRight, size_t count);
+	size_t getBufferFill() const { return jitterBuffer.getBufferedFrames(); }
+	const JitterBuffer& getJitterBuffer() const { return jitterBuffer; }
 	int getSampleRate() { return sampleRate; }
 
 protected:
-	static void onAlloc(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf);
-	static void onPacketReceived(
-	    uv_udp_t* handle, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned flags);
+	// Called by UdpReceiveThread
+	static void onPacketReceived(void* arg, const uint8_t* data, size_t size);
 
 private:
 #pragma pack(push, 1)
@@ -34,18 +36,15 @@ private:
 		char streamname[16]; /* stream name */
 		uint32_t nuFrame;    /* growing frame number. */
 	};
-	struct VbanBuffer {
-		VbanHeader header;
-		int16_t data[65536];
-	};
 #pragma pack(pop)
 
 private:
-	VbanBuffer dataBuffer;
 	uv_udp_t udpSocket;
-	jack_ringbuffer_t* sampleRing;
+	JitterBuffer jitterBuffer;
+	uint32_t rawSequence;  // Packets without VBAN header have no frame counter
 	std::atomic<int> sampleRate;
 	bool started;
+	bool receiving;  // Socket registered to UdpReceiveThread
 
 	SampleRateMeasure sampleRateMeasure;
 };
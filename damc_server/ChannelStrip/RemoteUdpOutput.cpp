@@ -5,9 +5,13 @@
 #else
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <sys/socket.h>
 #include <unistd.h>
 #endif
 #include "ChannelStrip.h"
+#include <RealtimeThread.h>
+#include <algorithm>
+#include <chrono>
 #include <string.h>
 #include <string>
 
@@ -30,13 +34,22 @@ static uint32_t VBAN_SRList[] = {6000,   12000,  24000,  48000, 96000, 192000, 3
 #define VBAN_CODEC_PCM 0x00
 
 RemoteUdpOutput::RemoteUdpOutput(OscContainer* oscParent, const char* name)
-    : started(false), sampleRateMeasure(oscParent, name) {}
+    : header{},
+      packets(new VbanPacket[PACKET_QUEUE_SIZE]),
+      rawBuffer(new int16_t[RAW_BUFFER_SIZE]),
+      started(false),
+      packetWriteIndex(0),
+      packetReadIndex(0),
+      sampleRate(48000),
+      periodNs(0),
+      pacedSenderQuitRequested(false),
+      sampleRateMeasure(oscParent, name) {}
 
 RemoteUdpOutput::~RemoteUdpOutput() {
 	stop();
 }
 
-int RemoteUdpOutput::init(int index, int samplerate, const char* ip, int port) {
+int RemoteUdpOutput::init(int index, int samplerate, const char* ip, int port, bool paced) {
 	std::string streamName = ChannelStrip::JACK_CLIENT_NAME_PREFIX + std::to_string(index);
 	uint32_t targetIp = inet_addr(ip);
 
@@ -44,7 +57,7 @@ int RemoteUdpOutput::init(int index, int samplerate, const char* ip, int port) {
 		return 1;
 
 	started = true;
-	SPDLOG_INFO("Sending audio {} to {}:{}", index, ip, port);
+	SPDLOG_INFO("Sending audio {} to {}:{}{}", index, ip, port, paced ? " with pacing" : "");
 
 	sin_server.sin_addr.s_addr = targetIp;
 
@@ -67,12 +80,17 @@ int RemoteUdpOutput::init(int index, int samplerate, const char* ip, int port) {
 	ioctlsocket(sock_fd, FIONBIO, &flags);
 #endif
 
-	dataBuffer.header.vban = 0x4e414256;  // "VBAN"
+	header.vban = 0x4e414256;  // "VBAN"
 	setSampleRate(samplerate);
-	dataBuffer.header.format_nbc = 2 - 1;                // numChannels - 1 channel
-	dataBuffer.header.format_bit = VBAN_DATATYPE_INT16;  // INT16 PCM
-	strncpy(dataBuffer.header.streamname, streamName.c_str(), sizeof(dataBuffer.header.streamname) - 1);
-	dataBuffer.header.nuFrame = 0;
+	header.format_nbc = 2 - 1;                // numChannels - 1 channel
+	header.format_bit = VBAN_DATATYPE_INT16;  // INT16 PCM
+	strncpy(header.streamname, streamName.c_str(), sizeof(header.streamname) - 1);
+	header.nuFrame = 0;
+
+	packetWriteIndex = 0;
+	packetReadIndex = 0;
+	if(paced)
+		startPacedSender();
 
 	return 0;
 }
@@ -80,6 +98,8 @@ int RemoteUdpOutput::init(int index, int samplerate, const char* ip, int port) {
 void RemoteUdpOutput::stop() {
 	if(started) {
 		started = false;
+		// Before closing the socket as the sender thread uses it
+		stopPacedSender();
 		int sock_fd = this->sock_fd;
 		this->sock_fd = -1;
 #ifdef _WIN32
@@ -101,31 +121,101 @@ void RemoteUdpOutput::onSlowTimer() {
 void RemoteUdpOutput::setSampleRate(uint32_t sampleRate) {
 	for(size_t i = 0; i < sizeof(VBAN_SRList) / sizeof(VBAN_SRList[0]); i++) {
 		if(VBAN_SRList[i] == sampleRate) {
-			dataBuffer.header.format_SR = i;
+			header.format_SR = i;
 			break;
 		}
 	}
+	this->sampleRate = sampleRate;
+}
+
+size_t RemoteUdpOutput::getPacketSize(const VbanPacket& packet) {
+	size_t samplesCount = packet.header.format_nbs + 1;
+	return sizeof(packet.header) + samplesCount * (packet.header.format_nbc + 1) * sizeof(packet.data[0]);
 }
 
 void RemoteUdpOutput::sendAudio(float* samplesLeft, float* samplesRight, size_t samplesCount) {
 	if(sock_fd <= 0)
 		return;
 
+	bool paced = pacedSenderThread.joinable();
+	size_t writeIndex = packetWriteIndex.load(std::memory_order_relaxed);
+	size_t batchStart = writeIndex;
+
 	for(size_t samplesSent = 0; samplesSent < samplesCount;) {
-		size_t samplesToSend = samplesCount - samplesSent;
-		if(samplesToSend > 256)
-			samplesToSend = 256;
+		size_t samplesToSend = std::min<size_t>(samplesCount - samplesSent, 256);
 
-		dataBuffer.header.format_nbs = samplesToSend - 1;
+		if(paced && writeIndex - packetReadIndex.load(std::memory_order_acquire) >= PACKET_QUEUE_SIZE) {
+			// The sender thread is late, drop the packet but keep nuFrame growing so the receiver sees the loss
+		} else {
+			VbanPacket& packet = packets[writeIndex % PACKET_QUEUE_SIZE];
 
-		for(size_t i = 0; i < samplesToSend; i++) {
-			dataBuffer.data[i * 2] = samplesLeft[i + samplesSent] * 32768;
-			dataBuffer.data[i * 2 + 1] = samplesRight[i + samplesSent] * 32768;
+			packet.header = header;
+			packet.header.format_nbs = samplesToSend - 1;
+
+			for(size_t i = 0; i < samplesToSend; i++) {
+				packet.data[i * 2] = samplesLeft[i + samplesSent] * 32768;
+				packet.data[i * 2 + 1] = samplesRight[i + samplesSent] * 32768;
+			}
+			writeIndex++;
+		}
+
+		samplesSent += samplesToSend;
+		header.nuFrame++;
+
+		if(!paced && (writeIndex - batchStart == MAX_BATCH_SIZE || samplesSent == samplesCount)) {
+			sendPackets(batchStart, writeIndex - batchStart);
+			batchStart = writeIndex;
+		}
+	}
+
+	if(paced) {
+		periodNs.store(samplesCount * UINT64_C(1000000000) / sampleRate, std::memory_order_relaxed);
+		packetWriteIndex.store(writeIndex, std::memory_order_release);
+		uv_sem_post(&pacedSenderSemaphore);
+	} else {
+		packetWriteIndex.store(writeIndex, std::memory_order_relaxed);
+		packetReadIndex.store(writeIndex, std::memory_order_relaxed);
+	}
+
+	sampleRateMeasure.notifySampleProcessed(samplesCount);
+}
+
+#ifdef __linux__
+void RemoteUdpOutput::sendPackets(size_t index, size_t count) {
+	struct mmsghdr messages[MAX_BATCH_SIZE];
+	struct iovec iovecs[MAX_BATCH_SIZE];
+
+	for(size_t batchStart = 0; batchStart < count; batchStart += MAX_BATCH_SIZE) {
+		size_t batchSize = std::min(count - batchStart, MAX_BATCH_SIZE);
+
+		memset(messages, 0, batchSize * sizeof(messages[0]));
+		for(size_t i = 0; i < batchSize; i++) {
+			VbanPacket& packet = packets[(index + batchStart + i) % PACKET_QUEUE_SIZE];
+
+			iovecs[i].iov_base = &packet;
+			iovecs[i].iov_len = getPacketSize(packet);
+			messages[i].msg_hdr.msg_name = &sin_server;
+			messages[i].msg_hdr.msg_namelen = sizeof(sin_server);
+			messages[i].msg_hdr.msg_iov = &iovecs[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
 		}
 
+		// Packets not sent because the socket buffer is full are dropped, like with sendto
+		int ret = sendmmsg(sock_fd, messages, batchSize, MSG_DONTWAIT);
+		if(ret == -1 && errno != EWOULDBLOCK && errno != EAGAIN) {
+			SPDLOG_ERROR("Socket error, errno: {}", errno);
+			break;
+		}
+	}
+}
+#else
+void RemoteUdpOutput::sendPackets(size_t index, size_t count) {
+	for(size_t i = 0; i < count; i++) {
+		VbanPacket& packet = packets[(index + i) % PACKET_QUEUE_SIZE];
+
 		int ret = sendto(sock_fd,
-		                 (char*) &dataBuffer,
-		                 sizeof(dataBuffer.header) + samplesToSend * 2 * sizeof(dataBuffer.data[0]),
+		                 (char*) &packet,
+		                 getPacketSize(packet),
 		                 0,
 		                 (const struct sockaddr*) &sin_server,
 		                 sizeof(sin_server));
@@ -136,12 +226,50 @@ void RemoteUdpOutput::sendAudio(float* samplesLeft, float* samplesRight, size_t
 			SPDLOG_ERROR("Socket error, errno: {}", errno);
 			break;
 		}
-
-		samplesSent += samplesToSend;
-		dataBuffer.header.nuFrame++;
 	}
+}
+#endif
 
-	sampleRateMeasure.notifySampleProcessed(samplesCount);
+void RemoteUdpOutput::startPacedSender() {
+	uv_sem_init(&pacedSenderSemaphore, 0);
+	pacedSenderQuitRequested = false;
+	pacedSenderThread = std::thread(&RemoteUdpOutput::runPacedSender, this);
+}
+
+void RemoteUdpOutput::stopPacedSender() {
+	if(!pacedSenderThread.joinable())
+		return;
+
+	pacedSenderQuitRequested = true;
+	uv_sem_post(&pacedSenderSemaphore);
+	pacedSenderThread.join();
+	uv_sem_destroy(&pacedSenderSemaphore);
+}
+
+void RemoteUdpOutput::runPacedSender() {
+	RealtimeThread::setHelperThreadPriority("UDP paced sender");
+
+	while(true) {
+		uv_sem_wait(&pacedSenderSemaphore);
+		if(pacedSenderQuitRequested)
+			break;
+
+		size_t readIndex = packetReadIndex.load(std::memory_order_relaxed);
+		size_t writeIndex = packetWriteIndex.load(std::memory_order_acquire);
+		if(readIndex == writeIndex)
+			continue;
+
+		// Spread the packets over one period, when late this also catches up with the queued cycles
+		auto interval = std::chrono::nanoseconds(periodNs.load(std::memory_order_relaxed) / (writeIndex - readIndex));
+		auto nextSendTime = std::chrono::steady_clock::now();
+
+		for(; readIndex != writeIndex && !pacedSenderQuitRequested; readIndex++) {
+			std::this_thread::sleep_until(nextSendTime);
+			sendPackets(readIndex, 1);
+			packetReadIndex.store(readIndex + 1, std::memory_order_release);
+			nextSendTime += interval;
+		}
+	}
 }
 
 void RemoteUdpOutput::sendAudioWithoutVBAN(float* samplesLeft, float* samplesRight, size_t samplesCount) {
@@ -150,17 +278,17 @@ void RemoteUdpOutput::sendAudioWithoutVBAN(float* samplesLeft, float* samplesRig
 
 	for(size_t samplesSent = 0; samplesSent < samplesCount;) {
 		size_t samplesToSend = samplesCount - samplesSent;
-		if(samplesToSend > sizeof(dataBuffer.data))
-			samplesToSend = sizeof(dataBuffer.data);
+		if(samplesToSend > RAW_BUFFER_SIZE / 2)
+			samplesToSend = RAW_BUFFER_SIZE / 2;
 
 		for(size_t i = 0; i < samplesToSend; i++) {
-			dataBuffer.data[i * 2] = samplesLeft[i + samplesSent] * 32768;
-			dataBuffer.data[i * 2 + 1] = samplesRight[i + samplesSent] * 32768;
+			rawBuffer[i * 2] = samplesLeft[i + samplesSent] * 32768;
+			rawBuffer[i * 2 + 1] = samplesRight[i + samplesSent] * 32768;
 		}
 
 		int ret = sendto(sock_fd,
-		                 (char*) dataBuffer.data,
-		                 samplesToSend * 2 * sizeof(dataBuffer.data[0]),
+		                 (char*) rawBuffer.get(),
+		                 samplesToSend * 2 * sizeof(rawBuffer[0]),
 		                 0,
 		                 (const struct sockaddr*) &sin_server,
 		                 sizeof(sin_server));
@@ -1,14 +1,24 @@
 #pragma once
 
 #include "SampleRateMeasure.h"
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <uv.h>
 
+/*
+ * Sends the audio of a strip to a remote VBAN receiver.
+ *
+ * The VBAN packets of a JACK cycle are built in a preallocated queue. Without pacing, they are sent from the audio
+ * thread with one sendmmsg call on Linux (one sendto per packet elsewhere). With pacing, the audio thread only queues
+ * them and a sender thread spreads them evenly over the cycle period instead of sending them as a burst.
+ */
 class RemoteUdpOutput {
 public:
 	RemoteUdpOutput(OscContainer* oscParent, const char* name);
 	~RemoteUdpOutput();
 
-	int init(int index, int samplerate, const char* ip, int port);
+	int init(int index, int samplerate, const char* ip, int port, bool paced);
 	void stop();
 	bool isStarted();
 	void onSlowTimer();
@@ -29,17 +39,40 @@ private:
 		char streamname[16]; /* stream name */
 		uint32_t nuFrame;    /* growing frame number. */
 	};
-	struct VbanBuffer {
+	struct VbanPacket {
 		VbanHeader header;
-		int16_t data[65536];
+		int16_t data[256 * 2];
 	};
 #pragma pack(pop)
 
+	static constexpr size_t PACKET_QUEUE_SIZE = 256;  // Power of 2
+	static constexpr size_t MAX_BATCH_SIZE = 64;
+	static constexpr size_t RAW_BUFFER_SIZE = 65536;
+
+	static size_t getPacketSize(const VbanPacket& packet);
+	// Send count packets of the queue starting at index, without blocking
+	void sendPackets(size_t index, size_t count);
+
+	void startPacedSender();
+	void stopPacedSender();
+	void runPacedSender();
+
 private:
 	struct sockaddr_in sin_server;
 	int sock_fd;
-	VbanBuffer dataBuffer;
+	VbanHeader header;
+	std::unique_ptr<VbanPacket[]> packets;
+	std::unique_ptr<int16_t[]> rawBuffer;
 	bool started;
 
+	// Packets from packetReadIndex to packetWriteIndex are waiting for the paced sender
+	std::atomic<size_t> packetWriteIndex;
+	std::atomic<size_t> packetReadIndex;
+	std::atomic<uint32_t> sampleRate;
+	std::atomic<uint64_t> periodNs;  // Duration of the last queued cycle
+	std::atomic<bool> pacedSenderQuitRequested;
+	std::thread pacedSenderThread;
+	uv_sem_t pacedSenderSemaphore;
+
 	SampleRateMeasure sampleRateMeasure;
 };
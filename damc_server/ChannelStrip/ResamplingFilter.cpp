@@ -1,35 +1,287 @@
 #include "ResamplingFilter.h"
+#include <SimdVector.h>
 
+#include <algorithm>
 #include <math.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <spdlog/spdlog.h>
 #include <stdio.h>
 #include <string.h>
+#include <tuple>
 
-bool ResamplingFilter::initialized;
-std::array<double, 8192> ResamplingFilter::optimized_coefs;
+namespace {
 
-void ResamplingFilter::reset(double fs) {
-	if(!initialized) {
-		initialized = true;
+// Quality tiers using fewer taps than the 64 taps prototype filter, designed with a kaiser window.
+// The stopband starts at the same frequency as the prototype filter and the attenuation is lowered with the length.
+struct TierDesign {
+	unsigned int tapCount;
+	double attenuationDb;
+};
+constexpr TierDesign TIER_DESIGNS[] = {{16, 70}, {32, 90}};
+constexpr double STOPBAND_FREQUENCY = 25945;
+constexpr double PROTOTYPE_SAMPLING_RATE = 48000.0 * 128;
+
+double besselI0(double x) {
+	double sum = 1;
+	double term = 1;
+
+	for(int k = 1; k < 50; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+
+	return sum;
+}
 
-		for(size_t k = 0; k < oversamplingRatio; k++) {
-			for(size_t i = 0; i < tapPerSample; i++) {
-				optimized_coefs[i + (oversamplingRatio - 1 - k) * tapPerSample] =
-				    coefs[k + i * oversamplingRatio] * oversamplingRatio;
+std::vector<double> designPrototype(const TierDesign& design, size_t length) {
+	// Kaiser formulas for the transition width and beta
+	double transitionWidth =
+	    (design.attenuationDb - 7.95) / (2.285 * (length - 1)) / (2 * M_PI) * PROTOTYPE_SAMPLING_RATE;
+	double cutoff = (STOPBAND_FREQUENCY - transitionWidth / 2) / PROTOTYPE_SAMPLING_RATE;
+	double beta = 0.1102 * (design.attenuationDb - 8.7);
+	double center = (length - 1) / 2.0;
+	std::vector<double> prototype(length);
+	double sum = 0;
+
+	for(size_t i = 0; i < length; i++) {
+		double x = i - center;
+		double sinc = x != 0 ? sin(2 * M_PI * cutoff * x) / (M_PI * x) : 2 * cutoff;
+		double ratio = x / center;
+		double window = besselI0(beta * sqrt(std::max(0.0, 1 - ratio * ratio))) / besselI0(beta);
+
+		prototype[i] = sinc * window;
+		sum += prototype[i];
+	}
+
+	for(double& coef : prototype)
+		coef /= sum;
+
+	return prototype;
+}
+
+template<size_t N> SIMD_ALWAYS_INLINE float dotProduct(const float* a, const float* b, size_t count) {
+	Simd::Vector<float, N> sum = {};
+
+	for(size_t i = 0; i < count; i += N) {
+		Simd::Vector<float, N> va;
+		Simd::Vector<float, N> vb;
+		Simd::load(va, a + i);
+		Simd::load(vb, b + i);
+		sum += va * vb;
+	}
+
+	float result = 0;
+	for(size_t lane = 0; lane < N; lane++)
+		result += sum[lane];
+
+	return result;
+}
+
+// Linear interpolation between the outputs of 2 filter phases with a single horizontal sum: a1.b1 + rem * (a2.b2 - a1.b1)
+template<size_t N>
+SIMD_ALWAYS_INLINE float interpolatedDotProduct(
+    const float* a1, const float* b1, const float* a2, const float* b2, float rem, size_t count) {
+	Simd::Vector<float, N> sum1 = {};
+	Simd::Vector<float, N> sum2 = {};
+
+	for(size_t i = 0; i < count; i += N) {
+		Simd::Vector<float, N> va1;
+		Simd::Vector<float, N> vb1;
+		Simd::Vector<float, N> va2;
+		Simd::Vector<float, N> vb2;
+		Simd::load(va1, a1 + i);
+		Simd::load(vb1, b1 + i);
+		Simd::load(va2, a2 + i);
+		Simd::load(vb2, b2 + i);
+		sum1 += va1 * vb1;
+		sum2 += va2 * vb2;
+	}
+
+	Simd::Vector<float, N> remVector;
+	Simd::broadcast(remVector, rem);
+	sum1 += remVector * (sum2 - sum1);
+
+	float result = 0;
+	for(size_t lane = 0; lane < N; lane++)
+		result += sum1[lane];
+
+	return result;
+}
+
+}  // namespace
+
+const float* ResamplingFilter::getPhaseCoefs(unsigned int tapCount) {
+	static std::mutex mutex;
+	static std::vector<float> tables[3];
+	size_t tier = tapCount == 16 ? 0 : tapCount == 32 ? 1 : 2;
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::vector<float>& table = tables[tier];
+
+	if(table.empty()) {
+		std::vector<double> prototype;
+
+		if(tapCount == 64)
+			prototype.assign(coefs.begin(), coefs.end());
+		else
+			prototype = designPrototype(TIER_DESIGNS[tier], tapCount * oversamplingRatio);
+
+		// Polyphase decomposition, tap k of phase is applied to the sample k positions before the last one
+		table.resize(tapCount * oversamplingRatio);
+		for(size_t phase = 0; phase < oversamplingRatio; phase++) {
+			for(size_t k = 0; k < tapCount; k++) {
+				table[phase * tapCount + (tapCount - 1 - k)] =
+				    (float) (prototype[(oversamplingRatio - 1 - phase) + k * oversamplingRatio] * oversamplingRatio);
+			}
+		}
+	}
+
+	return table.data();
+}
+
+const ResamplingFilter::RationalSchedule* ResamplingFilter::getRationalSchedule(unsigned int tapCount,
+                                                                                 unsigned int inputStep,
+                                                                                 unsigned int outputStep) {
+	// Schedules are never freed so the audio thread can keep using a replaced one until its next block
+	static std::mutex mutex;
+	static std::map<std::tuple<unsigned int, unsigned int, unsigned int>, std::unique_ptr<RationalSchedule>> schedules;
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::unique_ptr<RationalSchedule>& schedule = schedules[std::make_tuple(tapCount, inputStep, outputStep)];
+
+	if(!schedule) {
+		const float* phaseCoefs = getPhaseCoefs(tapCount);
+
+		schedule.reset(new RationalSchedule);
+		schedule->inputStep = inputStep;
+		schedule->outputStep = outputStep;
+		schedule->rowSize = tapCount + RATIONAL_ROW_PADDING;
+		schedule->coefs.resize(inputStep * schedule->rowSize, 0.0f);
+
+		// Row i is the linear interpolation of the 2 phases around the delay i * oversamplingRatio / inputStep, the next
+		// phase of the last one is the first phase applied one sample earlier
+		for(size_t i = 0; i < inputStep; i++) {
+			double delay = (double) i * oversamplingRatio / inputStep;
+			unsigned int phase = (unsigned int) delay;
+			unsigned int nextPhase = phase + 1;
+			double rem = delay - phase;
+			float* row = &schedule->coefs[i * schedule->rowSize];
+			float* phaseRow = row + schedule->rowSize - tapCount;
+			float* nextPhaseRow = phaseRow - nextPhase / oversamplingRatio;
+
+			for(size_t k = 0; k < tapCount; k++) {
+				phaseRow[k] += (1 - rem) * phaseCoefs[phase * tapCount + k];
+				nextPhaseRow[k] += rem * phaseCoefs[(nextPhase % oversamplingRatio) * tapCount + k];
 			}
 		}
 	}
 
+	return schedule.get();
+}
+
+ResamplingFilter::ResamplingFilter() {
+	activeParameters = parameters.acquire();
+}
+
+ResamplingFilter::ResamplingFilter(const ResamplingFilter& other)
+    : currentPos(other.currentPos),
+      previousDelay(other.previousDelay),
+      history(other.history),
+      tapCount(other.tapCount),
+      phaseCoefs(other.phaseCoefs),
+      baseSamplingRate(other.baseSamplingRate),
+      targetSamplingRate(other.targetSamplingRate),
+      clockDrift(other.clockDrift),
+      driftTracking(other.driftTracking),
+      parameters(other.parameters.get()),
+      trackedRatio(other.trackedRatio.load()) {
+	updateParameters();
+}
+
+void ResamplingFilter::publishParameters() {
+	double rate = oversamplingRatio * baseSamplingRate / targetSamplingRate;
+	bool integerRates = baseSamplingRate == floor(baseSamplingRate) && targetSamplingRate == floor(targetSamplingRate);
+	Parameters newParameters;
+
+	newParameters.downsamplingRatio = rate / (1.0 + (double) clockDrift);
+	newParameters.driftTracking = driftTracking;
+
+	// Fast paths are only used without drift compensation, the arbitrary ratio path is needed to follow drift changes
+	if(driftTracking) {
+		newParameters.mode = M_Interpolated;
+		trackedRatio.store(newParameters.downsamplingRatio, std::memory_order_relaxed);
+	} else if(newParameters.downsamplingRatio == oversamplingRatio && baseSamplingRate == targetSamplingRate) {
+		newParameters.mode = M_Bypass;
+	} else if(newParameters.downsamplingRatio == rate && integerRates && baseSamplingRate > 0 &&
+	          targetSamplingRate > 0) {
+		int64_t base = (int64_t) baseSamplingRate;
+		int64_t target = (int64_t) targetSamplingRate;
+		int64_t divisor = std::gcd(base, target);
+
+		if(target / divisor <= MAX_RATIONAL_PHASES) {
+			newParameters.rationalSchedule = getRationalSchedule(tapCount, target / divisor, base / divisor);
+			newParameters.mode = M_Rational;
+		} else {
+			newParameters.mode = M_Interpolated;
+		}
+	} else {
+		newParameters.mode = M_Interpolated;
+	}
+
+	parameters.publish(newParameters);
+}
+
+bool ResamplingFilter::isValidTapCount(int32_t tapCount) {
+	return tapCount == 16 || tapCount == 32 || tapCount == 64;
+}
+
+void ResamplingFilter::setTapCount(unsigned int tapCount) {
+	if(!isValidTapCount(tapCount)) {
+		SPDLOG_ERROR("Bad resampling tap count {}", tapCount);
+		return;
+	}
+
+	this->tapCount = tapCount;
+	phaseCoefs = getPhaseCoefs(tapCount);
+	publishParameters();
+}
+
+void ResamplingFilter::reset(double fs) {
+	if(!phaseCoefs)
+		phaseCoefs = getPhaseCoefs(tapCount);
+
 	baseSamplingRate = fs;
 	targetSamplingRate = fs;
-	currentPos = 0;
+	clockDrift = 0;
+	currentPos = historySize;
 	previousDelay = oversamplingRatio - 1;
 	history.fill(0);
+	publishParameters();
+	updateParameters();
 }
 
-void ResamplingFilter::put(double sample) {
-	history[currentPos] = sample;
-	currentPos = (currentPos - 1) % history.size();
+void ResamplingFilter::updateParameters() {
+	activeParameters = parameters.acquire();
+
+	// Drift updates are taken once per block too, so the size queries match the processing of the block
+	if(activeParameters->driftTracking)
+		activeRatio = trackedRatio.load(std::memory_order_relaxed);
+	else
+		activeRatio = activeParameters->downsamplingRatio;
+}
+
+void ResamplingFilter::put(float sample) {
+	if(currentPos == history.size())
+		shiftHistory();
+	history[currentPos++] = sample;
+}
+
+void ResamplingFilter::shiftHistory() {
+	std::copy(history.end() - historySize, history.end(), history.begin());
+	currentPos = historySize;
 }
 
 int ResamplingFilter::get(std::vector<float>& out, double period) {
@@ -46,14 +298,103 @@ int ResamplingFilter::get(std::vector<float>& out, double period) {
 }
 
 int ResamplingFilter::processSamples(std::vector<float>& output, const float* input, size_t count) {
-	output.clear();
+	updateParameters();
+	output.resize(getMaxRequiredOutputSize(count));
+	output.resize(processSamples(output.data(), input, count));
+
+	return 0;
+}
 
-	for(size_t i = 0; i < count; i++) {
-		put(input[i]);
-		get(output, downsamplingRatio);
+size_t ResamplingFilter::processSamples(float* output, const float* input, size_t count) {
+	Simd::Level level = Simd::getLevel();
+
+	// No AVX512 kernel, unaligned 64 bytes loads of the sliding window always split cache lines and are slower than AVX2
+	if(level >= Simd::AVX2)
+		return processAvx2(output, input, count);
+	else if(level >= Simd::SSE2)
+		return processSse2(output, input, count);
+	else
+		return processScalar(output, input, count);
+}
+
+template<size_t N>
+SIMD_ALWAYS_INLINE size_t ResamplingFilter::processLanes(float* output, const float* input, size_t count) {
+	Mode mode = activeParameters->mode;
+	const RationalSchedule* schedule = activeParameters->rationalSchedule;
+	double period = activeRatio;
+	double delay = previousDelay;
+	// Delay in 1/inputStep sample unit for the rational ratio path
+	int scheduleDelay = 0;
+	size_t outputSize = 0;
+
+	if(mode == M_Rational) {
+		scheduleDelay = std::min<int>(lround(delay * schedule->inputStep / oversamplingRatio), schedule->inputStep - 1);
 	}
 
-	return 0;
+	for(size_t i = 0; i < count;) {
+		// Copy input samples by chunk before filtering them as vector loads of just written samples are slow
+		if(currentPos == history.size())
+			shiftHistory();
+
+		size_t chunkSize = std::min(count - i, history.size() - currentPos);
+		size_t chunkEnd = currentPos + chunkSize;
+		std::copy_n(input + i, chunkSize, &history[currentPos]);
+		i += chunkSize;
+
+		if(mode == M_Bypass) {
+			// Keep the same latency as the filter path so switching to it is seamless
+			std::copy_n(&history[currentPos - tapCount / 2], chunkSize, output + outputSize);
+			outputSize += chunkSize;
+		} else if(mode == M_Rational) {
+			for(currentPos++; currentPos <= chunkEnd; currentPos++) {
+				const float* samples = &history[currentPos - schedule->rowSize];
+
+				while(scheduleDelay >= 0) {
+					output[outputSize++] = dotProduct<N>(
+					    samples, &schedule->coefs[scheduleDelay * schedule->rowSize], schedule->rowSize);
+					scheduleDelay -= schedule->outputStep;
+				}
+				scheduleDelay += schedule->inputStep;
+			}
+		} else {
+			for(currentPos++; currentPos <= chunkEnd; currentPos++) {
+				while(delay >= 0) {
+					unsigned int phase = (unsigned int) delay;
+					unsigned int nextPhase = phase + 1;
+					output[outputSize++] = interpolatedDotProduct<N>(getSamples(phase),
+					                                                 getPhase(phase),
+					                                                 getSamples(nextPhase),
+					                                                 getPhase(nextPhase),
+					                                                 delay - phase,
+					                                                 tapCount);
+					delay -= period;
+				}
+				delay += oversamplingRatio;
+			}
+		}
+		currentPos = chunkEnd;
+	}
+
+	if(mode == M_Bypass)
+		previousDelay = oversamplingRatio - 1;
+	else if(mode == M_Rational)
+		previousDelay = (double) scheduleDelay * oversamplingRatio / schedule->inputStep;
+	else
+		previousDelay = delay;
+
+	return outputSize;
+}
+
+SIMD_TARGET_AVX2 size_t ResamplingFilter::processAvx2(float* output, const float* input, size_t count) {
+	return processLanes<8>(output, input, count);
+}
+
+SIMD_TARGET_SSE2 size_t ResamplingFilter::processSse2(float* output, const float* input, size_t count) {
+	return processLanes<4>(output, input, count);
+}
+
+size_t ResamplingFilter::processScalar(float* output, const float* input, size_t count) {
+	return processLanes<1>(output, input, count);
 }
 
 int ResamplingFilter::getNextOutputSize() {
@@ -61,7 +402,7 @@ int ResamplingFilter::getNextOutputSize() {
 	double delay = previousDelay;
 
 	while(delay >= 0) {
-		delay -= downsamplingRatio;
+		delay -= activeRatio;
 		iterations++;
 	}
 
@@ -69,26 +410,45 @@ int ResamplingFilter::getNextOutputSize() {
 }
 
 size_t ResamplingFilter::getMaxRequiredOutputSize(size_t count) {
-	return ceil(count * oversamplingRatio / downsamplingRatio);
+	// One more as the first input sample can produce an output sample more depending on the current phase
+	return ceil(count * oversamplingRatio / activeRatio) + 1;
 }
 
 size_t ResamplingFilter::getMinRequiredOutputSize(size_t count) {
-	return floor(count * oversamplingRatio / downsamplingRatio);
+	return floor(count * oversamplingRatio / activeRatio);
+}
+
+size_t ResamplingFilter::getRequiredInputSize(size_t outputCount) {
+	return ceil(outputCount * activeRatio / oversamplingRatio);
 }
 
 void ResamplingFilter::setClockDrift(float drift) {
 	double newRatio = oversamplingRatio * baseSamplingRate / targetSamplingRate / (1.0 + (double) drift);
-	if(newRatio >= 1)
-		downsamplingRatio = newRatio;
+	if(newRatio < 1)
+		return;
+
+	if(driftTracking) {
+		trackedRatio.store(newRatio, std::memory_order_relaxed);
+	} else {
+		clockDrift = drift;
+		publishParameters();
+	}
+}
+
+void ResamplingFilter::setDriftTracking(bool enable) {
+	driftTracking = enable;
+	publishParameters();
 }
 
 float ResamplingFilter::getClockDrift() {
-	return (oversamplingRatio * baseSamplingRate / targetSamplingRate / downsamplingRatio) - 1.0;
+	double ratio = driftTracking ? trackedRatio.load(std::memory_order_relaxed) : parameters.get().downsamplingRatio;
+	return (oversamplingRatio * baseSamplingRate / targetSamplingRate / ratio) - 1.0;
 }
 
 void ResamplingFilter::setSourceSamplingRate(float samplingRate) {
 	baseSamplingRate = samplingRate;
-	downsamplingRatio = oversamplingRatio * baseSamplingRate / targetSamplingRate;
+	clockDrift = 0;
+	publishParameters();
 }
 
 float ResamplingFilter::getSourceSamplingRate() {
@@ -97,42 +457,34 @@ float ResamplingFilter::getSourceSamplingRate() {
 
 void ResamplingFilter::setTargetSamplingRate(float samplingRate) {
 	targetSamplingRate = samplingRate;
-	downsamplingRatio = oversamplingRatio * baseSamplingRate / targetSamplingRate;
+	clockDrift = 0;
+	publishParameters();
 }
 
 float ResamplingFilter::getTargetSamplingRate() {
 	return targetSamplingRate;
 }
 
-double ResamplingFilter::getLinearInterpolatedPoint(double delay) const {
+float ResamplingFilter::getLinearInterpolatedPoint(double delay) const {
 	if(delay < 0 || delay > oversamplingRatio) {
 		SPDLOG_ERROR("Bad resampling subsample delay {}", delay);
 	}
 	int x = int(delay + 2) - 2;
 
-	double rem = delay - x;
+	float rem = delay - x;
 
 	if(rem == 0)
 		return getOnePoint(x);
 
-	double v1 = getOnePoint(x);
-	double v2 = getOnePoint(x + 1);
+	float v1 = getOnePoint(x);
+	float v2 = getOnePoint(x + 1);
 	return v1 + rem * (v2 - v1);
 }
 
-double ResamplingFilter::getZeroOrderHoldInterpolatedPoint(double delay) const {
+float ResamplingFilter::getZeroOrderHoldInterpolatedPoint(double delay) const {
 	return getOnePoint(int(delay));
 }
 
-double ResamplingFilter::getOnePoint(unsigned int delay) const {
-	double sum = 0;
-	unsigned int index = currentPos + (delay / oversamplingRatio);
-	delay %= oversamplingRatio;
-
-	for(unsigned int k = 0; k < tapPerSample; k++) {
-		index = (index + 1) % history.size();
-		sum += history[index] * optimized_coefs[k + delay * tapPerSample];
-	}
-
-	return sum;
+float ResamplingFilter::getOnePoint(unsigned int delay) const {
+	return interpolatedDotProduct<1>(getSamples(delay), getPhase(delay), getSamples(delay), getPhase(delay), 0, tapCount);
 }
@@ -1,22 +1,48 @@
 #pragma once
 
+#include <RealtimeSnapshot.h>
 #include <array>
+#include <atomic>
 #include <stddef.h>
+#include <stdint.h>
 #include <vector>
 
+/*
+ * Resampler of one channel.
+ *
+ * Setters are called by the main thread, they publish the mode, rational schedule and ratio together to the audio
+ * thread which uses them from its next block. reset(), setTapCount() and setDriftTracking() must only be called while
+ * the audio thread isn't running.
+ */
 class ResamplingFilter {
 public:
+	ResamplingFilter();
+	// For containers, neither filter must be in use by the audio thread
+	ResamplingFilter(const ResamplingFilter& other);
+	ResamplingFilter& operator=(const ResamplingFilter&) = delete;
+
 	void reset(double fs);
-	void put(double sample);
+	void put(float sample);
 	int get(std::vector<float>& out, double period);
 
+	// Called by the audio thread once per block before the other audio thread methods, done by the vector overload of
+	// processSamples
+	void updateParameters();
+
 	int processSamples(std::vector<float>& output, const float* input, size_t count);
+	// output must have room for getMaxRequiredOutputSize(count) samples, return the number of samples written
+	size_t processSamples(float* output, const float* input, size_t count);
 	int getNextOutputSize();
 	size_t getMaxRequiredOutputSize(size_t count);
 	size_t getMinRequiredOutputSize(size_t count);
+	// Input samples producing at least outputCount samples
+	size_t getRequiredInputSize(size_t outputCount);
 
 	void setClockDrift(float drift);
 	float getClockDrift();
+	// Keep the arbitrary ratio path while drift is continuously adjusted, setClockDrift() is then realtime safe and can
+	// be called by the audio thread. Sampling rates must not change while tracking drift
+	void setDriftTracking(bool enable);
 
 	void setSourceSamplingRate(float samplingRate);
 	float getSourceSamplingRate();
@@ -24,26 +50,87 @@ public:
 	void setTargetSamplingRate(float samplingRate);
 	float getTargetSamplingRate();
 
+	// Quality tiers, number of input samples used for each output sample: 16, 32 or 64 (default)
+	// Fewer taps use less CPU but have a wider transition band below the Nyquist frequency
+	static bool isValidTapCount(int32_t tapCount);
+	void setTapCount(unsigned int tapCount);
+	unsigned int getTapCount() { return tapCount; }
+
+	// Equal rates are copied and exact rational ratios without drift use precomputed filter phases
+	enum Mode { M_Bypass, M_Rational, M_Interpolated };
+	// Main thread
+	Mode getMode() { return parameters.get().mode; }
+
 	static constexpr unsigned int getOverSamplingRatio() { return oversamplingRatio; }
-	float getDownSamplingRatio() { return downsamplingRatio; }
+	// Audio thread, ratio of the current block
+	float getDownSamplingRatio() { return activeRatio; }
 
 protected:
-	inline double getLinearInterpolatedPoint(double delay) const;
-	inline double getZeroOrderHoldInterpolatedPoint(double delay) const;
-	inline double getOnePoint(unsigned int delay) const;
+	// Filter coefficients of each output phase of a rational ratio, over rowSize samples
+	struct RationalSchedule {
+		unsigned int inputStep;
+		unsigned int outputStep;
+		size_t rowSize;
+		std::vector<float> coefs;
+	};
+
+	struct Parameters {
+		Mode mode = M_Bypass;
+		const RationalSchedule* rationalSchedule = nullptr;
+		double downsamplingRatio = oversamplingRatio;
+		// The ratio is then taken from trackedRatio, so drift updates don't publish new parameters
+		bool driftTracking = false;
+	};
+
+	inline float getLinearInterpolatedPoint(double delay) const;
+	inline float getZeroOrderHoldInterpolatedPoint(double delay) const;
+	inline float getOnePoint(unsigned int delay) const;
+	// Last tapCount samples and coefficients for a delay in 1/oversamplingRatio sample unit
+	const float* getSamples(unsigned int delay) const {
+		return &history[currentPos - tapCount - delay / oversamplingRatio];
+	}
+	const float* getPhase(unsigned int delay) const { return phaseCoefs + (delay % oversamplingRatio) * tapCount; }
+
+	template<size_t N> size_t processLanes(float* output, const float* input, size_t count);
+	size_t processAvx2(float* output, const float* input, size_t count);
+	size_t processSse2(float* output, const float* input, size_t count);
+	size_t processScalar(float* output, const float* input, size_t count);
+
+	void shiftHistory();
+	void publishParameters();
+	static const float* getPhaseCoefs(unsigned int tapCount);
+	static const RationalSchedule* getRationalSchedule(unsigned int tapCount,
+	                                                   unsigned int inputStep,
+	                                                   unsigned int outputStep);
 
 private:
+	static constexpr unsigned int oversamplingRatio = 128;
+	// Samples are appended after the last historySize samples, which are moved back to the start when history is full
+	static constexpr unsigned int historySize = 128;
+	// Rows hold one more sample than tapCount for the phase after the last one, padded to a multiple of vector lanes
+	static constexpr size_t RATIONAL_ROW_PADDING = 8;
+	static constexpr unsigned int MAX_RATIONAL_PHASES = 1024;
+
 	unsigned int currentPos;
 	double previousDelay;
-	std::array<double, 256> history;
+	std::array<float, 4 * historySize> history;
+
+	unsigned int tapCount = 64;
+	// oversamplingRatio phases of tapCount coefficients, in the same order as samples in history
+	const float* phaseCoefs = nullptr;
 
+	// Main thread state
 	double baseSamplingRate = 48000.f;
 	double targetSamplingRate = 48000.f;
-	double downsamplingRatio = oversamplingRatio;
+	float clockDrift = 0;
+	bool driftTracking = false;
+
+	RealtimeSnapshot<Parameters> parameters;
+	std::atomic<double> trackedRatio{oversamplingRatio};
+
+	// Audio thread state, parameters of the current block
+	const Parameters* activeParameters = nullptr;
+	double activeRatio = oversamplingRatio;
 
-	static bool initialized;
 	static const std::array<double, 8192> coefs;
-	static std::array<double, 8192> optimized_coefs;
-	static constexpr unsigned int oversamplingRatio = 128;
-	static constexpr unsigned int tapPerSample = (unsigned int) coefs.size() / oversamplingRatio;
 };
@@ -0,0 +1,255 @@
+#include "UdpReceiveThread.h"
+#include <RealtimeThread.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <WinSock2.h>
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+struct UdpReceiveThread::Registration {
+	uv_os_sock_t socket;
+	PacketCallback callback;
+	void* arg;
+};
+
+struct UdpReceiveThread::State {
+	~State() {
+		if(thread.joinable())
+			stopThread(*this);
+	}
+
+	// Held by the thread while it calls callbacks, so removeSocket can wait for it
+	std::mutex mutex;
+	std::vector<std::unique_ptr<Registration>> registrations;
+
+	std::thread thread;
+	std::atomic<bool> quitRequested{false};
+	std::unique_ptr<uint8_t[]> buffers;  // BATCH_SIZE packets of MAX_PACKET_SIZE
+#ifdef __linux__
+	int epollFd = -1;
+	int wakeupFd = -1;  // Registered with a null pointer to wake up the thread on stop
+#endif
+};
+
+UdpReceiveThread::State& UdpReceiveThread::getState() {
+	static State state;
+	return state;
+}
+
+int UdpReceiveThread::addSocket(uv_os_sock_t socket, PacketCallback callback, void* arg) {
+	State& state = getState();
+
+	if(!state.thread.joinable()) {
+		int ret = startThread(state);
+		if(ret < 0)
+			return ret;
+	}
+
+	Registration* registration = new Registration{socket, callback, arg};
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		state.registrations.emplace_back(registration);
+	}
+
+#ifdef __linux__
+	struct epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.ptr = registration;
+	if(epoll_ctl(state.epollFd, EPOLL_CTL_ADD, socket, &event) < 0) {
+		// removeSocket can overwrite errno
+		int ret = uv_translate_sys_error(errno);
+		removeSocket(socket);
+		return ret;
+	}
+#endif
+
+	return 0;
+}
+
+void UdpReceiveThread::removeSocket(uv_os_sock_t socket) {
+	State& state = getState();
+
+#ifdef __linux__
+	if(state.epollFd >= 0)
+		epoll_ctl(state.epollFd, EPOLL_CTL_DEL, socket, nullptr);
+#endif
+
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		auto it = std::find_if(state.registrations.begin(),
+		                       state.registrations.end(),
+		                       [socket](const std::unique_ptr<Registration>& item) { return item->socket == socket; });
+		if(it != state.registrations.end())
+			state.registrations.erase(it);
+	}
+
+	if(state.registrations.empty() && state.thread.joinable())
+		stopThread(state);
+}
+
+int UdpReceiveThread::startThread(State& state) {
+#ifdef __linux__
+	state.epollFd = epoll_create1(EPOLL_CLOEXEC);
+	state.wakeupFd = state.epollFd >= 0 ? eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC) : -1;
+	if(state.epollFd < 0 || state.wakeupFd < 0) {
+		int ret = uv_translate_sys_error(errno);
+		stopThread(state);
+		return ret;
+	}
+
+	struct epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.ptr = nullptr;
+	epoll_ctl(state.epollFd, EPOLL_CTL_ADD, state.wakeupFd, &event);
+#endif
+
+	SPDLOG_INFO("Starting UDP receive thread");
+
+	state.buffers.reset(new uint8_t[BATCH_SIZE * MAX_PACKET_SIZE]);
+	state.quitRequested = false;
+	state.thread = std::thread(&UdpReceiveThread::run, &state);
+
+	return 0;
+}
+
+void UdpReceiveThread::stopThread(State& state) {
+	state.quitRequested = true;
+
+	if(state.thread.joinable()) {
+		SPDLOG_INFO("Stopping UDP receive thread");
+#ifdef __linux__
+		uint64_t value = 1;
+		if(write(state.wakeupFd, &value, sizeof(value)) < 0)
+			SPDLOG_WARN("Failed to wake up UDP receive thread: {}", strerror(errno));
+#endif
+		state.thread.join();
+	}
+
+#ifdef __linux__
+	if(state.epollFd >= 0)
+		close(state.epollFd);
+	if(state.wakeupFd >= 0)
+		close(state.wakeupFd);
+	state.epollFd = -1;
+	state.wakeupFd = -1;
+#endif
+	state.buffers.reset();
+}
+
+#ifdef __linux__
+void UdpReceiveThread::run(State* state) {
+	struct epoll_event events[BATCH_SIZE];
+
+	RealtimeThread::setHelperThreadPriority("UDP receive");
+
+	while(!state->quitRequested) {
+		int count = epoll_wait(state->epollFd, events, BATCH_SIZE, -1);
+		if(count < 0) {
+			if(errno == EINTR)
+				continue;
+			SPDLOG_ERROR("UDP receive epoll_wait failed: {}", strerror(errno));
+			break;
+		}
+
+		std::lock_guard<std::mutex> lock(state->mutex);
+		for(int i = 0; i < count; i++) {
+			Registration* registration = (Registration*) events[i].data.ptr;
+			if(!registration)
+				continue;
+
+			// The socket might have been removed since epoll_wait returned
+			for(const std::unique_ptr<Registration>& item : state->registrations) {
+				if(item.get() == registration) {
+					receivePackets(state, registration);
+					break;
+				}
+			}
+		}
+	}
+}
+
+void UdpReceiveThread::receivePackets(State* state, Registration* registration) {
+	struct mmsghdr messages[BATCH_SIZE];
+	struct iovec iovecs[BATCH_SIZE];
+
+	memset(messages, 0, sizeof(messages));
+	for(size_t i = 0; i < BATCH_SIZE; i++) {
+		iovecs[i].iov_base = state->buffers.get() + i * MAX_PACKET_SIZE;
+		iovecs[i].iov_len = MAX_PACKET_SIZE;
+		messages[i].msg_hdr.msg_iov = &iovecs[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	// Drain the socket, a partial batch means there is nothing left
+	int received;
+	do {
+		received = recvmmsg(registration->socket, messages, BATCH_SIZE, MSG_DONTWAIT, nullptr);
+
+		for(int i = 0; i < received; i++)
+			registration->callback(registration->arg, (const uint8_t*) iovecs[i].iov_base, messages[i].msg_len);
+	} while(received == (int) BATCH_SIZE);
+
+	if(received < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+		SPDLOG_DEBUG("UDP receive failed: {}", strerror(errno));
+}
+#else
+void UdpReceiveThread::run(State* state) {
+	RealtimeThread::setHelperThreadPriority("UDP receive");
+
+	while(!state->quitRequested) {
+		fd_set readSet;
+		uv_os_sock_t maxSocket = 0;
+
+		FD_ZERO(&readSet);
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			for(const std::unique_ptr<Registration>& registration : state->registrations) {
+				FD_SET(registration->socket, &readSet);
+				maxSocket = std::max(maxSocket, registration->socket);
+			}
+		}
+
+		// The timeout picks up added sockets and stop requests
+		struct timeval timeout = {0, 50000};
+		int count = select((int) maxSocket + 1, &readSet, nullptr, nullptr, &timeout);
+		if(count <= 0)
+			continue;
+
+		std::lock_guard<std::mutex> lock(state->mutex);
+		for(const std::unique_ptr<Registration>& registration : state->registrations) {
+			if(FD_ISSET(registration->socket, &readSet))
+				receivePackets(state, registration.get());
+		}
+	}
+}
+
+void UdpReceiveThread::receivePackets(State* state, Registration* registration) {
+	char* buffer = (char*) state->buffers.get();
+
+	for(size_t i = 0; i < BATCH_SIZE; i++) {
+		int received = recvfrom(registration->socket, buffer, MAX_PACKET_SIZE, 0, nullptr, nullptr);
+		if(received <= 0)
+			break;
+
+		registration->callback(registration->arg, (const uint8_t*) buffer, received);
+	}
+}
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <uv.h>
+
+/*
+ * Process wide thread receiving the UDP audio streams of all remote inputs.
+ *
+ * Receiving on the libuv main loop delays packets while it handles OSC traffic, timers or config saves, which causes
+ * underruns. Instead, sockets are bound with libuv and then read by this thread, which runs at high priority and
+ * does nothing else. On Linux, all sockets are multiplexed on one epoll instance and each readable socket is drained
+ * with recvmmsg in batches of BATCH_SIZE packets. Other platforms use select and recvfrom.
+ *
+ * The thread is started with the first socket and stopped with the last one. Callbacks run on this thread and must
+ * hand packets to the audio thread without locks.
+ */
+class UdpReceiveThread {
+public:
+	typedef void (*PacketCallback)(void* arg, const uint8_t* data, size_t size);
+
+	static constexpr size_t BATCH_SIZE = 16;
+	static constexpr size_t MAX_PACKET_SIZE = 65536;
+
+	// Main thread, the socket must be non-blocking. Return 0 or a libuv error code
+	static int addSocket(uv_os_sock_t socket, PacketCallback callback, void* arg);
+	// Once this returns, the callback is not running and won't be called anymore for this socket
+	static void removeSocket(uv_os_sock_t socket);
+
+private:
+	struct Registration;
+	struct State;
+
+	static State& getState();
+	static int startThread(State& state);
+	static void stopThread(State& state);
+	static void run(State* state);
+	static void receivePackets(State* state, Registration* registration);
+};
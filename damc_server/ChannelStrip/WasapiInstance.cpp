@@ -239,6 +239,7 @@ WasapiInstance::WasapiInstance(OscContainer* parent, Direction direction)
       oscBufferSize(this, "bufferSize", 0),
       oscActualBufferSize(this, "actualBufferSize", 0),
       oscDeviceSampleRate(this, "deviceSampleRate", 48000),
+      oscResamplingTaps(this, "resamplingTaps", 64),
       oscClockDrift(this, "clockDrift", 0.0f),
       oscMeasuredClockDrift(this, "measuredClockDrift", 0.0f),
       oscExclusiveMode(this, "exclusiveMode", true),
@@ -252,6 +253,8 @@ WasapiInstance::WasapiInstance(OscContainer* parent, Direction direction)
 	oscDeviceName.addCheckCallback([this](const std::string&) { return pDevice == nullptr; });
 	oscBufferSize.addCheckCallback([this](int newValue) { return pDevice == nullptr && newValue >= 0; });
 	oscDeviceSampleRate.addCheckCallback([this](int newValue) { return pDevice == nullptr && newValue > 0; });
+	oscResamplingTaps.addCheckCallback(
+	    [this](int newValue) { return pDevice == nullptr && ResamplingFilter::isValidTapCount(newValue); });
 	oscExclusiveMode.addCheckCallback([this](int) { return pDevice == nullptr; });
 
 	oscClockDrift.addChangeCallback([this](float newValue) {
@@ -302,6 +305,7 @@ int WasapiInstance::start(int index, size_t numChannel, int sampleRate, int jack
 	}
 	resamplingFilters.resize(numChannel);
 	for(size_t i = 0; i < numChannel; i++) {
+		resamplingFilters[i].setTapCount(oscResamplingTaps);
 		if(direction == D_Output) {
 			resamplingFilters[i].reset(sampleRate);
 			resamplingFilters[i].setTargetSamplingRate(oscDeviceSampleRate);
@@ -538,6 +542,10 @@ void WasapiInstance::printAudioConfig(spdlog::level::level_enum level, const WAV
 int WasapiInstance::postProcessSamples(float** samples, size_t numChannel, uint32_t nframes) {
 	if(audioEvent)
 		ResetEvent(audioEvent);
+
+	for(ResamplingFilter& resamplingFilter : resamplingFilters)
+		resamplingFilter.updateParameters();
+
 	if(direction == D_Output)
 		return postProcessSamplesRender(samples, numChannel, nframes);
 	else
@@ -548,12 +556,11 @@ void WasapiInstance::copySamplesRender(
     Format format, float** input, size_t numFrameToRead, void* output, size_t numChannel, uint32_t nframes) {
 	if(resampledBuffer[0].size() <= resamplingFilters[0].getMaxRequiredOutputSize(nframes) * 3) {
 		for(size_t i = 0; i < numChannel; i++) {
-			float downSamplingRatio = resamplingFilters[i].getDownSamplingRatio();
-
-			for(size_t j = 0; j < numFrameToRead; j++) {
-				resamplingFilters[i].put(input[i][j]);
-				resamplingFilters[i].get(resampledBuffer[i], downSamplingRatio);
-			}
+			size_t previousSize = resampledBuffer[i].size();
+			resampledBuffer[i].resize(previousSize + resamplingFilters[i].getMaxRequiredOutputSize(numFrameToRead));
+			size_t outputSize =
+			    resamplingFilters[i].processSamples(resampledBuffer[i].data() + previousSize, input[i], numFrameToRead);
+			resampledBuffer[i].resize(previousSize + outputSize);
 		}
 
 		if(nframes > resampledBuffer[0].size()) {
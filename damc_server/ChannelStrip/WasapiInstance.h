@@ -72,6 +72,7 @@ private:
 	OscVariable<int32_t> oscBufferSize;
 	OscReadOnlyVariable<int32_t> oscActualBufferSize;
 	OscVariable<int> oscDeviceSampleRate;
+	OscVariable<int32_t> oscResamplingTaps;
 	OscVariable<float> oscClockDrift;
 	OscReadOnlyVariable<float> oscMeasuredClockDrift;
 	OscVariable<bool> oscExclusiveMode;
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <uv.h>
 
+#include "FftService.h"
 #include "Utils.h"
 #include <set>
 #include <string.h>
@@ -16,9 +17,12 @@
 
 ControlInterface::ControlInterface()
     : oscRoot(true),
-      oscStatePersister(&oscRoot, "damc_config.json"),
+      oscStatePersister(&oscRoot, OscStatePersist::getPathNextToExecutable("damc_config.json")),
       oscUdpServer(&oscRoot, &oscRoot),
       oscTcpServer(&oscRoot),
+      traceRecorder(&oscRoot, OscStatePersist::getPathNextToExecutable("damc_trace_")),
+      realtimeThreadSetup(&oscRoot),
+      jackHost(&oscRoot, &traceRecorder, &realtimeThreadSetup),
       outputs(&oscRoot, "strip"),
       keyBinding(&oscRoot, &oscRoot),
       jackPortAutoConnect(this, &oscRoot),
@@ -36,6 +40,9 @@ ControlInterface::ControlInterface()
 {
 	SPDLOG_INFO("Starting control interface");
 
+	// Before filters are created so their FFT plans reuse previous measurements
+	FftService::setWisdomFile(OscStatePersist::getPathNextToExecutable("damc_fftw_wisdom"));
+
 	outputs.setFactory(
 	    [this](OscContainer* parent, int name) { return new ChannelStrip(parent, this, name, audioRunning); });
 
@@ -127,6 +134,8 @@ void ControlInterface::stop() {
 	for(std::pair<const int, std::unique_ptr<ChannelStrip>>& output : outputs) {
 		output.second->stop();
     }
+
+	jackHost.stop();
 }
 
 void ControlInterface::asyncStop() {
@@ -155,6 +164,9 @@ void ControlInterface::onFastTimer() {
 	for(auto& outputInstance : outputs) {
 		outputInstance.second->onFastTimer();
 	}
+
+	jackHost.onFastTimer();
+	traceRecorder.onFastTimer();
 }
 
 void ControlInterface::onSlowTimer() {
@@ -1,12 +1,14 @@
 #pragma once
 
 #include "ChannelStrip/ChannelStrip.h"
+#include "JackHost.h"
 #include "JackPortAutoConnect.h"
 #include "KeyBinding.h"
 #include "OscRoot.h"
 #include "OscServer.h"
 #include "OscStatePersist.h"
 #include "OscTcpServer.h"
+#include "RealtimeThreadSetup.h"
 #include <Osc/OscContainerArray.h>
 #include <Osc/OscDynamicVariable.h>
 #include <map>
@@ -26,6 +28,10 @@ public:
 
 	void saveConfig();
 
+	JackHost* getJackHost() { return &jackHost; }
+	TraceRecorder* getTraceRecorder() { return &traceRecorder; }
+	RealtimeThreadSetup* getRealtimeThreadSetup() { return &realtimeThreadSetup; }
+
 protected:
 	void initializeTimer(std::unique_ptr<uv_timer_t, void (*)(uv_timer_t*)>& timer,
 	                     const char* name,
@@ -48,6 +54,9 @@ private:
 	OscStatePersist oscStatePersister;
 	OscServer oscUdpServer;
 	OscTcpServer oscTcpServer;
+	TraceRecorder traceRecorder;  // before strips and the host as they record to it
+	RealtimeThreadSetup realtimeThreadSetup;
+	JackHost jackHost;  // before outputs as strips use it until destroyed
 	OscContainerArray<ChannelStrip> outputs;
 	KeyBinding keyBinding;
 	JackPortAutoConnect jackPortAutoConnect;
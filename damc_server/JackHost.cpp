@@ -0,0 +1,492 @@
+#include "JackHost.h"
+#include "ChannelStrip/ChannelStrip.h"
+#include "JackUtils.h"
+#include <Osc/OscContainer.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <set>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+static inline void cpuRelax() {
+	_mm_pause();
+}
+#else
+static inline void cpuRelax() {
+	std::this_thread::yield();
+}
+#endif
+
+JackHost::JackHost(OscContainer* oscParent, TraceRecorder* trace, RealtimeThreadSetup* realtimeThreadSetup)
+    : trace(trace),
+      realtimeThreadSetup(realtimeThreadSetup),
+      oscEnable(oscParent, "singleJackClient", false),
+      oscWorkerCount(oscParent, "singleJackClientWorkers", 0),
+      client(nullptr),
+      sleepingWorkers(0),
+      workersQuitRequested(false),
+      graphUpdateRequested(false),
+      currentGraph(nullptr),
+      currentFrameCount(0),
+      currentQueueCount(0),
+      cycleRunning(false),
+      pendingTasks(0),
+      activeWorkers(0),
+      cycleEpoch(0) {
+	oscEnable.addCheckCallback([this](bool) -> bool {
+		if(client) {
+			SPDLOG_ERROR("Can't change single jack client mode while it is in use, disable all strips first");
+			return false;
+		}
+		return true;
+	});
+	oscWorkerCount.addCheckCallback([this](int32_t newValue) -> bool {
+		if(client) {
+			SPDLOG_ERROR("Can't change worker count while the single jack client is in use");
+			return false;
+		}
+		if(newValue < 0) {
+			SPDLOG_ERROR("Invalid worker count: {}", newValue);
+			return false;
+		}
+		return true;
+	});
+}
+
+JackHost::~JackHost() {
+	stop();
+}
+
+jack_client_t* JackHost::getClient() {
+	jack_status_t status;
+
+	if(client)
+		return client;
+
+	std::string jackClientName = ChannelStrip::JACK_CLIENT_NAME_PREFIX + "host";
+	SPDLOG_INFO("Opening shared jack client {}", jackClientName);
+	client = jack_client_open(jackClientName.c_str(), JackNullOption, &status);
+	if(client == nullptr) {
+		SPDLOG_ERROR("Failed to open shared jack client: {}", status);
+		JackUtils::logJackStatus(spdlog::level::err, status);
+		return nullptr;
+	}
+
+	jack_set_process_callback(client, &JackHost::processSamplesStatic, this);
+	jack_set_port_connect_callback(client, &JackHost::jackOnPortConnectStatic, this);
+	jack_set_xrun_callback(client, &JackHost::jackOnXrunStatic, this);
+	realtimeThreadSetup->registerClient(client);
+
+	// Workers must exist before the first cycle
+	startWorkers();
+
+	int ret = jack_activate(client);
+	if(ret) {
+		SPDLOG_ERROR("cannot activate shared client: {}", ret);
+	}
+
+	return client;
+}
+
+jack_port_t* JackHost::registerPort(const std::string& name, unsigned long flags) {
+	if(!getClient())
+		return nullptr;
+
+	return jack_port_register(client, name.c_str(), JACK_DEFAULT_AUDIO_TYPE, flags, 0);
+}
+
+void JackHost::unregisterPort(jack_port_t* port) {
+	if(client && port)
+		jack_port_unregister(client, port);
+}
+
+void JackHost::addProcessCallback(HostedProcessCallback callback,
+                                  void* arg,
+                                  const std::string& name,
+                                  const std::vector<std::string>& internalSources,
+                                  const std::vector<jack_port_t*>& inputPorts,
+                                  const std::vector<jack_port_t*>& outputPorts) {
+	processCallbacks.push_back(ProcessCallback{callback, arg, name, internalSources, inputPorts, outputPorts});
+	updateGraph();
+}
+
+void JackHost::removeProcessCallback(void* arg) {
+	auto it = std::find_if(processCallbacks.begin(), processCallbacks.end(), [arg](const ProcessCallback& item) {
+		return item.arg == arg;
+	});
+	if(it != processCallbacks.end()) {
+		processCallbacks.erase(it);
+		updateGraph();
+
+		// The cycle in progress might still use the previous graph and call the removed callback
+		waitGraphReleased();
+	}
+
+	// Close the shared client with its last strip, so singleJackClient can be changed again
+	if(processCallbacks.empty())
+		stop();
+}
+
+void JackHost::setInternalSources(void* arg, const std::vector<std::string>& internalSources) {
+	auto it = std::find_if(processCallbacks.begin(), processCallbacks.end(), [arg](const ProcessCallback& item) {
+		return item.arg == arg;
+	});
+	if(it == processCallbacks.end())
+		return;
+
+	it->internalSources = internalSources;
+	updateGraph();
+}
+
+void JackHost::onFastTimer() {
+	if(graphUpdateRequested.exchange(false))
+		updateGraph();
+}
+
+void JackHost::stop() {
+	if(!client)
+		return;
+
+	SPDLOG_INFO("Stopping shared jack client");
+
+	jack_deactivate(client);
+	stopWorkers();
+	jack_client_close(client);
+	client = nullptr;
+
+	processCallbacks.clear();
+	graph.publish(Graph{});
+}
+
+void JackHost::startWorkers() {
+	size_t workerCount = oscWorkerCount.get();
+	if(workerCount == 0) {
+		unsigned int cores = std::thread::hardware_concurrency();
+		workerCount = cores > 1 ? cores - 1 : 0;
+	}
+
+	int priority = jack_client_real_time_priority(client);
+	int realtime = jack_is_realtime(client);
+
+	uv_sem_init(&workSemaphore, 0);
+	uv_sem_init(&cycleSemaphore, 0);
+	sleepingWorkers = 0;
+	workersQuitRequested = false;
+	for(size_t i = 0; i < workerCount; i++) {
+		std::unique_ptr<Worker> worker(new Worker);
+		worker->host = this;
+		worker->index = i + 1;  // queue 0 is used by the JACK process thread
+
+		if(jack_client_create_thread(client, &worker->thread, priority, realtime, &workerThreadStatic, worker.get())) {
+			SPDLOG_ERROR("Failed to create jack worker thread {}", i);
+			break;
+		}
+
+		workers.push_back(std::move(worker));
+	}
+
+	SPDLOG_INFO("Started {} jack worker threads", workers.size());
+}
+
+void JackHost::stopWorkers() {
+	workersQuitRequested = true;
+	for(size_t i = 0; i < workers.size(); i++)
+		uv_sem_post(&workSemaphore);
+	for(auto& worker : workers)
+		jack_client_stop_thread(client, worker->thread);
+	workers.clear();
+
+	uv_sem_destroy(&workSemaphore);
+	uv_sem_destroy(&cycleSemaphore);
+}
+
+void JackHost::updateGraph() {
+	Graph newGraph;
+	std::map<const jack_port_t*, int> portOwners;
+	std::map<std::string, int> taskByName;
+	std::vector<std::set<int>> predecessors(processCallbacks.size());
+	std::vector<std::vector<int>> internalSources(processCallbacks.size());
+
+	SPDLOG_DEBUG("Updating shared jack client processing graph");
+
+	newGraph.tasks.resize(processCallbacks.size());
+	for(size_t i = 0; i < processCallbacks.size(); i++) {
+		newGraph.tasks[i].callback = processCallbacks[i].callback;
+		newGraph.tasks[i].arg = processCallbacks[i].arg;
+		newGraph.tasks[i].dependencyCount = 0;
+		newGraph.tasks[i].inputs.jackInputConnected.resize(processCallbacks[i].inputPorts.size(), false);
+
+		taskByName[processCallbacks[i].name] = i;
+		for(jack_port_t* port : processCallbacks[i].outputPorts)
+			portOwners[port] = i;
+	}
+
+	for(size_t i = 0; i < processCallbacks.size(); i++) {
+		// A strip depends on the hosted strips whose outputs are connected to its inputs
+		for(size_t portIndex = 0; portIndex < processCallbacks[i].inputPorts.size(); portIndex++) {
+			const char** connections = jack_port_get_all_connections(client, processCallbacks[i].inputPorts[portIndex]);
+			if(!connections)
+				continue;
+
+			newGraph.tasks[i].inputs.jackInputConnected[portIndex] = true;
+
+			for(size_t j = 0; connections[j]; j++) {
+				jack_port_t* sourcePort = jack_port_by_name(client, connections[j]);
+				if(!sourcePort)
+					continue;
+
+				auto owner = portOwners.find(sourcePort);
+				if(owner != portOwners.end() && owner->second != (int) i)
+					predecessors[i].insert(owner->second);
+			}
+			jack_free(connections);
+		}
+
+		// And on its internal sources
+		for(const std::string& sourceName : processCallbacks[i].internalSources) {
+			auto source = taskByName.find(sourceName);
+			if(source == taskByName.end()) {
+				SPDLOG_DEBUG("Internal source {} of {} is not running", sourceName, processCallbacks[i].name);
+				continue;
+			}
+			if(source->second == (int) i) {
+				SPDLOG_WARN("Ignoring internal route of {} to itself", sourceName);
+				continue;
+			}
+
+			predecessors[i].insert(source->second);
+			internalSources[i].push_back(source->second);
+		}
+	}
+
+	// Topological sort, feedback loops are broken by ignoring the remaining inputs of one of its strips
+	std::vector<size_t> remaining(processCallbacks.size());
+	std::vector<bool> sorted(processCallbacks.size(), false);
+	std::vector<std::set<int>> orderedPredecessors(processCallbacks.size());
+	std::vector<int> ready;
+	for(size_t i = 0; i < processCallbacks.size(); i++) {
+		remaining[i] = predecessors[i].size();
+		if(remaining[i] == 0)
+			ready.push_back(i);
+	}
+
+	size_t sortedCount = 0;
+	while(sortedCount < processCallbacks.size()) {
+		if(ready.empty()) {
+			size_t i = std::find(sorted.begin(), sorted.end(), false) - sorted.begin();
+			SPDLOG_WARN("Feedback loop detected in strip connections, ignoring remaining inputs of {}",
+			            processCallbacks[i].name);
+			remaining[i] = 0;
+			ready.push_back(i);
+		}
+
+		int task = ready.back();
+		ready.pop_back();
+		sorted[task] = true;
+		sortedCount++;
+
+		for(size_t i = 0; i < processCallbacks.size(); i++) {
+			if(!sorted[i] && remaining[i] > 0 && predecessors[i].count(task)) {
+				newGraph.tasks[task].successors.push_back(i);
+				newGraph.tasks[i].dependencyCount++;
+				orderedPredecessors[i].insert(task);
+				if(--remaining[i] == 0)
+					ready.push_back(i);
+			}
+		}
+	}
+
+	// Internal sources are read directly, they must have run before
+	for(size_t i = 0; i < processCallbacks.size(); i++) {
+		for(int source : internalSources[i]) {
+			if(orderedPredecessors[i].count(source))
+				newGraph.tasks[i].inputs.internalSources.push_back(processCallbacks[source].outputPorts);
+			else
+				SPDLOG_WARN("Ignoring internal route from {} to {} in a feedback loop",
+				            processCallbacks[source].name,
+				            processCallbacks[i].name);
+		}
+	}
+
+	for(size_t i = 0; i < newGraph.tasks.size(); i++) {
+		if(newGraph.tasks[i].dependencyCount == 0)
+			newGraph.roots.push_back(i);
+	}
+
+	newGraph.queueCount = workers.size() + 1;
+	newGraph.remainingDependencies.reset(new std::atomic<int>[newGraph.tasks.size()]);
+	newGraph.queues.reset(new WorkStealingQueue[newGraph.queueCount]);
+	for(size_t i = 0; i < newGraph.queueCount; i++)
+		newGraph.queues[i].allocate(newGraph.tasks.size());
+
+	graph.publish(std::move(newGraph));
+}
+
+void JackHost::waitGraphReleased() {
+	// The graph was published before reading the epoch, if no cycle is running the next one will use it
+	uint32_t epoch = cycleEpoch.load(std::memory_order_seq_cst);
+	bool warned = false;
+
+	if(epoch % 2) {
+		auto startTime = std::chrono::steady_clock::now();
+
+		// Never give up, freeing the callback while the cycle runs it would be a use after free
+		while(cycleEpoch.load(std::memory_order_acquire) == epoch) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+			if(!warned && std::chrono::steady_clock::now() - startTime > std::chrono::seconds(1)) {
+				SPDLOG_WARN("Shared jack client cycle is stalled, waiting for it to complete");
+				warned = true;
+			}
+		}
+	}
+
+	graph.reclaim();
+}
+
+int JackHost::jackOnXrunStatic(void* arg) {
+	JackHost* thisInstance = (JackHost*) arg;
+	thisInstance->trace->notifyXrun(0);
+	return 0;
+}
+
+int JackHost::processSamplesStatic(jack_nframes_t nframes, void* arg) {
+	JackHost* thisInstance = (JackHost*) arg;
+	return thisInstance->processSamples(nframes);
+}
+
+int JackHost::processSamples(jack_nframes_t nframes) {
+	bool tracing = trace->isEnabled();
+	uint64_t startTime = tracing ? TraceRecorder::now() : 0;
+
+	// Ordered before acquiring the graph, see waitGraphReleased()
+	cycleEpoch.fetch_add(1, std::memory_order_seq_cst);
+	const Graph* cycleGraph = graph.acquire();
+	int taskCount = cycleGraph->tasks.size();
+
+	if(taskCount > 0) {
+		// Workers are idle here, they only look at the queues while cycleRunning is set
+		currentGraph = cycleGraph;
+		currentFrameCount = nframes;
+		currentQueueCount = cycleGraph->queueCount;
+
+		for(int i = 0; i < taskCount; i++)
+			cycleGraph->remainingDependencies[i].store(cycleGraph->tasks[i].dependencyCount, std::memory_order_relaxed);
+
+		for(size_t i = 0; i < currentQueueCount; i++)
+			cycleGraph->queues[i].reset();
+
+		for(int root : cycleGraph->roots)
+			cycleGraph->queues[0].push(root);
+
+		pendingTasks.store(taskCount, std::memory_order_relaxed);
+		cycleRunning.store(true, std::memory_order_seq_cst);
+
+		// This thread runs one of the roots
+		wakeWorkers(cycleGraph->roots.size() - 1);
+
+		if(!runTasks(0))
+			uv_sem_wait(&cycleSemaphore);
+
+		// Workers woken late see the cycle ended, others are leaving runTasks() as nothing is left to run
+		cycleRunning.store(false, std::memory_order_seq_cst);
+		while(activeWorkers.load(std::memory_order_seq_cst) != 0)
+			cpuRelax();
+	}
+
+	cycleEpoch.fetch_add(1, std::memory_order_release);
+
+	if(tracing)
+		trace->recordDuration(0, "cycle", startTime, TraceRecorder::now());
+
+	return 0;
+}
+
+void* JackHost::workerThreadStatic(void* arg) {
+	Worker* worker = (Worker*) arg;
+	JackHost* thisInstance = worker->host;
+
+	// Not created by JACK, so the thread init callback is not called for them
+	thisInstance->realtimeThreadSetup->initCurrentThread();
+
+	while(true) {
+		thisInstance->sleepingWorkers.fetch_add(1, std::memory_order_relaxed);
+		uv_sem_wait(&thisInstance->workSemaphore);
+		if(thisInstance->workersQuitRequested)
+			break;
+
+		// Registered before checking the cycle state, so the JACK thread waits for this worker before resetting queues
+		thisInstance->activeWorkers.fetch_add(1, std::memory_order_seq_cst);
+		if(thisInstance->cycleRunning.load(std::memory_order_seq_cst) && thisInstance->runTasks(worker->index))
+			uv_sem_post(&thisInstance->cycleSemaphore);
+		thisInstance->activeWorkers.fetch_sub(1, std::memory_order_release);
+	}
+
+	return nullptr;
+}
+
+// Return true if this thread completed the last task of the cycle
+bool JackHost::runTasks(size_t queueIndex) {
+	const Graph* cycleGraph = currentGraph;
+	WorkStealingQueue& queue = cycleGraph->queues[queueIndex];
+
+	while(true) {
+		int taskIndex = queue.pop();
+		if(taskIndex < 0)
+			taskIndex = stealTask(queueIndex);
+		if(taskIndex < 0) {
+			// Only the owner pushes to a queue, so tasks made ready later are run or shared by the thread doing so
+			return false;
+		}
+
+		const Task& task = cycleGraph->tasks[taskIndex];
+		task.callback(currentFrameCount, task.inputs, task.arg);
+
+		int readyCount = 0;
+		for(int successor : task.successors) {
+			if(cycleGraph->remainingDependencies[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				queue.push(successor);
+				readyCount++;
+			}
+		}
+
+		// Keep one of them for this thread
+		if(readyCount > 1)
+			wakeWorkers(readyCount - 1);
+
+		if(pendingTasks.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			return true;
+	}
+}
+
+void JackHost::wakeWorkers(int count) {
+	int sleeping = sleepingWorkers.load(std::memory_order_relaxed);
+
+	while(count > 0 && sleeping > 0) {
+		if(sleepingWorkers.compare_exchange_weak(sleeping, sleeping - 1, std::memory_order_relaxed)) {
+			uv_sem_post(&workSemaphore);
+			sleeping--;
+			count--;
+		}
+	}
+}
+
+int JackHost::stealTask(size_t queueIndex) {
+	for(size_t i = 1; i < currentQueueCount; i++) {
+		int task = currentGraph->queues[(queueIndex + i) % currentQueueCount].steal();
+		if(task >= 0)
+			return task;
+	}
+
+	return -1;
+}
+
+void JackHost::jackOnPortConnectStatic(jack_port_id_t, jack_port_id_t, int, void* arg) {
+	JackHost* thisInstance = (JackHost*) arg;
+
+	// Called from the JACK notification thread, the graph is rebuilt by the main thread
+	thisInstance->graphUpdateRequested = true;
+}
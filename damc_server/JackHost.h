@@ -0,0 +1,150 @@
+#pragma once
+
+#include "RealtimeThreadSetup.h"
+#include "WorkStealingQueue.h"
+#include <Osc/OscVariable.h>
+#include <RealtimeSnapshot.h>
+#include <TraceRecorder.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <uv.h>
+#include <vector>
+
+// Need to be after else stdint might conflict
+#include <jack/jack.h>
+#include <jack/thread.h>
+
+class OscContainer;
+
+/*
+ * Single JACK client hosting all strips when "singleJackClient" is enabled.
+ *
+ * Strips register their ports on the shared client and add their process callback. On each JACK cycle, callbacks
+ * are run as tasks of a dependency graph built from the connections between hosted ports: a strip runs only once
+ * all hosted strips feeding its inputs have run. Independent strips are run in parallel by a pool of realtime worker
+ * threads (one less than the number of cores, the JACK process thread being the last worker). Each thread has its
+ * own task deque and steals from the others when it is empty.
+ *
+ * Workers sleep on a shared semaphore and are only woken when more tasks are ready than threads running them: for
+ * the roots at the start of a cycle and when a task makes several successors ready. A worker which finds no task goes
+ * back to sleep, the JACK process thread waits for the end of the cycle on its own semaphore posted by the thread
+ * completing the last task.
+ *
+ * Strips can also be routed to each other internally, without any JACK connection: the sink strip gets the output
+ * port buffers of its internal sources and reads them directly in the same cycle, as the graph ensures the sources
+ * have already run.
+ *
+ * The graph is rebuilt on the main thread when a callback or a route is added or removed and, for connection changes
+ * notified by JACK, on the next fast timer.
+ */
+class JackHost {
+public:
+	struct HostedInputs {
+		// Output ports of each internal source routed to the strip
+		std::vector<std::vector<jack_port_t*>> internalSources;
+		// Whether each input port of the strip has a JACK connection
+		std::vector<bool> jackInputConnected;
+	};
+	typedef int (*HostedProcessCallback)(jack_nframes_t nframes, const HostedInputs& inputs, void* arg);
+
+	JackHost(OscContainer* oscParent, TraceRecorder* trace, RealtimeThreadSetup* realtimeThreadSetup);
+	~JackHost();
+
+	bool isEnabled() { return oscEnable.get(); }
+
+	// Open the shared client if not already done, return nullptr on failure
+	jack_client_t* getClient();
+	jack_port_t* registerPort(const std::string& name, unsigned long flags);
+	void unregisterPort(jack_port_t* port);
+
+	void addProcessCallback(HostedProcessCallback callback,
+	                        void* arg,
+	                        const std::string& name,
+	                        const std::vector<std::string>& internalSources,
+	                        const std::vector<jack_port_t*>& inputPorts,
+	                        const std::vector<jack_port_t*>& outputPorts);
+	// Once this returns, the callback is not running and won't be called anymore
+	// The shared client is closed when no callback is left, along with the ports still registered on it
+	void removeProcessCallback(void* arg);
+	// Names of the hosted strips routed to the strip's inputs
+	void setInternalSources(void* arg, const std::vector<std::string>& internalSources);
+
+	void onFastTimer();
+	void stop();
+
+protected:
+	struct Task {
+		HostedProcessCallback callback;
+		void* arg;
+		int dependencyCount;
+		std::vector<int> successors;
+		HostedInputs inputs;
+	};
+
+	struct Graph {
+		std::vector<Task> tasks;
+		std::vector<int> roots;
+
+		// Scratch state of the current cycle, allocated by the main thread
+		std::unique_ptr<std::atomic<int>[]> remainingDependencies;
+		std::unique_ptr<WorkStealingQueue[]> queues;
+		size_t queueCount = 0;
+	};
+
+	struct Worker {
+		JackHost* host;
+		size_t index;
+		jack_native_thread_t thread;
+	};
+
+	struct ProcessCallback {
+		HostedProcessCallback callback;
+		void* arg;
+		std::string name;
+		std::vector<std::string> internalSources;
+		std::vector<jack_port_t*> inputPorts;
+		std::vector<jack_port_t*> outputPorts;
+	};
+
+	void startWorkers();
+	void stopWorkers();
+	void updateGraph();
+	void waitGraphReleased();
+
+	static int processSamplesStatic(jack_nframes_t nframes, void* arg);
+	int processSamples(jack_nframes_t nframes);
+	static void* workerThreadStatic(void* arg);
+	bool runTasks(size_t queueIndex);
+	int stealTask(size_t queueIndex);
+	void wakeWorkers(int count);
+
+	static int jackOnXrunStatic(void* arg);
+	static void jackOnPortConnectStatic(jack_port_id_t a, jack_port_id_t b, int connect, void* arg);
+
+private:
+	TraceRecorder* trace;
+	RealtimeThreadSetup* realtimeThreadSetup;
+	OscVariable<bool> oscEnable;
+	OscVariable<int32_t> oscWorkerCount;
+
+	jack_client_t* client;
+	std::vector<ProcessCallback> processCallbacks;
+	std::vector<std::unique_ptr<Worker>> workers;
+	uv_sem_t workSemaphore;
+	uv_sem_t cycleSemaphore;
+	std::atomic<int> sleepingWorkers;
+	std::atomic<bool> workersQuitRequested;
+	std::atomic<bool> graphUpdateRequested;
+
+	RealtimeSnapshot<Graph> graph;
+
+	// State of the running cycle, shared between the JACK process thread and workers
+	const Graph* currentGraph;
+	jack_nframes_t currentFrameCount;
+	size_t currentQueueCount;
+	std::atomic<bool> cycleRunning;
+	std::atomic<int> pendingTasks;
+	std::atomic<int> activeWorkers;  // Workers looking at the queues
+	std::atomic<uint32_t> cycleEpoch;  // Odd while the JACK thread runs a cycle
+};
@@ -0,0 +1,235 @@
+#include "OfflineRenderer.h"
+#include "OscStatePersist.h"
+#include <FftService.h>
+#include <RealtimeThread.h>
+#include <WavFile.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <set>
+#include <spdlog/spdlog.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+OfflineRenderer::Strip::Strip(OscContainer* parent, int index)
+    : OscContainer(parent, std::to_string(index)),
+      oscEnable(this, "enable", false),
+      oscName(this, "name", std::to_string(index)),
+      oscNumChannel(this, "channels", 2),
+      oscSampleRate(this, "sample_rate"),
+      profiler(this, nullptr, 0),
+      filters(this, &oscNumChannel, &oscSampleRate, &profiler) {
+	oscNumChannel.addCheckCallback([](int32_t newValue) { return newValue > 0 && newValue <= 32; });
+}
+
+void OfflineRenderer::Strip::prepare(const Input* input, size_t blockSize) {
+	this->input = input;
+	this->blockSize = blockSize;
+
+	oscSampleRate.setDefault(input->sampleRate);
+	filters.setOffline(true);
+	filters.reset(input->sampleRate, blockSize);
+}
+
+void OfflineRenderer::Strip::render() {
+	size_t numChannel = oscNumChannel;
+	size_t numFrame = input->channels[0].size();
+	std::vector<std::vector<float>> inputBlock(numChannel, std::vector<float>(blockSize));
+	std::vector<const float*> inputPointers;
+	std::vector<float*> outputPointers;
+
+	output.assign(numChannel, std::vector<float>(numFrame + blockSize));
+	for(size_t channel = 0; channel < numChannel; channel++)
+		inputPointers.push_back(inputBlock[channel].data());
+
+	auto start = std::chrono::steady_clock::now();
+
+	// Always full blocks as the convolution needs the configured block size, the last one is padded with silence
+	for(size_t position = 0; position < numFrame; position += blockSize) {
+		size_t count = std::min(blockSize, numFrame - position);
+
+		outputPointers.clear();
+		for(size_t channel = 0; channel < numChannel; channel++) {
+			const std::vector<float>& source = input->channels[channel % input->channels.size()];
+			std::copy_n(source.begin() + position, count, inputBlock[channel].begin());
+			std::fill(inputBlock[channel].begin() + count, inputBlock[channel].end(), 0.0f);
+			outputPointers.push_back(output[channel].data() + position);
+		}
+
+		filters.processSamples(outputPointers.data(), inputPointers.data(), numChannel, blockSize);
+	}
+
+	processingSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	for(std::vector<float>& channel : output)
+		channel.resize(numFrame);
+}
+
+OfflineRenderer::OfflineRenderer() : oscRoot(false), strips(&oscRoot, "strip") {
+	FftService::setWisdomFile(OscStatePersist::getPathNextToExecutable("damc_fftw_wisdom"));
+
+	strips.setFactory([](OscContainer* parent, int name) { return new Strip(parent, name); });
+}
+
+void OfflineRenderer::printUsage() {
+	SPDLOG_ERROR("Usage: damc_server --render [--config FILE] [--output-dir DIR] [--block-size FRAMES] "
+	             "[--threads COUNT] --input [STRIP_NAME=]FILE...");
+	SPDLOG_ERROR("An input without strip name is used for all enabled strips without their own input");
+}
+
+// Parse a count between 1 and maxValue, larger values are capped
+bool OfflineRenderer::parseCount(const char* value, size_t maxValue, size_t* count) {
+	char* end;
+	errno = 0;
+	long long result = strtoll(value, &end, 10);
+	if(end == value || *end != '\0' || result < 1)
+		return false;
+
+	*count = errno == ERANGE || (unsigned long long) result > maxValue ? maxValue : (size_t) result;
+	return true;
+}
+
+const OfflineRenderer::Input* OfflineRenderer::loadInput(const std::string& fileName) {
+	auto it = inputs.find(fileName);
+	if(it != inputs.end())
+		return it->second.get();
+
+	std::unique_ptr<Input> input(new Input);
+	if(!WavFile::read(fileName, &input->sampleRate, &input->channels) || input->channels[0].empty()) {
+		SPDLOG_ERROR("Can't use {} as input", fileName);
+		input.reset();
+	}
+
+	return (inputs[fileName] = std::move(input)).get();
+}
+
+int OfflineRenderer::run(int argc, char* argv[]) {
+	std::string configFileName = OscStatePersist::getPathNextToExecutable("damc_config.json");
+	std::string outputDirectory = ".";
+	std::string defaultInput;
+	std::map<std::string, std::string> stripInputs;
+	size_t blockSize = 256;
+	size_t threadCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), MAX_THREADS);
+
+	for(int i = 0; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+
+		if(strcmp(argv[i], "--config") == 0 && hasValue) {
+			configFileName = argv[++i];
+		} else if(strcmp(argv[i], "--output-dir") == 0 && hasValue) {
+			outputDirectory = argv[++i];
+		} else if(strcmp(argv[i], "--block-size") == 0 && hasValue) {
+			if(!parseCount(argv[++i], MAX_BLOCK_SIZE, &blockSize)) {
+				SPDLOG_ERROR("Invalid block size: {}", argv[i]);
+				printUsage();
+				return 1;
+			}
+		} else if(strcmp(argv[i], "--threads") == 0 && hasValue) {
+			if(!parseCount(argv[++i], MAX_THREADS, &threadCount)) {
+				SPDLOG_ERROR("Invalid thread count: {}", argv[i]);
+				printUsage();
+				return 1;
+			}
+		} else if(strcmp(argv[i], "--input") == 0 && hasValue) {
+			std::string value = argv[++i];
+			size_t separator = value.find('=');
+			if(separator != std::string::npos)
+				stripInputs[value.substr(0, separator)] = value.substr(separator + 1);
+			else
+				defaultInput = value;
+		} else {
+			printUsage();
+			return 1;
+		}
+	}
+
+	if(defaultInput.empty() && stripInputs.empty()) {
+		printUsage();
+		return 1;
+	}
+
+	std::map<std::string, std::set<std::string>> outputPortConnections;
+	OscStatePersist(&oscRoot, configFileName).loadState(outputPortConnections);
+
+	std::vector<Strip*> jobs;
+	for(std::pair<const int, std::unique_ptr<Strip>>& item : strips) {
+		Strip* strip = item.second.get();
+		auto it = stripInputs.find(strip->getStripName());
+		std::string inputFileName = it != stripInputs.end() ? it->second : defaultInput;
+
+		if(it == stripInputs.end() && !strip->isEnabled())
+			continue;
+		if(inputFileName.empty()) {
+			SPDLOG_WARN("Skipping strip {}: no input file", strip->getStripName());
+			continue;
+		}
+
+		const Input* input = loadInput(inputFileName);
+		if(!input)
+			return 2;
+
+		strip->prepare(input, blockSize);
+		jobs.push_back(strip);
+	}
+
+	if(jobs.empty()) {
+		SPDLOG_ERROR("No strip to render in {}", configFileName);
+		return 2;
+	}
+
+	threadCount = std::min(threadCount, jobs.size());
+	SPDLOG_INFO("Rendering {} strips with {} threads and {} frames blocks", jobs.size(), threadCount, blockSize);
+
+	// Strips are independent, each thread renders the next strip not started yet
+	std::atomic<size_t> nextJob{0};
+	std::vector<std::thread> threads;
+	auto start = std::chrono::steady_clock::now();
+
+	for(size_t i = 0; i < threadCount; i++) {
+		threads.emplace_back([&jobs, &nextJob]() {
+			// Same denormal handling as JACK threads
+			RealtimeThread::setFloatingPointMode();
+			for(size_t job = nextJob++; job < jobs.size(); job = nextJob++)
+				jobs[job]->render();
+		});
+	}
+	for(std::thread& thread : threads)
+		thread.join();
+
+	double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double longestAudioSeconds = 0;
+	double totalProcessingSeconds = 0;
+	int result = 0;
+
+	for(Strip* strip : jobs) {
+		const Input* input = strip->getInput();
+		double audioSeconds = (double) input->channels[0].size() / input->sampleRate;
+		double processingSeconds = strip->getProcessingSeconds();
+
+		longestAudioSeconds = std::max(longestAudioSeconds, audioSeconds);
+		totalProcessingSeconds += processingSeconds;
+
+		SPDLOG_INFO("Strip {}: {:.3f} s of audio processed in {:.3f} s, {:.1f}x realtime",
+		            strip->getStripName(),
+		            audioSeconds,
+		            processingSeconds,
+		            audioSeconds / processingSeconds);
+
+		// Strip names are free text
+		std::string fileName = strip->getStripName();
+		std::replace_if(
+		    fileName.begin(), fileName.end(), [](char c) { return strchr("/\\:*?\"<>|", c) != nullptr; }, '_');
+		if(!WavFile::write(outputDirectory + "/" + fileName + ".wav", input->sampleRate, strip->getOutput()))
+			result = 2;
+	}
+
+	SPDLOG_INFO("Rendered {:.3f} s of audio in {:.3f} s ({:.3f} s of processing), {:.1f}x realtime",
+	            longestAudioSeconds,
+	            wallSeconds,
+	            totalProcessingSeconds,
+	            longestAudioSeconds / wallSeconds);
+
+	return result;
+}
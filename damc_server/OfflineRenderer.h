@@ -0,0 +1,76 @@
+#pragma once
+
+#include <FilteringChain.h>
+#include <Osc/OscContainer.h>
+#include <Osc/OscContainerArray.h>
+#include <Osc/OscVariable.h>
+#include <OscRoot.h>
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * Faster than realtime rendering of the configured strips, without JACK (damc_server --render).
+ *
+ * Strips are built from the config file with the same OSC layout as ChannelStrip so their filter chains get the
+ * configured parameters, endpoint parameters are ignored. Each enabled strip processes a WAV file block by block as
+ * fast as possible and writes the result to <name>.wav in the output directory. Strips are independent and are
+ * distributed over one thread per core. Internal routing between strips and the side channel are not applied.
+ */
+class OfflineRenderer {
+public:
+	OfflineRenderer();
+
+	// Arguments after --render, return the process exit code
+	int run(int argc, char* argv[]);
+
+protected:
+	struct Input {
+		int32_t sampleRate;
+		std::vector<std::vector<float>> channels;
+	};
+
+	class Strip : public OscContainer {
+	public:
+		Strip(OscContainer* parent, int index);
+
+		void prepare(const Input* input, size_t blockSize);
+		// Worker thread
+		void render();
+
+		const std::string& getStripName() const { return oscName.get(); }
+		bool isEnabled() const { return oscEnable.get(); }
+		const Input* getInput() const { return input; }
+		const std::vector<std::vector<float>>& getOutput() const { return output; }
+		double getProcessingSeconds() const { return processingSeconds; }
+
+	private:
+		const Input* input = nullptr;
+		size_t blockSize = 0;
+		std::vector<std::vector<float>> output;
+		double processingSeconds = 0;
+
+		OscVariable<bool> oscEnable;
+		OscVariable<std::string> oscName;
+		OscVariable<int32_t> oscNumChannel;
+		OscReadOnlyVariable<int32_t> oscSampleRate;
+
+		DspProfiler profiler;
+		FilterChain filters;
+	};
+
+	static constexpr size_t MAX_BLOCK_SIZE = 65536;
+	static constexpr size_t MAX_THREADS = 256;
+
+	static void printUsage();
+	static bool parseCount(const char* value, size_t maxValue, size_t* count);
+	const Input* loadInput(const std::string& fileName);
+
+private:
+	OscRoot oscRoot;
+	OscContainerArray<Strip> strips;
+	std::map<std::string, std::unique_ptr<Input>> inputs;
+};
@@ -5,7 +5,10 @@
 
 #include <json.h>
 
-OscStatePersist::OscStatePersist(OscRoot* oscRoot, std::string fileName) : oscRoot(oscRoot) {
+OscStatePersist::OscStatePersist(OscRoot* oscRoot, std::string filePath)
+    : oscRoot(oscRoot), saveFileName(filePath) {}
+
+std::string OscStatePersist::getPathNextToExecutable(const std::string& fileName) {
 	char basePath[1024];
 
 	size_t n = sizeof(basePath);
@@ -14,21 +17,20 @@ OscStatePersist::OscStatePersist(OscRoot* oscRoot, std::string fileName) : oscRo
 	else
 		basePath[0] = '\0';
 
-	if(basePath[0] == 0) {
-		saveFileName = fileName;
-	} else {
-		size_t len = strlen(basePath);
-		char* p = basePath + len;
-		while(p >= basePath) {
-			if(*p == '/' || *p == '\\')
-				break;
-			p--;
-		}
-		if(p >= basePath)
-			*p = 0;
+	if(basePath[0] == 0)
+		return fileName;
 
-		saveFileName = std::string(basePath) + "/" + fileName;
+	size_t len = strlen(basePath);
+	char* p = basePath + len;
+	while(p >= basePath) {
+		if(*p == '/' || *p == '\\')
+			break;
+		p--;
 	}
+	if(p >= basePath)
+		*p = 0;
+
+	return std::string(basePath) + "/" + fileName;
 }
 
 static void execute(std::map<std::string, std::vector<OscArgument>>* configValues,
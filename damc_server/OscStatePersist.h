@@ -8,11 +8,14 @@ class OscRoot;
 
 class OscStatePersist {
 public:
-	OscStatePersist(OscRoot* oscRoot, std::string fileName);
+	OscStatePersist(OscRoot* oscRoot, std::string filePath);
 
 	void loadState(std::map<std::string, std::set<std::string>>& outputPortConnections);
 	void saveState(const std::map<std::string, std::set<std::string>>& outputPortConnections);
 
+	// Path of fileName in the directory of the executable, or fileName as is if that directory is unknown
+	static std::string getPathNextToExecutable(const std::string& fileName);
+
 private:
 	OscRoot* oscRoot;
 	std::string saveFileName;
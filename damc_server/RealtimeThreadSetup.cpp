@@ -0,0 +1,62 @@
+#include "RealtimeThreadSetup.h"
+#include <RealtimeThread.h>
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+RealtimeThreadSetup::RealtimeThreadSetup(OscContainer* oscParent)
+    : oscCpuAffinity(oscParent, "realtimeCpuAffinity"), cpuMask(0) {
+	oscCpuAffinity.addCheckCallback([](const std::vector<int32_t>& newValue) {
+		for(int32_t cpu : newValue) {
+			if(cpu < 0 || cpu >= 64) {
+				SPDLOG_ERROR("Invalid CPU for realtime threads: {}", cpu);
+				return false;
+			}
+		}
+		return true;
+	});
+	oscCpuAffinity.addChangeCallback([this](const std::vector<int32_t>&, const std::vector<int32_t>& newValue) {
+		uint64_t mask = 0;
+		for(int32_t cpu : newValue)
+			mask |= UINT64_C(1) << cpu;
+		cpuMask = mask;
+	});
+}
+
+void RealtimeThreadSetup::registerClient(jack_client_t* client) {
+	if(jack_set_thread_init_callback(client, &RealtimeThreadSetup::onJackThreadInitStatic, this))
+		SPDLOG_WARN("Failed to set jack thread init callback");
+}
+
+void RealtimeThreadSetup::onJackThreadInitStatic(void* arg) {
+	static_cast<RealtimeThreadSetup*>(arg)->initCurrentThread();
+}
+
+void RealtimeThreadSetup::initCurrentThread() {
+	RealtimeThread::setFloatingPointMode();
+
+	uint64_t mask = cpuMask;
+	if(mask && !setCurrentThreadAffinity(mask))
+		SPDLOG_WARN("Failed to set realtime thread affinity to {:#x}", mask);
+}
+
+bool RealtimeThreadSetup::setCurrentThreadAffinity(uint64_t cpuMask) {
+#ifdef _WIN32
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) cpuMask) != 0;
+#else
+	cpu_set_t cpuSet;
+
+	CPU_ZERO(&cpuSet);
+	for(int cpu = 0; cpu < 64; cpu++) {
+		if(cpuMask & (UINT64_C(1) << cpu))
+			CPU_SET(cpu, &cpuSet);
+	}
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#endif
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Osc/OscFlatArray.h>
+#include <atomic>
+#include <stdint.h>
+
+// Need to be after else stdint might conflict
+#include <jack/jack.h>
+
+class OscContainer;
+
+/*
+ * Setup of the threads running DSP code.
+ *
+ * The JACK threads of each client are initialized through jack_set_thread_init_callback, the shared client workers
+ * call initCurrentThread() themselves. Denormals are flushed to zero as they slow down filter tails and silent inputs
+ * by orders of magnitude, see RealtimeThread. When realtimeCpuAffinity is not empty, these threads are also pinned to
+ * the listed CPUs. The affinity is applied to threads started after the change, that is when strips are restarted.
+ */
+class RealtimeThreadSetup {
+public:
+	explicit RealtimeThreadSetup(OscContainer* oscParent);
+
+	// Before jack_activate
+	void registerClient(jack_client_t* client);
+	void initCurrentThread();
+
+protected:
+	static void onJackThreadInitStatic(void* arg);
+	static bool setCurrentThreadAffinity(uint64_t cpuMask);
+
+private:
+	OscFlatArray<int32_t> oscCpuAffinity;
+	std::atomic<uint64_t> cpuMask;  // 0 to keep the default affinity
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Fixed capacity Chase-Lev work stealing deque of task indices.
+ *
+ * The owner thread pushes and pops at the bottom, other threads steal at the top. The queue is never wrapped around:
+ * it is cleared with reset() at the start of each audio cycle while no thread uses it, and its capacity must be at
+ * least the number of tasks pushed during one cycle.
+ */
+class WorkStealingQueue {
+public:
+	void allocate(size_t capacity) {
+		tasks.reset(new std::atomic<int>[capacity]);
+		this->capacity = capacity;
+		reset();
+	}
+
+	void reset() {
+		top.store(0, std::memory_order_relaxed);
+		bottom.store(0, std::memory_order_relaxed);
+	}
+
+	// Owner thread
+	void push(int task) {
+		int64_t b = bottom.load(std::memory_order_relaxed);
+		tasks[b].store(task, std::memory_order_relaxed);
+		bottom.store(b + 1, std::memory_order_release);
+	}
+
+	// Owner thread, return -1 if empty
+	int pop() {
+		int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+
+		if(t > b) {
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return -1;
+		}
+
+		int task = tasks[b].load(std::memory_order_relaxed);
+		if(t == b) {
+			// Last task, race with stealers
+			if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				task = -1;
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+
+		return task;
+	}
+
+	// Any thread, return -1 if empty or if another thread took the task
+	int steal() {
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = bottom.load(std::memory_order_acquire);
+
+		if(t >= b)
+			return -1;
+
+		int task = tasks[t].load(std::memory_order_relaxed);
+		if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return -1;
+
+		return task;
+	}
+
+	size_t getCapacity() const { return capacity; }
+
+private:
+	std::unique_ptr<std::atomic<int>[]> tasks;
+	size_t capacity = 0;
+	alignas(64) std::atomic<int64_t> top{0};
+	alignas(64) std::atomic<int64_t> bottom{0};
+};
@@ -1,17 +1,11 @@
 #include "ControlInterface.h"
+#include "OfflineRenderer.h"
+#include <RealtimeThread.h>
 #include <portaudio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
-#if defined(__SSE__) || defined(_M_AMD64) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
-#define SSE_ENABLED
-#endif
-
-#ifdef SSE_ENABLED
-#include <xmmintrin.h>
-#endif
-
 #include <pa_debugprint.h>
 
 #include "spdlog/cfg/env.h"
@@ -120,17 +114,14 @@ void initializeSignalHandler(uv_signal_t* handle, ControlInterface* controlInter
 	uv_unref((uv_handle_t*) handle);
 }
 
-int main() {
+int main(int argc, char* argv[]) {
 	uv_tty_t ttyRead;
 	uv_signal_t sigTermHandler;
 	uv_signal_t sigIntHandler;
 	uv_signal_t sigHupHandler;
 
-#ifdef SSE_ENABLED
-	unsigned int oldMXCSR = _mm_getcsr();      /* read the old MXCSR setting */
-	unsigned int newMXCSR = oldMXCSR | 0x8040; /* set DAZ and FZ bits */
-	_mm_setcsr(newMXCSR);                      /* write the new MXCSR setting to the MXCSR */
-#endif
+	// JACK threads are set up when they start, see RealtimeThreadSetup
+	RealtimeThread::setFloatingPointMode();
 
 	srand(time(nullptr));
 
@@ -138,6 +129,12 @@ int main() {
 
 	SPDLOG_INFO("Start damc_server version {}", DAMC_VERSION);
 
+	if(argc >= 2 && strcmp(argv[1], "--render") == 0) {
+		int result = OfflineRenderer().run(argc - 2, argv + 2);
+		spdlog::shutdown();
+		return result;
+	}
+
 	SPDLOG_INFO("Initializing portaudio");
 
 	PaUtil_SetDebugPrintFunction(&portAudioLogger);
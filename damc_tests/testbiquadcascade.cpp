@@ -0,0 +1,117 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "BiquadCascade.h"
+#include "BiquadFilter.h"
+#include "SimdVector.h"
+
+static const float SAMPLE_RATE = 48000;
+static const size_t BLOCK_SIZE = 256;
+static const size_t BLOCK_NUMBER = 200;
+static const float TOLERANCE = 1e-5f;
+
+struct BandSetting {
+	FilterType filterType;
+	float f0;
+	float gain;
+	float Q;
+};
+
+static const BandSetting BAND_SETTINGS[] = {
+    {FilterType::HighPass, 30, 0, 0.7f},
+    {FilterType::LowShelf, 120, 4, 0.7f},
+    {FilterType::Peak, 800, -6, 2},
+    {FilterType::Notch, 3000, 0, 8},
+    {FilterType::HighShelf, 8000, -3, 0.7f},
+    {FilterType::LowPass, 18000, 0, 0.7f},
+};
+static const size_t BAND_NUMBER = sizeof(BAND_SETTINGS) / sizeof(BAND_SETTINGS[0]);
+
+// Run the cascade and a chain of scalar BiquadFilter on the same full scale noise, return the max absolute difference
+static float compare(size_t numChannel) {
+	std::vector<BiquadCascade::Band> bands(BAND_NUMBER);
+	std::vector<std::vector<double>> states(BAND_NUMBER, std::vector<double>(2 * numChannel));
+	std::vector<std::vector<BiquadFilter>> filters(numChannel, std::vector<BiquadFilter>(BAND_NUMBER));
+
+	for(size_t band = 0; band < BAND_NUMBER; band++) {
+		const BandSetting& setting = BAND_SETTINGS[band];
+		double a_coefs[3];
+		double b_coefs[3];
+
+		BiquadFilter::computeFilter(
+		    true, setting.filterType, setting.f0, SAMPLE_RATE, setting.gain, setting.Q, a_coefs, b_coefs);
+
+		bands[band].b0 = b_coefs[0] / a_coefs[0];
+		bands[band].b1 = b_coefs[1] / a_coefs[0];
+		bands[band].b2 = b_coefs[2] / a_coefs[0];
+		bands[band].a1 = a_coefs[1] / a_coefs[0];
+		bands[band].a2 = a_coefs[2] / a_coefs[0];
+		bands[band].state = states[band].data();
+		BiquadCascade::initState(bands[band].state, numChannel);
+
+		for(size_t channel = 0; channel < numChannel; channel++)
+			filters[channel][band].init(a_coefs, b_coefs);
+	}
+
+	std::vector<std::vector<float>> inputs(numChannel, std::vector<float>(BLOCK_SIZE));
+	std::vector<std::vector<float>> outputs(numChannel, std::vector<float>(BLOCK_SIZE));
+	std::vector<const float*> inputPointers(numChannel);
+	std::vector<float*> outputPointers(numChannel);
+	float maxError = 0;
+
+	for(size_t channel = 0; channel < numChannel; channel++) {
+		inputPointers[channel] = inputs[channel].data();
+		outputPointers[channel] = outputs[channel].data();
+	}
+
+	for(size_t block = 0; block < BLOCK_NUMBER; block++) {
+		for(size_t channel = 0; channel < numChannel; channel++) {
+			for(size_t i = 0; i < BLOCK_SIZE; i++)
+				inputs[channel][i] = rand() / (float) RAND_MAX * 2 - 1;
+		}
+
+		BiquadCascade::processSamples(
+		    bands.data(), BAND_NUMBER, outputPointers.data(), inputPointers.data(), numChannel, BLOCK_SIZE);
+
+		// Like EqFilter before the cascade, each band output is rounded to float
+		for(size_t channel = 0; channel < numChannel; channel++) {
+			for(size_t i = 0; i < BLOCK_SIZE; i++) {
+				float sample = inputs[channel][i];
+				for(size_t band = 0; band < BAND_NUMBER; band++)
+					sample = filters[channel][band].put(sample);
+
+				maxError = std::max(maxError, fabsf(sample - outputs[channel][i]));
+			}
+		}
+	}
+
+	return maxError;
+}
+
+// Check all SIMD levels supported by the CPU against the scalar biquad, with channel counts using all lane widths
+int main(int argc, char* argv[]) {
+	static const size_t CHANNEL_NUMBERS[] = {1, 2, 3, 7, 8, 15, 32};
+	bool success = true;
+
+	srand(0);
+
+	for(int level = Simd::Scalar; level <= Simd::getSupportedLevel(); level++) {
+		Simd::setMaxLevel((Simd::Level) level);
+
+		for(size_t numChannel : CHANNEL_NUMBERS) {
+			float maxError = compare(numChannel);
+			bool pass = maxError < TOLERANCE;
+
+			printf("%-6s %2d channels: max error %g%s\n",
+			       Simd::getLevelName((Simd::Level) level),
+			       (int) numChannel,
+			       maxError,
+			       pass ? "" : " FAILED");
+			success = success && pass;
+		}
+	}
+
+	return success ? 0 : 1;
+}
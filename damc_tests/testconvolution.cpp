@@ -0,0 +1,150 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "../binauralSynthesis/Convolver.h"
+#include "PartitionedConvolver.h"
+
+static const size_t BLOCK_NUMBER = 64;
+static const float TOLERANCE = 1e-6f;
+
+static float randomSample() {
+	return rand() / (float) RAND_MAX - 0.5f;
+}
+
+// Decaying noise, so the output level doesn't depend much on the impulse response size
+static std::vector<float> makeImpulseResponse(size_t size) {
+	std::vector<float> samples(size);
+	for(size_t i = 0; i < size; i++)
+		samples[i] = randomSample() * expf(-4.0f * i / size) * 4 / sqrtf((float) size);
+	return samples;
+}
+
+// Reference convolution in double of a whole signal
+static std::vector<double> convolve(const std::vector<float>& signal, const std::vector<float>& impulseResponse) {
+	std::vector<double> result(signal.size());
+	for(size_t i = 0; i < signal.size(); i++) {
+		double sum = 0;
+		for(size_t j = 0; j < impulseResponse.size() && j <= i; j++)
+			sum += (double) signal[i - j] * impulseResponse[j];
+		result[i] = sum;
+	}
+	return result;
+}
+
+// Mix inputNumber inputs into outputNumber outputs and compare each output with the sum of direct convolutions
+static float testPartitionedConvolver(size_t inputNumber, size_t outputNumber, size_t blockSize, size_t impulseSize) {
+	size_t length = BLOCK_NUMBER * blockSize;
+	PartitionedConvolver convolver;
+	std::vector<std::vector<float>> inputs(inputNumber, std::vector<float>(length));
+	std::vector<std::vector<double>> expected(outputNumber, std::vector<double>(length));
+	std::vector<std::vector<float>> outputs(outputNumber, std::vector<float>(length));
+
+	for(size_t input = 0; input < inputNumber; input++) {
+		for(float& sample : inputs[input])
+			sample = randomSample();
+	}
+
+	// Impulse responses longer than maxImpulseSize are truncated
+	convolver.init(inputNumber, outputNumber, blockSize, impulseSize);
+	for(size_t input = 0; input < inputNumber; input++) {
+		for(size_t output = 0; output < outputNumber; output++) {
+			std::vector<float> impulseResponse = makeImpulseResponse(impulseSize + blockSize);
+			convolver.setImpulseResponse(input, output, impulseResponse.data(), impulseResponse.size());
+
+			impulseResponse.resize(impulseSize);
+			std::vector<double> result = convolve(inputs[input], impulseResponse);
+			for(size_t i = 0; i < length; i++)
+				expected[output][i] += result[i];
+		}
+	}
+
+	std::vector<const float*> inputPointers(inputNumber);
+	std::vector<float*> outputPointers(outputNumber);
+	for(size_t position = 0; position < length; position += blockSize) {
+		for(size_t input = 0; input < inputNumber; input++)
+			inputPointers[input] = &inputs[input][position];
+		for(size_t output = 0; output < outputNumber; output++)
+			outputPointers[output] = &outputs[output][position];
+
+		convolver.processSamples(outputPointers.data(), inputPointers.data(), blockSize);
+	}
+
+	float maxError = 0;
+	for(size_t output = 0; output < outputNumber; output++) {
+		for(size_t i = 0; i < length; i++)
+			maxError = std::max(maxError, (float) fabs(outputs[output][i] - expected[output][i]));
+	}
+
+	return maxError;
+}
+
+// Compare the partitioned path of Convolver with its direct convolution fallback
+static float testConvolver(size_t blockSize, size_t impulseSize) {
+	std::vector<float> impulseResponse = makeImpulseResponse(impulseSize);
+	std::vector<float> input(blockSize);
+	std::vector<float> outputDirect(blockSize);
+	std::vector<float> outputPartitioned(blockSize);
+	Convolver directConvolver;
+	Convolver partitionedConvolver;
+	float maxError = 0;
+
+	if(directConvolver.setConvolver(impulseResponse.data(), impulseResponse.size()) != 0)
+		return INFINITY;
+	partitionedConvolver.setBlockSize(blockSize);
+	if(partitionedConvolver.setConvolver(impulseResponse.data(), impulseResponse.size()) != 0)
+		return INFINITY;
+
+	for(size_t block = 0; block < BLOCK_NUMBER; block++) {
+		for(float& sample : input)
+			sample = randomSample();
+
+		directConvolver.processSamplesDirect(outputDirect.data(), input.data(), blockSize);
+		partitionedConvolver.processSamples(outputPartitioned.data(), input.data(), blockSize);
+
+		for(size_t i = 0; i < blockSize; i++)
+			maxError = std::max(maxError, fabsf(outputDirect[i] - outputPartitioned[i]));
+	}
+
+	return maxError;
+}
+
+static bool check(const char* name, size_t blockSize, size_t impulseSize, float maxError) {
+	bool pass = maxError < TOLERANCE;
+	printf("%-24s block %4d, impulse %5d: max error %g%s\n",
+	       name,
+	       (int) blockSize,
+	       (int) impulseSize,
+	       maxError,
+	       pass ? "" : " FAILED");
+	return pass;
+}
+
+// Check the partitioned convolutions against direct convolution, including impulse responses which are not a multiple
+// of the block size and shorter than one block
+int main(int argc, char* argv[]) {
+	static const size_t BLOCK_SIZES[] = {32, 64, 256, 1024};
+	static const size_t IMPULSE_SIZES[] = {1, 100, 512, 1000, 3000};
+	bool success = true;
+
+	srand(0);
+
+	for(size_t blockSize : BLOCK_SIZES) {
+		for(size_t impulseSize : IMPULSE_SIZES) {
+			success = check("PartitionedConvolver 1x1",
+			                blockSize,
+			                impulseSize,
+			                testPartitionedConvolver(1, 1, blockSize, impulseSize)) &&
+			          success;
+			success = check("PartitionedConvolver 3x2",
+			                blockSize,
+			                impulseSize,
+			                testPartitionedConvolver(3, 2, blockSize, impulseSize)) &&
+			          success;
+			success = check("Convolver", blockSize, impulseSize, testConvolver(blockSize, impulseSize)) && success;
+		}
+	}
+
+	return success ? 0 : 1;
+}